@@ -0,0 +1,369 @@
+#include "rubysdl2_internal.h"
+#include <SDL_audio.h>
+#include <SDL_timer.h>
+
+static VALUE mAudio;
+static VALUE cDevice;
+
+typedef struct Device {
+    SDL_AudioDeviceID id;
+    SDL_AudioSpec spec;
+    int frame_size;
+    int started;
+    Uint64 total_bytes;
+    Uint64 underruns;
+    Uint32 min_queued;
+} Device;
+
+static void Device_free(Device* d)
+{
+    if (rubysdl2_is_active() && d->id)
+        SDL_CloseAudioDevice(d->id);
+    free(d);
+}
+
+DEFINE_DATA_TYPE(Device, Device_free);
+DEFINE_GETTER(static, Device, cDevice, "SDL2::Audio::Device");
+
+static Device* Get_Device_opened(VALUE obj)
+{
+    Device* d = Get_Device(obj);
+    if (!d->id)
+        HANDLE_ERROR(SDL_SetError("SDL2::Audio::Device is already closed"));
+    return d;
+}
+
+/*
+ * Document-module: SDL2::Audio
+ *
+ * This module provides raw audio output without SDL_mixer.
+ *
+ * Before using this module, {SDL2.init} must be called with SDL2::INIT_AUDIO.
+ */
+
+/*
+ * Get the names of the output devices.
+ *
+ * @return [Array<String>] the names, which can be passed to {Device.open}
+ */
+static VALUE Audio_s_devices(VALUE self)
+{
+    int i, n = SDL_GetNumAudioDevices(0);
+    VALUE ary = rb_ary_new2(n > 0 ? n : 0);
+    for (i=0; i<n; ++i)
+        rb_ary_push(ary, utf8str_new_cstr(SDL_GetAudioDeviceName(i, 0)));
+    return ary;
+}
+
+/*
+ * Document-class: SDL2::Audio::Device
+ *
+ * This class represents an audio output device fed with SDL_QueueAudio.
+ *
+ * No callback runs on the audio thread; the application pushes PCM data
+ * with {#queue} and keeps {#queued_bytes} between a few buffers
+ * (low latency) and many buffers (robust against hiccups).
+ * The device converts nothing: the data must be in the format
+ * given to {.open}.
+ *
+ * The device detects underruns when {#queue} finds the queue has run dry
+ * after playback started, so the statistics are precise as long as
+ * the application queues data at least once per buffer.
+ *
+ * @example
+ *   dev = SDL2::Audio::Device.open(48000, SDL2::Audio::FORMAT_F32SYS, 1, 256)
+ *   dev.queue(samples.pack("e*"))
+ *   dev.resume
+ *   loop do
+ *     dev.queue(synth.render(256).pack("e*")) while dev.queued_time < 0.02
+ *     sleep 0.002
+ *   end
+ *
+ * @!attribute [r] freq
+ *   @return [Integer] the sample rate in Hz
+ * @!attribute [r] format
+ *   @return [Integer] the sample format, such as {SDL2::Audio::FORMAT_S16SYS}
+ * @!attribute [r] channels
+ *   @return [Integer] the number of channels
+ * @!attribute [r] samples
+ *   @return [Integer] the buffer size in sample frames, which decides the latency
+ * @!attribute [r] underruns
+ *   @return [Integer] the number of underruns detected since the last {#reset_stats}
+ * @!attribute [r] total_bytes
+ *   @return [Integer] the bytes queued since the last {#reset_stats}
+ */
+
+/*
+ * @overload open(freq=48000, format=SDL2::Audio::FORMAT_S16SYS, channels=2, samples=512, device=nil)
+ *   Open an output device in paused state.
+ *
+ *   The device is opened with exactly the given spec; SDL converts it
+ *   to the hardware format if needed.
+ *
+ *   @param freq [Integer] the sample rate in Hz
+ *   @param format [Integer] the sample format, such as {SDL2::Audio::FORMAT_F32SYS}
+ *   @param channels [Integer] the number of channels
+ *   @param samples [Integer] the buffer size in sample frames (a power of two)
+ *   @param device [String,nil] the device name from {SDL2::Audio.devices},
+ *     or nil for the default device
+ *   @return [SDL2::Audio::Device]
+ *
+ *   @raise [SDL2::Error] raised when failing to open the device
+ */
+static VALUE Device_s_open(int argc, VALUE* argv, VALUE self)
+{
+    VALUE freq, format, channels, samples, device, obj;
+    SDL_AudioSpec want;
+    Device* d;
+
+    rb_scan_args(argc, argv, "05", &freq, &format, &channels, &samples, &device);
+    SDL_zero(want);
+    want.freq = NIL_P(freq) ? 48000 : NUM2INT(freq);
+    want.format = NIL_P(format) ? AUDIO_S16SYS : NUM2UINT(format);
+    want.channels = NIL_P(channels) ? 2 : NUM2UCHAR(channels);
+    want.samples = NIL_P(samples) ? 512 : NUM2USHORT(samples);
+    want.callback = NULL;
+    if (!NIL_P(device))
+        device = rb_str_export_to_utf8(device);
+
+    obj = TypedData_Make_Struct(cDevice, Device, &Device_data_type, d);
+    d->id = SDL_OpenAudioDevice(NIL_P(device) ? NULL : StringValueCStr(device),
+                                0, &want, &d->spec, 0);
+    if (!d->id)
+        SDL_ERROR();
+    d->frame_size = SDL_AUDIO_BITSIZE(d->spec.format) / 8 * d->spec.channels;
+    d->started = 0;
+    d->total_bytes = d->underruns = 0;
+    d->min_queued = 0;
+    return obj;
+}
+
+/*
+ * @overload queue(data)
+ *   Append PCM data to the queue of the device.
+ *
+ *   The data is passed to SDL_QueueAudio directly from the String or IO::Buffer,
+ *   without an intermediate copy.
+ *
+ *   @param data [String,IO::Buffer] interleaved samples in the format of the device
+ *   @return [Integer] the bytes queued after this call
+ *
+ *   @raise [ArgumentError] raised when the length is not a multiple of the frame size
+ *   @raise [SDL2::Error] raised when failing to queue
+ */
+static VALUE Device_queue(VALUE self, VALUE data)
+{
+    Device* d = Get_Device_opened(self);
+    size_t len;
+    const void* ptr = bytes_for_reading(data, &len);
+    Uint32 queued;
+
+    if (len % d->frame_size != 0)
+        rb_raise(rb_eArgError, "data length (%ld) is not a multiple of the frame size (%d)",
+                 (long)len, d->frame_size);
+    if (len > 0xffffffffUL)
+        rb_raise(rb_eArgError, "too large data (%ld bytes)", (long)len);
+
+    queued = SDL_GetQueuedAudioSize(d->id);
+    if (d->started && SDL_GetAudioDeviceStatus(d->id) == SDL_AUDIO_PLAYING) {
+        if (queued == 0)
+            ++d->underruns;
+        if (queued < d->min_queued)
+            d->min_queued = queued;
+    }
+    HANDLE_ERROR(SDL_QueueAudio(d->id, ptr, (Uint32)len));
+    RB_GC_GUARD(data);
+    if (!d->started && SDL_GetAudioDeviceStatus(d->id) == SDL_AUDIO_PLAYING) {
+        d->started = 1;
+        d->min_queued = queued + (Uint32)len;
+    }
+    d->total_bytes += len;
+    return UINT2NUM(queued + (Uint32)len);
+}
+
+/* @return [Integer] the bytes in the queue, not yet sent to the hardware */
+static VALUE Device_queued_bytes(VALUE self)
+{
+    return UINT2NUM(SDL_GetQueuedAudioSize(Get_Device_opened(self)->id));
+}
+
+/* @return [Float] the duration of the queued data in seconds */
+static VALUE Device_queued_time(VALUE self)
+{
+    Device* d = Get_Device_opened(self);
+    double frames = (double)SDL_GetQueuedAudioSize(d->id) / d->frame_size;
+    return DBL2NUM(frames / d->spec.freq);
+}
+
+/*
+ * Get the minimum number of queued bytes observed by {#queue} while playing,
+ * since the last {#reset_stats}.
+ *
+ * A value close to 0 means the queue is nearly running dry; a large value means
+ * the latency can be reduced by queueing less.
+ *
+ * @return [Integer,nil] the bytes, or nil if nothing is observed yet
+ */
+static VALUE Device_min_queued_bytes(VALUE self)
+{
+    Device* d = Get_Device(self);
+    return d->started ? UINT2NUM(d->min_queued) : Qnil;
+}
+
+/*
+ * Start or resume playback.
+ *
+ * @return [nil]
+ */
+static VALUE Device_resume(VALUE self)
+{
+    Device* d = Get_Device_opened(self);
+    SDL_PauseAudioDevice(d->id, 0);
+    if (!d->started) {
+        d->started = 1;
+        d->min_queued = SDL_GetQueuedAudioSize(d->id);
+    }
+    return Qnil;
+}
+
+/*
+ * Pause playback. The queued data is kept.
+ *
+ * @return [nil]
+ */
+static VALUE Device_pause(VALUE self)
+{
+    SDL_PauseAudioDevice(Get_Device_opened(self)->id, 1);
+    return Qnil;
+}
+
+/* Return true if the device is paused. */
+static VALUE Device_paused_p(VALUE self)
+{
+    return INT2BOOL(SDL_GetAudioDeviceStatus(Get_Device_opened(self)->id) != SDL_AUDIO_PLAYING);
+}
+
+/*
+ * Drop all queued data.
+ *
+ * @return [nil]
+ */
+static VALUE Device_clear(VALUE self)
+{
+    SDL_ClearQueuedAudio(Get_Device_opened(self)->id);
+    return Qnil;
+}
+
+/*
+ * Reset {#underruns}, {#total_bytes}, and {#min_queued_bytes}.
+ *
+ * @return [nil]
+ */
+static VALUE Device_reset_stats(VALUE self)
+{
+    Device* d = Get_Device(self);
+    d->total_bytes = d->underruns = 0;
+    d->started = d->id && SDL_GetAudioDeviceStatus(d->id) == SDL_AUDIO_PLAYING;
+    d->min_queued = d->started ? SDL_GetQueuedAudioSize(d->id) : 0;
+    return Qnil;
+}
+
+/*
+ * Close the device.
+ *
+ * @return [nil]
+ */
+static VALUE Device_close(VALUE self)
+{
+    Device* d = Get_Device(self);
+    if (d->id)
+        SDL_CloseAudioDevice(d->id);
+    d->id = 0;
+    return Qnil;
+}
+
+/* Return true if the device is closed by {#close}. */
+static VALUE Device_closed_p(VALUE self)
+{
+    return INT2BOOL(Get_Device(self)->id == 0);
+}
+
+static VALUE Device_freq(VALUE self)
+{
+    return INT2NUM(Get_Device(self)->spec.freq);
+}
+
+static VALUE Device_format(VALUE self)
+{
+    return UINT2NUM(Get_Device(self)->spec.format);
+}
+
+static VALUE Device_channels(VALUE self)
+{
+    return INT2NUM(Get_Device(self)->spec.channels);
+}
+
+static VALUE Device_samples(VALUE self)
+{
+    return INT2NUM(Get_Device(self)->spec.samples);
+}
+
+static VALUE Device_underruns(VALUE self)
+{
+    return ULL2NUM(Get_Device(self)->underruns);
+}
+
+static VALUE Device_total_bytes(VALUE self)
+{
+    return ULL2NUM(Get_Device(self)->total_bytes);
+}
+
+/* @return [String] inspection string */
+static VALUE Device_inspect(VALUE self)
+{
+    Device* d = Get_Device(self);
+    if (!d->id)
+        return rb_sprintf("<%s: closed>", rb_obj_classname(self));
+    return rb_sprintf("<%s: freq=%d format=0x%x channels=%d samples=%d>",
+                      rb_obj_classname(self), d->spec.freq, d->spec.format,
+                      d->spec.channels, d->spec.samples);
+}
+
+void rubysdl2_init_audio(void)
+{
+    mAudio = rb_define_module_under(mSDL2, "Audio");
+    rb_define_module_function(mAudio, "devices", Audio_s_devices, 0);
+
+    /* Unsigned 8-bit samples */
+    rb_define_const(mAudio, "FORMAT_U8", UINT2NUM(AUDIO_U8));
+    /* Signed 8-bit samples */
+    rb_define_const(mAudio, "FORMAT_S8", UINT2NUM(AUDIO_S8));
+    /* Signed 16-bit samples, in native byte order */
+    rb_define_const(mAudio, "FORMAT_S16SYS", UINT2NUM(AUDIO_S16SYS));
+    /* Signed 32-bit samples, in native byte order */
+    rb_define_const(mAudio, "FORMAT_S32SYS", UINT2NUM(AUDIO_S32SYS));
+    /* 32-bit floating point samples, in native byte order */
+    rb_define_const(mAudio, "FORMAT_F32SYS", UINT2NUM(AUDIO_F32SYS));
+
+    cDevice = rb_define_class_under(mAudio, "Device", rb_cObject);
+    rb_undef_alloc_func(cDevice);
+    rb_define_singleton_method(cDevice, "open", Device_s_open, -1);
+    rb_define_method(cDevice, "queue", Device_queue, 1);
+    rb_define_method(cDevice, "queued_bytes", Device_queued_bytes, 0);
+    rb_define_method(cDevice, "queued_time", Device_queued_time, 0);
+    rb_define_method(cDevice, "min_queued_bytes", Device_min_queued_bytes, 0);
+    rb_define_method(cDevice, "resume", Device_resume, 0);
+    rb_define_method(cDevice, "pause", Device_pause, 0);
+    rb_define_method(cDevice, "paused?", Device_paused_p, 0);
+    rb_define_method(cDevice, "clear", Device_clear, 0);
+    rb_define_method(cDevice, "reset_stats", Device_reset_stats, 0);
+    rb_define_method(cDevice, "close", Device_close, 0);
+    rb_define_method(cDevice, "closed?", Device_closed_p, 0);
+    rb_define_method(cDevice, "freq", Device_freq, 0);
+    rb_define_method(cDevice, "format", Device_format, 0);
+    rb_define_method(cDevice, "channels", Device_channels, 0);
+    rb_define_method(cDevice, "samples", Device_samples, 0);
+    rb_define_method(cDevice, "underruns", Device_underruns, 0);
+    rb_define_method(cDevice, "total_bytes", Device_total_bytes, 0);
+    rb_define_method(cDevice, "inspect", Device_inspect, 0);
+}
@@ -1,6 +1,8 @@
 #include "rubysdl2_internal.h"
 #include <SDL_events.h>
 #include <SDL_version.h>
+#include <SDL_mutex.h>
+#include <ruby/thread.h>
 
 static VALUE cEvent;
 static VALUE cEvQuit;
@@ -37,7 +39,10 @@ static VALUE cEvTouchFinger;
 static VALUE cEvFingerDown;
 static VALUE cEvFingerUp;
 static VALUE cEvFingerMotion;
-/* static VALUE cEvUser; */
+static VALUE cEventRecorder;
+static VALUE cEventPlayer;
+static VALUE cEventDispatcher;
+static VALUE cEvUser;
 /* static VALUE cEvDrop; */
 
 /* TODO:
@@ -45,16 +50,53 @@ static VALUE cEvFingerMotion;
    SDL_FlushEvent{,s}
    SDL_HasEvent{,s}
    SDL_PumpEvent
-   SDL_PeepEvents
    SDL_DropEvent
    SDL_QuitRequested
-   - difficult
-   SDL_PushEvent
-   SDL_WaitEvent{,Timeout}
-   SDL_UserEvent, SDL_RegisterEvents
  */
 
 static VALUE event_type_to_class[SDL_LASTEVENT];
+/* Event objects reused by Event.drain, indexed by event type */
+static VALUE reusable_events = Qnil;
+
+/* The number of events fetched by one SDL_PeepEvents call */
+#define PEEP_CHUNK 64
+/*
+ * Entries of user events pushed by Event.push, indexed by the ID stored in data1.
+ * An entry is [payload, data2]; data2 (the performance counter at pushing) tags
+ * the event, so user events pushed by other code are not mistaken for ours.
+ */
+static VALUE user_payloads = Qnil;
+static unsigned long last_payload_id = 0;
+
+/* The event type pushed to interrupt Event.wait, registered on demand */
+static Uint32 wakeup_event_type = (Uint32)-1;
+
+/* Whether motion events are coalesced (Event.coalesce_motion=) */
+static int coalesce_motion = 0;
+/* The buffer used to take all events out of the queue temporarily */
+static SDL_Event* queue_buffer = NULL;
+static int queue_buffer_size = 0;
+/* The number of events merged into others */
+static Uint64 num_coalesced = 0;
+
+/* The conditions of events dropped by the native event filter (Event.set_filter) */
+typedef struct EventFilterSpec {
+    int active;
+    Uint8 types[(SDL_LASTEVENT + 7) / 8];
+    Uint8 scancodes[(SDL_NUM_SCANCODES + 7) / 8];
+    Uint32* window_ids;
+    int num_window_ids;
+    SDL_JoystickID* joysticks;
+    int num_joysticks;
+} EventFilterSpec;
+
+static EventFilterSpec filter_spec;
+/* The filter is called from any thread pushing events, so filter_spec is guarded */
+static SDL_SpinLock filter_lock = 0;
+static int filter_installed = 0;
+static Uint64 num_filtered = 0;
+static VALUE sym_types, sym_window_ids, sym_joysticks, sym_scancodes;
+static ID id_call;
 
 /*
  * Document-class: SDL2::Event
@@ -76,7 +118,15 @@ static VALUE event_type_to_class[SDL_LASTEVENT];
  * You can read an event from the queue with {SDL2::Event.poll} and
  * you can process the information from the object.
  * 
- * Note: peep and wait will be implemented later.
+ * You can also fetch all pending events at once with {SDL2::Event.poll_all}
+ * or {SDL2::Event.drain}.
+ *
+ * {SDL2::Event.wait} blocks until an event arrives, without blocking
+ * other Ruby threads. Any thread can wake the waiting thread up by
+ * pushing an event with {SDL2::Event.push} or {SDL2::Event::User.push}.
+ *
+ * If {SDL2::Event.coalesce_motion=} is set, consecutive motion events
+ * from the same device are merged before they are fetched.
  *
  * @attribute [rw] type
  *   SDL's internal event type enum
@@ -88,11 +138,57 @@ static VALUE event_type_to_class[SDL_LASTEVENT];
  */
 DEFINE_DATA_TYPE(SDL_Event, free);
 
+static int is_user_event(const SDL_Event* ev)
+{
+    return ev->type >= SDL_USEREVENT && ev->type < SDL_LASTEVENT
+        && ev->type != wakeup_event_type;
+}
+
+/*
+ * If the user event was pushed by Event.push, remove its entry from the
+ * registry, clear data1 and data2, and return the payload; the latency from
+ * pushing is stored to *latency unless latency is NULL.
+ * Return Qundef for user events pushed by other code (e.g. SDL timers),
+ * which are left untouched.
+ */
+static VALUE take_pushed_payload(SDL_Event* e, VALUE* latency)
+{
+    VALUE id, entry;
+
+    if (!e->user.data1)
+        return Qundef;
+    id = ULONG2NUM((unsigned long)(uintptr_t)e->user.data1);
+    entry = rb_hash_aref(user_payloads, id);
+    if (entry == Qnil ||
+        NUM2ULL(rb_ary_entry(entry, 1)) != (unsigned long long)(uintptr_t)e->user.data2)
+        return Qundef;
+    rb_hash_delete(user_payloads, id);
+    if (latency) {
+        /* data2 is the lower bits of the performance counter at pushing */
+        uintptr_t elapsed = (uintptr_t)SDL_GetPerformanceCounter() - (uintptr_t)e->user.data2;
+        *latency = DBL2NUM((double)elapsed / SDL_GetPerformanceFrequency());
+    }
+    e->user.data1 = e->user.data2 = NULL;
+    return rb_ary_entry(entry, 0);
+}
+
+/* Move the payload and the latency of a user event to the event object */
+static void take_user_payload(VALUE obj, SDL_Event* e)
+{
+    VALUE latency = Qnil;
+    VALUE data = take_pushed_payload(e, &latency);
+
+    rb_iv_set(obj, "data", data == Qundef ? Qnil : data);
+    rb_iv_set(obj, "latency", latency);
+}
+
 static VALUE Event_new(SDL_Event* ev)
 {
     SDL_Event* e;
     VALUE obj = TypedData_Make_Struct(event_type_to_class[ev->type], SDL_Event, &SDL_Event_data_type, e);
     *e = *ev;
+    if (is_user_event(e))
+        take_user_payload(obj, e);
     return obj;
 }
 
@@ -110,6 +206,156 @@ static VALUE Event_s_allocate(VALUE klass)
     }
 }
 
+/*
+ * Take all events out of the queue into queue_buffer, and return the number of them.
+ * The events should be put back by put_back_events.
+ */
+static int take_all_events(void)
+{
+    int n;
+
+    SDL_PumpEvents();
+    n = HANDLE_ERROR(SDL_PeepEvents(NULL, 0, SDL_PEEKEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT));
+    if (n == 0)
+        return 0;
+    if (n > queue_buffer_size) {
+        SDL_Event* buf = realloc(queue_buffer, sizeof(SDL_Event) * n);
+        if (!buf)
+            rb_raise(rb_eNoMemError, "Cannot allocate buffer for events");
+        queue_buffer = buf;
+        queue_buffer_size = n;
+    }
+    return HANDLE_ERROR(SDL_PeepEvents(queue_buffer, n, SDL_GETEVENT,
+                                       SDL_FIRSTEVENT, SDL_LASTEVENT));
+}
+
+/* Put the first n events of queue_buffer back to the queue, bypassing the event filter */
+static void put_back_events(int n)
+{
+    if (n > 0 && SDL_PeepEvents(queue_buffer, n, SDL_ADDEVENT, 0, 0) < n)
+        SDL_ERROR();
+}
+
+static int is_motion_event(const SDL_Event* ev)
+{
+    switch (ev->type) {
+    case SDL_MOUSEMOTION:
+    case SDL_JOYAXISMOTION:
+    case SDL_CONTROLLERAXISMOTION:
+    case SDL_FINGERMOTION:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Return true if two motion events come from the same device/axis/finger */
+static int same_motion_source(const SDL_Event* a, const SDL_Event* b)
+{
+    if (a->type != b->type)
+        return 0;
+    switch (a->type) {
+    case SDL_MOUSEMOTION:
+        return a->motion.which == b->motion.which
+            && a->motion.windowID == b->motion.windowID;
+    case SDL_JOYAXISMOTION:
+        return a->jaxis.which == b->jaxis.which && a->jaxis.axis == b->jaxis.axis;
+    case SDL_CONTROLLERAXISMOTION:
+        return a->caxis.which == b->caxis.which && a->caxis.axis == b->caxis.axis;
+    case SDL_FINGERMOTION:
+        return a->tfinger.touchId == b->tfinger.touchId
+            && a->tfinger.fingerId == b->tfinger.fingerId;
+    default:
+        return 0;
+    }
+}
+
+/* Merge a newer motion event into an older one from the same source */
+static void merge_motion(SDL_Event* older, const SDL_Event* newer)
+{
+    switch (newer->type) {
+    case SDL_MOUSEMOTION: {
+        Sint32 xrel = older->motion.xrel + newer->motion.xrel;
+        Sint32 yrel = older->motion.yrel + newer->motion.yrel;
+        older->motion = newer->motion;
+        older->motion.xrel = xrel;
+        older->motion.yrel = yrel;
+        break;
+    }
+    case SDL_FINGERMOTION: {
+        float dx = older->tfinger.dx + newer->tfinger.dx;
+        float dy = older->tfinger.dy + newer->tfinger.dy;
+        older->tfinger = newer->tfinger;
+        older->tfinger.dx = dx;
+        older->tfinger.dy = dy;
+        break;
+    }
+    default:
+        *older = *newer;
+        break;
+    }
+}
+
+/*
+ * Merge consecutive motion events from the same source in the fetched events
+ * in place, and return the new number of events.
+ *
+ * Only directly adjacent events are merged, so the order of motion relative
+ * to other events (including motion from other sources) is kept.
+ */
+static int coalesce_fetched(SDL_Event* events, int n)
+{
+    int i, out;
+
+    if (!coalesce_motion)
+        return n;
+    out = 0;
+    for (i=0; i<n; ++i) {
+        SDL_Event* ev = &events[i];
+        if (out > 0 && is_motion_event(ev) && same_motion_source(&events[out - 1], ev)) {
+            merge_motion(&events[out - 1], ev);
+            ++num_coalesced;
+            continue;
+        }
+        events[out++] = *ev;
+    }
+    return out;
+}
+
+/*
+ * Merge the motion events from the same source as ev (fetched just now)
+ * at the head of the queue into ev.
+ *
+ * Only the head of the queue is examined and taken, so the queue is never
+ * reordered, and the cost is proportional to the number of merged events.
+ */
+static void coalesce_following(SDL_Event* ev)
+{
+    SDL_Event next;
+
+    if (!coalesce_motion || !is_motion_event(ev))
+        return;
+    while (SDL_PeepEvents(&next, 1, SDL_PEEKEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) == 1
+           && same_motion_source(ev, &next)) {
+        /* the head is the first event of its type */
+        if (SDL_PeepEvents(&next, 1, SDL_GETEVENT, next.type, next.type) != 1)
+            break;
+        merge_motion(ev, &next);
+        ++num_coalesced;
+    }
+}
+
+/*
+ * Coalesce the events fetched by SDL_PeepEvents, and return the new number of them.
+ */
+static int coalesce_chunk(SDL_Event* events, int n)
+{
+    n = coalesce_fetched(events, n);
+    if (n > 0)
+        coalesce_following(&events[n - 1]);
+    return n;
+}
+
 /*
  * Poll for currently pending events.
  *
@@ -119,890 +365,2896 @@ static VALUE Event_s_allocate(VALUE klass)
 static VALUE Event_s_poll(VALUE self)
 {
     SDL_Event ev;
+    VALUE event = Qnil;
+    PROFILE_BEGIN(start);
     if (SDL_PollEvent(&ev)) {
-        return Event_new(&ev);
-    } else {
-        return Qnil;
+        coalesce_following(&ev);
+        LATENCY_INPUT(&ev);
+        event = Event_new(&ev);
     }
+    PROFILE_END(PROFILE_EVENT_POLL, start);
+    return event;
+}
+
+struct wait_event_args {
+    SDL_Event ev;
+    int timeout;
+    int result;
+};
+
+static void* wait_event_without_gvl(void* ptr)
+{
+    struct wait_event_args* args = ptr;
+    if (args->timeout < 0)
+        args->result = SDL_WaitEvent(&args->ev);
+    else
+        args->result = SDL_WaitEventTimeout(&args->ev, args->timeout);
+    return NULL;
+}
+
+/* Wake the thread waiting in SDL_WaitEvent{,Timeout} up */
+static void wait_event_unblock(void* ptr)
+{
+    SDL_Event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = wakeup_event_type;
+    SDL_PushEvent(&ev);
 }
 
 /*
- * Get whether the event is enabled.
+ * @overload wait(timeout=nil)
+ *   Wait until an event is available and return it.
  *
- * This method is available for subclasses of SDL2::Event corresponding to
- * SDL's event types.
+ *   The GVL is released during waiting, so other Ruby threads keep running.
+ *   Signals and Thread#raise/Thread#kill interrupt the waiting immediately.
  *
- * @see .enabled= 
+ *   @param [Integer,nil] timeout the maximum number of milliseconds to wait,
+ *     or nil to wait forever
+ *   @return [SDL2::Event] the next event from the queue
+ *   @return [nil] no event arrived before the timeout
+ *
+ *   @example an idle tool which does not burn CPU
+ *     loop do
+ *       ev = SDL2::Event.wait(500)
+ *       redraw if ev.nil? || needs_redraw?(ev)
+ *     end
+ *
+ *   @see .poll
  */
-static VALUE Event_s_enabled_p(VALUE self)
+static VALUE Event_s_wait(int argc, VALUE* argv, VALUE self)
 {
-    VALUE event_type = rb_iv_get(self, "event_type");
-    if (event_type == Qnil) {
-        rb_warn("You cannot enable %s directly", rb_class2name(self));
-        return Qfalse;
+    VALUE timeout;
+    struct wait_event_args args;
+    Uint32 deadline = 0;
+
+    rb_scan_args(argc, argv, "01", &timeout);
+    args.timeout = (timeout == Qnil) ? -1 : NUM2INT(timeout);
+    if (args.timeout >= 0)
+        deadline = SDL_GetTicks() + args.timeout;
+    if (wakeup_event_type == (Uint32)-1) {
+        wakeup_event_type = SDL_RegisterEvents(1);
+        /* a wakeup event fetched by others is a plain SDL2::Event, not a User */
+        if (wakeup_event_type != (Uint32)-1)
+            event_type_to_class[wakeup_event_type] = cEvent;
+    }
+
+    for (;;) {
+        if (wakeup_event_type == (Uint32)-1)
+            rb_thread_call_without_gvl(wait_event_without_gvl, &args, RUBY_UBF_IO, NULL);
+        else
+            rb_thread_call_without_gvl(wait_event_without_gvl, &args, wait_event_unblock, NULL);
+        /* discard wakeup events pushed after SDL_WaitEvent returned */
+        if (wakeup_event_type != (Uint32)-1)
+            SDL_FlushEvent(wakeup_event_type);
+
+        if (args.result && args.ev.type != wakeup_event_type) {
+            coalesce_following(&args.ev);
+            LATENCY_INPUT(&args.ev);
+            return Event_new(&args.ev);
+        }
+
+        rb_thread_check_ints();
+        if (!args.result && args.timeout < 0)
+            SDL_ERROR();
+        if (args.timeout >= 0) {
+            Sint32 rest = (Sint32)(deadline - SDL_GetTicks());
+            if (!args.result || rest <= 0)
+                return Qnil;
+            args.timeout = rest;
+        }
     }
-    return INT2BOOL(SDL_EventState(NUM2INT(event_type), SDL_QUERY) == SDL_ENABLE);
 }
 
 /*
- * @overload enable=(bool)
- *   Set wheter the event is enable
- *   
- *   This method is only available for subclasses of SDL2::Event corresponding to
- *   SDL's event types.
- *
- *   @example disable mouse wheel events
- *     SDL2::Event::MouseWheel.enable = false
- *   
- *   @param [Boolean] bool true for enabling the event.
- *   @return [Boolean]
- *   @see SDL2::Event.enabled?
- *
+ * Convert an argument of event type to SDL_EventType.
+ * An Integer or a subclass of SDL2::Event is accepted; nil is the default.
  */
-static VALUE Event_s_set_enable(VALUE self, VALUE val)
+static Uint32 event_type_arg(VALUE type, Uint32 default_type)
 {
-    VALUE event_type = rb_iv_get(self, "event_type");
-    if (event_type == Qnil) 
-        rb_raise(rb_eArgError, "You cannot enable %s directly", rb_class2name(self));
-    SDL_EventState(NUM2INT(event_type), RTEST(val) ? SDL_ENABLE : SDL_DISABLE);
-    return val;
+    if (type == Qnil)
+        return default_type;
+    if (RB_TYPE_P(type, T_CLASS)) {
+        VALUE event_type = rb_iv_get(type, "event_type");
+        if (event_type == Qnil)
+            rb_raise(rb_eArgError, "%s has no event type", rb_class2name(type));
+        return NUM2UINT(event_type);
+    }
+    return NUM2UINT(type);
 }
 
-static void set_string(char* field, VALUE str, int maxlength)
+/*
+ * Fetch pending events whose type is in [min_type, max_type] by SDL_PeepEvents.
+ * Return the number of fetched events (at most PEEP_CHUNK).
+ */
+static int peep_events(SDL_Event* events, Uint32 min_type, Uint32 max_type)
 {
-    StringValueCStr(str);
-    if (RSTRING_LEN(str) > maxlength)
-        rb_raise(rb_eArgError, "string length must be less than %d", maxlength);
-    strcpy(field, RSTRING_PTR(str));
+    return HANDLE_ERROR(SDL_PeepEvents(events, PEEP_CHUNK, SDL_GETEVENT, min_type, max_type));
 }
 
-#define EVENT_READER(classname, name, field, c2ruby)            \
-    static VALUE Ev##classname##_##name(VALUE self)             \
-    {                                                           \
-        SDL_Event* ev;                                          \
-        TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev); \
-        return c2ruby(ev->field);                               \
-    }                                                           \
-
-#define EVENT_WRITER(classname, name, field, ruby2c)                    \
-    static VALUE Ev##classname##_set_##name(VALUE self, VALUE val)      \
-    {                                                                   \
-        SDL_Event* ev;                                                  \
-        TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev); \
-        ev->field = ruby2c(val);                                        \
-        return Qnil;                                                    \
+/* Get the reusable event object for the type, and overwrite it with ev */
+static VALUE reusable_event(SDL_Event* ev)
+{
+    VALUE obj = rb_ary_entry(reusable_events, ev->type);
+    SDL_Event* e;
+    if (obj == Qnil) {
+        obj = Event_new(ev);
+        rb_ary_store(reusable_events, ev->type, obj);
+        return obj;
     }
+    TypedData_Get_Struct(obj, SDL_Event, &SDL_Event_data_type, e);
+    *e = *ev;
+    if (is_user_event(e))
+        take_user_payload(obj, e);
+    return obj;
+}
 
-#define EVENT_ACCESSOR(classname, name, field, ruby2c, c2ruby)  \
-    EVENT_READER(classname, name, field, c2ruby)                \
-    EVENT_WRITER(classname, name, field, ruby2c)
-
-#define EVENT_ACCESSOR_UINT(classname, name, field) \
-    EVENT_ACCESSOR(classname, name, field, NUM2UINT, UINT2NUM)
+/*
+ * Fetch pending events one by one and yield them; return the number of them.
+ *
+ * Events are not fetched in chunks, so no events are lost when the block
+ * breaks or raises. Only the events pending at the start are yielded, so
+ * the loop terminates even if the block pushes events.
+ */
+static long yield_events(Uint32 min, Uint32 max, int reuse)
+{
+    SDL_Event ev;
+    long count = 0;
+    int pending = HANDLE_ERROR(SDL_PeepEvents(NULL, 0, SDL_PEEKEVENT, min, max));
+
+    while (count < pending) {
+        int n;
+        PROFILE_BEGIN(start);
+        n = HANDLE_ERROR(SDL_PeepEvents(&ev, 1, SDL_GETEVENT, min, max));
+        PROFILE_END(PROFILE_EVENT_POLL, start);
+        if (n == 0)
+            break;
+        coalesce_following(&ev);
+        LATENCY_INPUT(&ev);
+        ++count;
+        rb_yield(reuse ? reusable_event(&ev) : Event_new(&ev));
+    }
+    return count;
+}
 
-#define EVENT_ACCESSOR_UINT8(classname, name, field) \
-    EVENT_ACCESSOR(classname, name, field, NUM2UCHAR, UCHAR2NUM)
+/*
+ * @overload poll_all(min_type=nil, max_type=min_type)
+ * @overload poll_all(min_type=nil, max_type=min_type){|event| ... }
+ *   Fetch all currently pending events at once.
+ *
+ *   Without a block, events are fetched in chunks by SDL_PeepEvents,
+ *   so this is much faster than calling {.poll} repeatedly when many events are queued.
+ *   With a block, events are fetched one at a time, so the events after
+ *   a break or an exception in the block stay in the queue; only the events
+ *   pending at the call are yielded.
+ *
+ *   If **min_type** is given, only events whose type is between **min_type**
+ *   and **max_type** are fetched; other events are left in the queue.
+ *   Types are given as Integers or subclasses of SDL2::Event.
+ *
+ *   @example
+ *     SDL2::Event.poll_all.each{|ev| handle(ev) }
+ *     SDL2::Event.poll_all(SDL2::Event::MouseMotion){|ev| track(ev.x, ev.y) }
+ *
+ *   @param [Integer,Class,nil] min_type the minimum type of events, nil for all events
+ *   @param [Integer,Class,nil] max_type the maximum type of events
+ *   @yieldparam [SDL2::Event] event the fetched event
+ *   @return [Array<SDL2::Event>] fetched events, if a block is not given
+ *   @return [Integer] the number of fetched events, if a block is given
+ *
+ *   @see .poll
+ *   @see .drain
+ */
+static VALUE Event_s_poll_all(int argc, VALUE* argv, VALUE self)
+{
+    VALUE min_type, max_type;
+    VALUE result;
+    SDL_Event events[PEEP_CHUNK];
+    Uint32 min, max;
+    int i, n;
+
+    rb_scan_args(argc, argv, "02", &min_type, &max_type);
+    min = event_type_arg(min_type, SDL_FIRSTEVENT);
+    max = event_type_arg(max_type, min_type == Qnil ? SDL_LASTEVENT : min);
+
+    SDL_PumpEvents();
+    if (rb_block_given_p())
+        return LONG2NUM(yield_events(min, max, 0));
+
+    result = rb_ary_new();
+    do {
+        int fetched;
+        PROFILE_BEGIN(start);
+        fetched = peep_events(events, min, max);
+        n = coalesce_chunk(events, fetched);
+        PROFILE_END(PROFILE_EVENT_POLL, start);
+        for (i=0; i<n; ++i) {
+            LATENCY_INPUT(&events[i]);
+            rb_ary_push(result, Event_new(&events[i]));
+        }
+        n = fetched;
+    } while (n == PEEP_CHUNK);
+
+    return result;
+}
 
-#define EVENT_ACCESSOR_INT(classname, name, field) \
-    EVENT_ACCESSOR(classname, name, field, NUM2INT, INT2NUM)
+/*
+ * @overload drain(min_type=nil, max_type=min_type){|event| ... }
+ *   Fetch all currently pending events and yield them, reusing event objects.
+ *
+ *   This is the same as {.poll_all} with a block, except that no objects are
+ *   allocated in the steady state: one SDL2::Event object is kept for each event type
+ *   and overwritten by the next event of the type. Therefore the yielded event is
+ *   valid only in the block; use {#dup} or {.poll_all} to keep it.
+ *
+ *   Events are fetched one at a time, so the events after a break or
+ *   an exception in the block stay in the queue.
+ *
+ *   @example
+ *     SDL2::Event.drain do |ev|
+ *       case ev
+ *       when SDL2::Event::Quit then exit
+ *       when SDL2::Event::MouseMotion then cursor.move(ev.x, ev.y)
+ *       end
+ *     end
+ *
+ *   @param [Integer,Class,nil] min_type the minimum type of events, nil for all events
+ *   @param [Integer,Class,nil] max_type the maximum type of events
+ *   @yieldparam [SDL2::Event] event the fetched event (reused after the block)
+ *   @return [Integer] the number of fetched events
+ *
+ *   @see .poll_all
+ */
+static VALUE Event_s_drain(int argc, VALUE* argv, VALUE self)
+{
+    VALUE min_type, max_type;
+    Uint32 min, max;
 
-#define EVENT_ACCESSOR_DBL(classname, name, field) \
-    EVENT_ACCESSOR(classname, name, field, NUM2DBL, DBL2NUM)
+    rb_scan_args(argc, argv, "02", &min_type, &max_type);
+    rb_need_block();
+    min = event_type_arg(min_type, SDL_FIRSTEVENT);
+    max = event_type_arg(max_type, min_type == Qnil ? SDL_LASTEVENT : min);
 
-#define EVENT_ACCESSOR_BOOL(classname, name, field)             \
-    EVENT_ACCESSOR(classname, name, field, RTEST, INT2BOOL)
+    SDL_PumpEvents();
+    return LONG2NUM(yield_events(min, max, 1));
+}
 
+/*
+ * A fixed-size projection of SDL_Event written by Event.poll_into.
+ * The layout is "L3l5" in Array#pack notation (native byte order).
+ */
+typedef struct CompactEvent {
+    Uint32 type;
+    Uint32 timestamp;
+    Uint32 which;
+    Sint32 x, y, xrel, yrel;
+    Sint32 value;
+} CompactEvent;
+
+static Sint32 float_bits(float f)
+{
+    Sint32 bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
 
-EVENT_READER(Event, type, common.type, INT2NUM);
-EVENT_ACCESSOR_UINT(Event, timestamp, common.timestamp);
-/* @return [String] inspection string */
-static VALUE Event_inspect(VALUE self)
+static void compact_event(CompactEvent* c, const SDL_Event* ev)
 {
-    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    return rb_sprintf("<%s: type=%u timestamp=%u>",
-                      rb_obj_classname(self), ev->common.type, ev->common.timestamp);
+    memset(c, 0, sizeof(CompactEvent));
+    c->type = ev->type;
+    c->timestamp = ev->common.timestamp;
+    switch (ev->type) {
+    case SDL_WINDOWEVENT:
+        c->which = ev->window.windowID;
+        c->x = ev->window.data1; c->y = ev->window.data2;
+        c->value = ev->window.event;
+        break;
+    case SDL_KEYDOWN: case SDL_KEYUP:
+        c->which = ev->key.windowID;
+        c->x = ev->key.keysym.scancode; c->y = ev->key.keysym.sym;
+        c->xrel = ev->key.keysym.mod; c->yrel = ev->key.repeat;
+        c->value = ev->key.state;
+        break;
+    case SDL_MOUSEMOTION:
+        c->which = ev->motion.which;
+        c->x = ev->motion.x; c->y = ev->motion.y;
+        c->xrel = ev->motion.xrel; c->yrel = ev->motion.yrel;
+        c->value = ev->motion.state;
+        break;
+    case SDL_MOUSEBUTTONDOWN: case SDL_MOUSEBUTTONUP:
+        c->which = ev->button.which;
+        c->x = ev->button.x; c->y = ev->button.y;
+#if SDL_VERSION_ATLEAST(2,0,2)
+        c->xrel = ev->button.clicks;
+#endif
+        c->value = ev->button.button;
+        break;
+    case SDL_MOUSEWHEEL:
+        c->which = ev->wheel.which;
+        c->x = ev->wheel.x; c->y = ev->wheel.y;
+        break;
+    case SDL_JOYAXISMOTION:
+        c->which = ev->jaxis.which;
+        c->x = ev->jaxis.axis;
+        c->value = ev->jaxis.value;
+        break;
+    case SDL_JOYBALLMOTION:
+        c->which = ev->jball.which;
+        c->x = ev->jball.ball;
+        c->xrel = ev->jball.xrel; c->yrel = ev->jball.yrel;
+        break;
+    case SDL_JOYHATMOTION:
+        c->which = ev->jhat.which;
+        c->x = ev->jhat.hat;
+        c->value = ev->jhat.value;
+        break;
+    case SDL_JOYBUTTONDOWN: case SDL_JOYBUTTONUP:
+        c->which = ev->jbutton.which;
+        c->x = ev->jbutton.button;
+        c->value = ev->jbutton.state;
+        break;
+    case SDL_JOYDEVICEADDED: case SDL_JOYDEVICEREMOVED:
+        c->which = ev->jdevice.which;
+        break;
+    case SDL_CONTROLLERAXISMOTION:
+        c->which = ev->caxis.which;
+        c->x = ev->caxis.axis;
+        c->value = ev->caxis.value;
+        break;
+    case SDL_CONTROLLERBUTTONDOWN: case SDL_CONTROLLERBUTTONUP:
+        c->which = ev->cbutton.which;
+        c->x = ev->cbutton.button;
+        c->value = ev->cbutton.state;
+        break;
+    case SDL_CONTROLLERDEVICEADDED: case SDL_CONTROLLERDEVICEREMOVED:
+    case SDL_CONTROLLERDEVICEREMAPPED:
+        c->which = ev->cdevice.which;
+        break;
+    case SDL_FINGERDOWN: case SDL_FINGERUP: case SDL_FINGERMOTION:
+        c->which = (Uint32)ev->tfinger.fingerId;
+        c->x = float_bits(ev->tfinger.x); c->y = float_bits(ev->tfinger.y);
+        c->xrel = float_bits(ev->tfinger.dx); c->yrel = float_bits(ev->tfinger.dy);
+        c->value = float_bits(ev->tfinger.pressure);
+        break;
+    }
 }
 
 /*
- * Return the object of {SDL2::Window} corresponding to the window_id attribute.
- *
- * Some subclasses of SDL2::Event have window_id attribute to point the
- * window which creates the event. The type of the window_id attribute
- * is integer, and you need to convert it with {SDL2::Window.find_by_id}
- * to get the {SDL2::Window} object. This method returns the {SDL2::Window}
- * object.
- *
- * @return [SDL2::Window] the window which creates the event.
- * @raise [NoMethodError] raised if the window_id attribute is not present.
+ * Fetch pending events into the buffer, in records of record_size bytes.
  */
-static VALUE Event_window(VALUE self)
+static VALUE poll_into(int argc, VALUE* argv, int compact)
 {
-    VALUE window_id = rb_funcall(self, rb_intern("window_id"), 0);
-    return find_window_by_id(NUM2UINT(window_id));
+    VALUE buffer, min_type, max_type;
+    SDL_Event events[PEEP_CHUNK];
+    size_t record_size = compact ? sizeof(CompactEvent) : sizeof(SDL_Event);
+    size_t len;
+    char* dst;
+    long capacity, count = 0;
+    Uint32 min, max;
+    int i, n;
+
+    rb_scan_args(argc, argv, "12", &buffer, &min_type, &max_type);
+    min = event_type_arg(min_type, SDL_FIRSTEVENT);
+    max = event_type_arg(max_type, min_type == Qnil ? SDL_LASTEVENT : min);
+    dst = bytes_for_writing(buffer, &len);
+    capacity = len / record_size;
+
+    SDL_PumpEvents();
+    while (count < capacity) {
+        int want = (capacity - count < PEEP_CHUNK) ? (int)(capacity - count) : PEEP_CHUNK;
+        int fetched;
+        PROFILE_BEGIN(start);
+        fetched = HANDLE_ERROR(SDL_PeepEvents(events, want, SDL_GETEVENT, min, max));
+        n = coalesce_chunk(events, fetched);
+        PROFILE_END(PROFILE_EVENT_POLL, start);
+        for (i=0; i<n; ++i, ++count) {
+            LATENCY_INPUT(&events[i]);
+            /* payloads cannot be stored in the buffer; drop their registry entries */
+            if (is_user_event(&events[i]))
+                take_pushed_payload(&events[i], NULL);
+            if (compact)
+                compact_event((CompactEvent*)(dst + count * record_size), &events[i]);
+            else
+                memcpy(dst + count * record_size, &events[i], record_size);
+        }
+        if (fetched < want)
+            break;
+    }
+
+    RB_GC_GUARD(buffer);
+    return LONG2NUM(count);
 }
 
 /*
- * Document-class: SDL2::Event::Quit
- *
- * This class represents the quit requested event.
- *
- * This event occurs when a user try to close window, command-Q on OS X,
- * or any other quit request by a user. Normally if your application
- * receive this event, the application should exit. But the application
- * can query something to the users like "save", or ignore it.
+ * @overload poll_into(buffer, min_type=nil, max_type=min_type)
+ *   Fetch pending events into a binary buffer as compact records,
+ *   without creating any event objects.
+ *
+ *   Each record is {COMPACT_SIZE} (32) bytes long and its layout is {COMPACT_FORMAT}
+ *   ("L3l5") in Array#pack notation: type, timestamp, which, x, y, xrel, yrel, value.
+ *   As many events as fit in the buffer are fetched; the rest are left in the queue.
+ *   The meaning of the fields depends on the type:
+ *
+ *   * Window: which=window_id, x=data1, y=data2, value=event
+ *   * KeyDown/KeyUp: which=window_id, x=scancode, y=sym, xrel=mod, yrel=repeat, value=pressed
+ *   * MouseMotion: which, x, y, xrel, yrel, value=state
+ *   * MouseButtonDown/MouseButtonUp: which, x, y, xrel=clicks, value=button
+ *   * MouseWheel: which, x, y
+ *   * JoyAxisMotion/ControllerAxisMotion: which, x=axis, value
+ *   * JoyBallMotion: which, x=ball, xrel, yrel
+ *   * JoyHatMotion: which, x=hat, value
+ *   * JoyButton*, ControllerButton*: which, x=button, value=pressed
+ *   * JoyDevice*, ControllerDevice*: which
+ *   * Finger*: which=finger_id, x, y, xrel=dx, yrel=dy, value=pressure;
+ *     these fields are 32bit floats (unpack them with "e" or IO::Buffer's :F32)
+ *   * others: only type and timestamp
+ *
+ *   Compare type with {.event_type} of the event classes.
+ *   The payloads of user events pushed by {.push} are discarded.
+ *
+ *   @example
+ *     buf = "\0".b * (SDL2::Event::COMPACT_SIZE * 256)
+ *     n = SDL2::Event.poll_into(buf)
+ *     buf.unpack(SDL2::Event::COMPACT_FORMAT * n).each_slice(8) do |type, _, _, x, y|
+ *       track(x, y) if type == SDL2::Event::MouseMotion.event_type
+ *     end
+ *
+ *   @param [String,IO::Buffer] buffer the destination buffer
+ *   @param [Integer,Class,nil] min_type the minimum type of events, nil for all events
+ *   @param [Integer,Class,nil] max_type the maximum type of events
+ *   @return [Integer] the number of fetched events
+ *
+ *   @see .poll_raw_into
+ *   @see .poll_all
  */
+static VALUE Event_s_poll_into(int argc, VALUE* argv, VALUE self)
+{
+    return poll_into(argc, argv, 1);
+}
 
 /*
- * Document-class: SDL2::Event::Window
- *
- * This class represents window event. This type of event occurs when
- * window state is changed.
- * 
- * @attribute [rw] window_id
- *   the associate window id
- *   @return [Integer]
- *
- * @attribute [rw] event
- *   event type, one of the following:
+ * @overload poll_raw_into(buffer, min_type=nil, max_type=min_type)
+ *   Fetch pending events into a binary buffer as raw SDL_Event structs.
  *
- *   * SDL2::Event::Window::NONE - (never used)
- *   * SDL2::Event::Window::SHOWN - window has been shown
- *   * SDL2::Event::Window::HIDDEN - window has been hidden
- *   * SDL2::Event::Window::EXPOSED - window has been exposed and should be redrawn
- *   * SDL2::Event::Window::MOVED - window has been moved to data1, data2
- *   * SDL2::Event::Window::RESIZED - window has been resized to data1xdata2;
- *       this is event is always preceded by SIZE_CHANGED
- *   * SDL2::Event::Window::SIZE_CHANGED -
- *       window size has changed, either as a result of an API call or through
- *       the system or user changing the window size;
- *       this event is followed by
- *       RESIZED if the size was changed by an external event,
- *       i.e. the user or the window manager
- *   * SDL2::Event::Window::MINIMIZED - window has been minimized
- *   * SDL2::Event::Window::MAXIMIZED - window has been maximized
- *   * SDL2::Event::Window::RESTORED - window has been restored to normal size and position
- *   * SDL2::Event::Window::ENTER - window has gained mouse focus
- *   * SDL2::Event::Window::LEAVE - window has lost mouse focus
- *   * SDL2::Event::Window::FOCUS_GAINED - window has gained keyboard focus
- *   * SDL2::Event::Window::FOCUS_LOST -window has lost keyboard focus
- *   * SDL2::Event::Window::CLOSE - 
- *       the window manager requests that the window be closed
- *   
- *   @return [Integer]
+ *   Each record is {RAW_SIZE} bytes long, and its layout is the same as SDL_Event
+ *   of the SDL library. Use this when the records are passed to other native code;
+ *   otherwise {.poll_into} is easier to decode.
  *
- * @attribute data1
- *   event dependent data
- *   @return [Integer]
+ *   The payloads of user events pushed by {.push} are discarded, and data1
+ *   and data2 of those events are cleared.
  *
- * @attribute data2
- *   event dependent data
- *   @return [Integer]
+ *   @param [String,IO::Buffer] buffer the destination buffer
+ *   @param [Integer,Class,nil] min_type the minimum type of events, nil for all events
+ *   @param [Integer,Class,nil] max_type the maximum type of events
+ *   @return [Integer] the number of fetched events
  *
+ *   @see .poll_into
  */
-EVENT_ACCESSOR_UINT(Window, window_id, window.windowID);
-EVENT_ACCESSOR_UINT(Window, event, window.event);
-EVENT_ACCESSOR_INT(Window, data1, window.data1);
-EVENT_ACCESSOR_INT(Window, data2, window.data2);
-
-/* @return [String] inspection string */
-static VALUE EvWindow_inspect(VALUE self)
+static VALUE Event_s_poll_raw_into(int argc, VALUE* argv, VALUE self)
 {
-    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    return rb_sprintf("<%s: type=%u timestamp=%u window_id=%u event=%u data1=%d data2=%d>",
-                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->window.windowID, ev->window.event,
-                      ev->window.data1, ev->window.data2);
+    return poll_into(argc, argv, 0);
 }
 
 /*
- * Document-class: SDL2::Event::Keyboard
+ * Get the SDL event type corresponding to the event class.
  *
- * This class represents keyboard event.
+ * @example
+ *   SDL2::Event::Quit.event_type # => 256
+ *
+ * @return [Integer] the event type
+ * @return [nil] for classes not corresponding to one event type (e.g. SDL2::Event::Keyboard)
+ */
+static VALUE Event_s_event_type(VALUE self)
+{
+    return rb_iv_get(self, "event_type");
+}
+
+/*
+ * Get whether motion events are coalesced.
+ *
+ * @return [Boolean]
+ * @see .coalesce_motion=
+ */
+static VALUE Event_s_coalesce_motion_p(VALUE self)
+{
+    return INT2BOOL(coalesce_motion);
+}
+
+/*
+ * @overload coalesce_motion=(enabled)
+ *   Enable or disable coalescing of motion events.
+ *
+ *   When enabled, consecutive {SDL2::Event::MouseMotion}, {SDL2::Event::JoyAxisMotion},
+ *   {SDL2::Event::ControllerAxisMotion} and {SDL2::Event::FingerMotion} events
+ *   from the same mouse, axis or finger are merged into one event
+ *   when they are fetched by {.poll}, {.poll_all}, {.drain}, {.poll_into},
+ *   {.poll_raw_into}, {.wait} and {SDL2::EventDispatcher#dispatch}.
+ *   When a motion event is fetched, the following motion events from
+ *   the same source at the head of the queue are taken and merged into it;
+ *   the rest of the queue is not touched, so events are never reordered.
+ *   The merged event has the latest absolute values (position, axis value, state, timestamp)
+ *   and the sum of the relative motions (xrel/yrel of mouse, dx/dy of finger).
+ *
+ *   Motion events separated by other events (for example, a button press or
+ *   motion from another device) are not merged, so the position at the time
+ *   of a click and the order between devices are kept.
+ *
+ *   With high-rate mice and analog sticks, this reduces the number of event objects
+ *   to about one per device per frame. Coalescing is disabled by default.
+ *
+ *   @param [Boolean] enabled true to enable coalescing
+ *   @return [Boolean]
+ *
+ *   @example
+ *     SDL2::Event.coalesce_motion = true
+ *     while ev = SDL2::Event.poll
+ *       cursor.move_by(ev.xrel, ev.yrel) if ev.is_a?(SDL2::Event::MouseMotion)
+ *     end
+ */
+static VALUE Event_s_set_coalesce_motion(VALUE self, VALUE enabled)
+{
+    coalesce_motion = RTEST(enabled);
+    return enabled;
+}
+
+/*
+ * Get the number of motion events merged into others by coalescing.
+ *
+ * @return [Integer]
+ * @see .coalesce_motion=
+ */
+static VALUE Event_s_coalesced_count(VALUE self)
+{
+    return ULL2NUM(num_coalesced);
+}
+
+/* Get the window ID of the event; return 0 if the event has no window ID */
+static int event_window_id(const SDL_Event* ev, Uint32* id)
+{
+    switch (ev->type) {
+    case SDL_WINDOWEVENT: *id = ev->window.windowID; return 1;
+    case SDL_KEYDOWN: case SDL_KEYUP: *id = ev->key.windowID; return 1;
+    case SDL_TEXTEDITING: *id = ev->edit.windowID; return 1;
+    case SDL_TEXTINPUT: *id = ev->text.windowID; return 1;
+    case SDL_MOUSEMOTION: *id = ev->motion.windowID; return 1;
+    case SDL_MOUSEBUTTONDOWN: case SDL_MOUSEBUTTONUP: *id = ev->button.windowID; return 1;
+    case SDL_MOUSEWHEEL: *id = ev->wheel.windowID; return 1;
+#if SDL_VERSION_ATLEAST(2,0,12)
+    case SDL_FINGERDOWN: case SDL_FINGERUP: case SDL_FINGERMOTION:
+        *id = ev->tfinger.windowID; return 1;
+#endif
+    default: return 0;
+    }
+}
+
+/*
+ * Get the joystick instance ID of the event; return 0 if the event has no instance ID.
+ * JOYDEVICEADDED and CONTROLLERDEVICEADDED have a device index, not an instance ID.
+ */
+static int event_joystick_id(const SDL_Event* ev, SDL_JoystickID* id)
+{
+    switch (ev->type) {
+    case SDL_JOYAXISMOTION: *id = ev->jaxis.which; return 1;
+    case SDL_JOYBALLMOTION: *id = ev->jball.which; return 1;
+    case SDL_JOYHATMOTION: *id = ev->jhat.which; return 1;
+    case SDL_JOYBUTTONDOWN: case SDL_JOYBUTTONUP: *id = ev->jbutton.which; return 1;
+    case SDL_JOYDEVICEREMOVED: *id = ev->jdevice.which; return 1;
+    case SDL_CONTROLLERAXISMOTION: *id = ev->caxis.which; return 1;
+    case SDL_CONTROLLERBUTTONDOWN: case SDL_CONTROLLERBUTTONUP: *id = ev->cbutton.which; return 1;
+    case SDL_CONTROLLERDEVICEREMOVED: case SDL_CONTROLLERDEVICEREMAPPED:
+        *id = ev->cdevice.which; return 1;
+    default: return 0;
+    }
+}
+
+#define BIT_TEST(bits, i) ((bits)[(i) >> 3] & (1 << ((i) & 7)))
+#define BIT_SET(bits, i) ((bits)[(i) >> 3] |= (1 << ((i) & 7)))
+
+/* Return true if the event should be dropped; filter_lock must be held */
+static int filter_drops(const SDL_Event* ev)
+{
+    Uint32 window_id;
+    SDL_JoystickID joystick_id;
+    int i;
+
+    if (ev->type < SDL_LASTEVENT && BIT_TEST(filter_spec.types, ev->type))
+        return 1;
+    if ((ev->type == SDL_KEYDOWN || ev->type == SDL_KEYUP) &&
+        (unsigned)ev->key.keysym.scancode < SDL_NUM_SCANCODES &&
+        BIT_TEST(filter_spec.scancodes, ev->key.keysym.scancode))
+        return 1;
+    if (filter_spec.num_window_ids > 0 && event_window_id(ev, &window_id)) {
+        for (i=0; i<filter_spec.num_window_ids; ++i)
+            if (filter_spec.window_ids[i] == window_id)
+                return 1;
+    }
+    if (filter_spec.num_joysticks > 0 && event_joystick_id(ev, &joystick_id)) {
+        for (i=0; i<filter_spec.num_joysticks; ++i)
+            if (filter_spec.joysticks[i] == joystick_id)
+                return 1;
+    }
+    return 0;
+}
+
+/* The callback for SDL_SetEventFilter and SDL_FilterEvents */
+static int SDLCALL event_filter(void* userdata, SDL_Event* ev)
+{
+    int drop;
+
+    SDL_AtomicLock(&filter_lock);
+    drop = filter_spec.active && filter_drops(ev);
+    if (drop)
+        ++num_filtered;
+    SDL_AtomicUnlock(&filter_lock);
+    return !drop;
+}
+
+/* Replace filter_spec with spec, and free the old lists */
+static void swap_filter_spec(EventFilterSpec* spec)
+{
+    EventFilterSpec old;
+
+    SDL_AtomicLock(&filter_lock);
+    old = filter_spec;
+    filter_spec = *spec;
+    SDL_AtomicUnlock(&filter_lock);
+    free(old.window_ids);
+    free(old.joysticks);
+}
+
+/* Convert an Array of Integers (or nil) to a String of packed Sint32 */
+static VALUE filter_id_list(VALUE ary)
+{
+    VALUE packed;
+    Sint32* ids;
+    long i, n;
+
+    if (ary == Qnil)
+        return rb_str_new(NULL, 0);
+    Check_Type(ary, T_ARRAY);
+    n = RARRAY_LEN(ary);
+    packed = rb_str_new(NULL, sizeof(Sint32) * n);
+    ids = (Sint32*)RSTRING_PTR(packed);
+    for (i=0; i<n; ++i)
+        ids[i] = (Sint32)NUM2LONG(rb_ary_entry(ary, i));
+    return packed;
+}
+
+/*
+ * Copy a String returned by filter_id_list to a malloc'ed array of 32-bit IDs
+ * (Uint32 window IDs or SDL_JoystickID), and set the number of IDs to *n
+ * (-1 on failure).
+ */
+static void* copy_id_list(VALUE packed, int* n)
+{
+    long size = RSTRING_LEN(packed);
+    void* ids;
+    *n = 0;
+    if (size == 0)
+        return NULL;
+    ids = malloc(size);
+    if (!ids) {
+        *n = -1;
+        return NULL;
+    }
+    memcpy(ids, RSTRING_PTR(packed), size);
+    *n = (int)(size / sizeof(Sint32));
+    return ids;
+}
+
+/*
+ * @overload set_filter(params)
+ *   Install a native filter which drops unwanted events before they are queued.
+ *
+ *   Events matching any of the given conditions are discarded in C by
+ *   SDL's event filter (SDL_SetEventFilter), so no SDL2::Event object is
+ *   allocated for them. Events already in the queue are also filtered.
+ *   Calling this method again replaces the conditions.
+ *
+ *   Unlike {.enable=}, the conditions can select events by the window, the joystick
+ *   and the key, not only by the type.
+ *
+ *   @param [Hash] params the conditions of dropped events
+ *   @option params [Array<Integer,Class>] :types event types to drop
+ *     (Integers or subclasses of SDL2::Event such as SDL2::Event::MouseMotion)
+ *   @option params [Array<Integer>] :window_ids drop events sent to
+ *     the windows with these IDs ({SDL2::Window#window_id})
+ *   @option params [Array<Integer>] :joysticks drop events from the joysticks
+ *     and game controllers with these instance IDs
+ *   @option params [Array<Integer>] :scancodes drop {SDL2::Event::KeyDown}/{SDL2::Event::KeyUp}
+ *     events with these scancodes ({SDL2::Key::Scan})
+ *   @return [nil]
+ *
+ *   @example ignore mouse motion and events of the palette window
+ *     SDL2::Event.set_filter(types: [SDL2::Event::MouseMotion],
+ *                            window_ids: [palette.window_id])
+ *
+ *   @note This method should be called from the thread that
+ *     initialized the video subsystem.
+ *   @see .clear_filter
+ *   @see .filtered_count
+ */
+static VALUE Event_s_set_filter(VALUE self, VALUE params)
+{
+    EventFilterSpec spec;
+    VALUE types, scancodes, window_ids, joysticks;
+    long i;
+
+    Check_Type(params, T_HASH);
+    memset(&spec, 0, sizeof(spec));
+    spec.active = 1;
+
+    types = rb_hash_aref(params, sym_types);
+    if (types != Qnil) {
+        Check_Type(types, T_ARRAY);
+        for (i=0; i<RARRAY_LEN(types); ++i) {
+            Uint32 type = event_type_arg(rb_ary_entry(types, i), 0);
+            if (type >= SDL_LASTEVENT)
+                rb_raise(rb_eArgError, "event type out of range (%u)", type);
+            BIT_SET(spec.types, type);
+        }
+    }
+    scancodes = rb_hash_aref(params, sym_scancodes);
+    if (scancodes != Qnil) {
+        Check_Type(scancodes, T_ARRAY);
+        for (i=0; i<RARRAY_LEN(scancodes); ++i) {
+            int scancode = NUM2INT(rb_ary_entry(scancodes, i));
+            if (scancode < 0 || scancode >= SDL_NUM_SCANCODES)
+                rb_raise(rb_eArgError, "scancode out of range (%d)", scancode);
+            BIT_SET(spec.scancodes, scancode);
+        }
+    }
+    window_ids = filter_id_list(rb_hash_aref(params, sym_window_ids));
+    joysticks = filter_id_list(rb_hash_aref(params, sym_joysticks));
+    spec.window_ids = copy_id_list(window_ids, &spec.num_window_ids);
+    spec.joysticks = copy_id_list(joysticks, &spec.num_joysticks);
+    if (spec.num_window_ids < 0 || spec.num_joysticks < 0) {
+        free(spec.window_ids);
+        free(spec.joysticks);
+        rb_raise(rb_eNoMemError, "Cannot allocate event filter");
+    }
+    RB_GC_GUARD(window_ids); RB_GC_GUARD(joysticks);
+    swap_filter_spec(&spec);
+
+    if (!filter_installed) {
+        /* SDL_SetEventFilter discards all pending events, so keep them aside */
+        int n = take_all_events();
+        SDL_SetEventFilter(event_filter, NULL);
+        filter_installed = 1;
+        put_back_events(n);
+    }
+    SDL_FilterEvents(event_filter, NULL);
+    return Qnil;
+}
+
+/*
+ * Remove the filter installed by {.set_filter}.
+ *
+ * @return [nil]
+ */
+static VALUE Event_s_clear_filter(VALUE self)
+{
+    EventFilterSpec spec;
+    memset(&spec, 0, sizeof(spec));
+    swap_filter_spec(&spec);
+    return Qnil;
+}
+
+/*
+ * Get the number of events dropped by the filter installed by {.set_filter}.
+ *
+ * @return [Integer]
+ */
+static VALUE Event_s_filtered_count(VALUE self)
+{
+    return ULL2NUM(num_filtered);
+}
+
+struct push_event_args {
+    SDL_Event ev;
+    int result;
+};
+
+static void* push_event_without_gvl(void* ptr)
+{
+    struct push_event_args* args = ptr;
+    args->result = SDL_PushEvent(&args->ev);
+    return NULL;
+}
+
+/*
+ * Push an event to the queue. If the event is a user event, data is
+ * kept in the payload registry until the event is fetched.
+ */
+static VALUE push_event(const SDL_Event* ev, VALUE data)
+{
+    struct push_event_args args;
+    VALUE id = Qnil;
+
+    args.ev = *ev;
+    if (is_user_event(ev)) {
+        uintptr_t counter = (uintptr_t)SDL_GetPerformanceCounter();
+        if (++last_payload_id == 0)
+            ++last_payload_id;
+        id = ULONG2NUM(last_payload_id);
+        rb_hash_aset(user_payloads, id, rb_assoc_new(data, ULL2NUM(counter)));
+        args.ev.user.data1 = (void*)(uintptr_t)last_payload_id;
+        args.ev.user.data2 = (void*)counter;
+    }
+    /* SDL_PushEvent may wait for the lock of the queue; other Ruby threads keep running */
+    rb_thread_call_without_gvl(push_event_without_gvl, &args, RUBY_UBF_IO, NULL);
+    if (args.result <= 0 && id != Qnil)
+        rb_hash_delete(user_payloads, id);
+    if (args.result < 0)
+        SDL_ERROR();
+    return INT2BOOL(args.result == 1);
+}
+
+/*
+ * @overload push(event)
+ *   Push an event to the event queue.
+ *
+ *   This method can be called from any Ruby thread, for example, to wake
+ *   the main loop waiting in {.wait} up from a loader or network thread.
+ *   The GVL is released while SDL pushes the event.
+ *
+ *   If the event is a {SDL2::Event::User}, its {SDL2::Event::User#data} is
+ *   kept in a registry on the Ruby side and only an ID is passed to SDL,
+ *   so the object is not touched by other native threads.
+ *   data1 and data2 of pushed user events are used for the ID and a tag;
+ *   user events pushed by other code (e.g. SDL timers) have no data and no latency.
+ *
+ *   @param [SDL2::Event] event the event to push
+ *   @return [Boolean] false if the event is dropped by the event filter
+ *   @raise [SDL2::Error] raised when the event queue is full
+ *
+ *   @see SDL2::Event::User.push
+ */
+static VALUE Event_s_push(VALUE self, VALUE event)
+{
+    SDL_Event* ev;
+    TypedData_Get_Struct(event, SDL_Event, &SDL_Event_data_type, ev);
+    return push_event(ev, is_user_event(ev) ? rb_iv_get(event, "data") : Qnil);
+}
+
+/*
+ * @overload register_types(num=1)
+ *   Allocate user-defined event types.
+ *
+ *   @param [Integer] num the number of event types to allocate
+ *   @return [Integer] the first allocated type; types from the returned value to
+ *     (the returned value + num - 1) are available for {SDL2::Event::User}
+ *   @raise [SDL2::Error] raised when there are not enough user-defined types left
+ */
+static VALUE Event_s_register_types(int argc, VALUE* argv, VALUE self)
+{
+    VALUE num;
+    Uint32 type;
+
+    rb_scan_args(argc, argv, "01", &num);
+    type = SDL_RegisterEvents(num == Qnil ? 1 : NUM2INT(num));
+    if (type == (Uint32)-1)
+        rb_raise(eSDL2Error, "no more user-defined event types");
+    return UINT2NUM(type);
+}
+
+/*
+ * Get whether the event is enabled.
+ *
+ * This method is available for subclasses of SDL2::Event corresponding to
+ * SDL's event types.
+ *
+ * @see .enabled= 
+ */
+static VALUE Event_s_enabled_p(VALUE self)
+{
+    VALUE event_type = rb_iv_get(self, "event_type");
+    if (event_type == Qnil) {
+        rb_warn("You cannot enable %s directly", rb_class2name(self));
+        return Qfalse;
+    }
+    return INT2BOOL(SDL_EventState(NUM2INT(event_type), SDL_QUERY) == SDL_ENABLE);
+}
+
+/*
+ * @overload enable=(bool)
+ *   Set wheter the event is enable
+ *   
+ *   This method is only available for subclasses of SDL2::Event corresponding to
+ *   SDL's event types.
+ *
+ *   @example disable mouse wheel events
+ *     SDL2::Event::MouseWheel.enable = false
+ *   
+ *   @param [Boolean] bool true for enabling the event.
+ *   @return [Boolean]
+ *   @see SDL2::Event.enabled?
+ *
+ */
+static VALUE Event_s_set_enable(VALUE self, VALUE val)
+{
+    VALUE event_type = rb_iv_get(self, "event_type");
+    if (event_type == Qnil) 
+        rb_raise(rb_eArgError, "You cannot enable %s directly", rb_class2name(self));
+    SDL_EventState(NUM2INT(event_type), RTEST(val) ? SDL_ENABLE : SDL_DISABLE);
+    return val;
+}
+
+static void set_string(char* field, VALUE str, int maxlength)
+{
+    StringValueCStr(str);
+    if (RSTRING_LEN(str) > maxlength)
+        rb_raise(rb_eArgError, "string length must be less than %d", maxlength);
+    strcpy(field, RSTRING_PTR(str));
+}
+
+#define EVENT_READER(classname, name, field, c2ruby)            \
+    static VALUE Ev##classname##_##name(VALUE self)             \
+    {                                                           \
+        SDL_Event* ev;                                          \
+        TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev); \
+        return c2ruby(ev->field);                               \
+    }                                                           \
+
+#define EVENT_WRITER(classname, name, field, ruby2c)                    \
+    static VALUE Ev##classname##_set_##name(VALUE self, VALUE val)      \
+    {                                                                   \
+        SDL_Event* ev;                                                  \
+        TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev); \
+        ev->field = ruby2c(val);                                        \
+        return Qnil;                                                    \
+    }
+
+#define EVENT_ACCESSOR(classname, name, field, ruby2c, c2ruby)  \
+    EVENT_READER(classname, name, field, c2ruby)                \
+    EVENT_WRITER(classname, name, field, ruby2c)
+
+#define EVENT_ACCESSOR_UINT(classname, name, field) \
+    EVENT_ACCESSOR(classname, name, field, NUM2UINT, UINT2NUM)
+
+#define EVENT_ACCESSOR_UINT8(classname, name, field) \
+    EVENT_ACCESSOR(classname, name, field, NUM2UCHAR, UCHAR2NUM)
+
+#define EVENT_ACCESSOR_INT(classname, name, field) \
+    EVENT_ACCESSOR(classname, name, field, NUM2INT, INT2NUM)
+
+#define EVENT_ACCESSOR_DBL(classname, name, field) \
+    EVENT_ACCESSOR(classname, name, field, NUM2DBL, DBL2NUM)
+
+#define EVENT_ACCESSOR_BOOL(classname, name, field)             \
+    EVENT_ACCESSOR(classname, name, field, RTEST, INT2BOOL)
+
+
+EVENT_READER(Event, type, common.type, INT2NUM);
+EVENT_ACCESSOR_UINT(Event, timestamp, common.timestamp);
+/* @return [self] copy of the event */
+static VALUE Event_initialize_copy(VALUE self, VALUE other)
+{
+    SDL_Event* dst;
+    SDL_Event* src;
+    TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, dst);
+    TypedData_Get_Struct(other, SDL_Event, &SDL_Event_data_type, src);
+    *dst = *src;
+    return self;
+}
+
+/* @return [String] inspection string */
+static VALUE Event_inspect(VALUE self)
+{
+    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    return rb_sprintf("<%s: type=%u timestamp=%u>",
+                      rb_obj_classname(self), ev->common.type, ev->common.timestamp);
+}
+
+/*
+ * Return the object of {SDL2::Window} corresponding to the window_id attribute.
+ *
+ * Some subclasses of SDL2::Event have window_id attribute to point the
+ * window which creates the event. The type of the window_id attribute
+ * is integer, and you need to convert it with {SDL2::Window.find_by_id}
+ * to get the {SDL2::Window} object. This method returns the {SDL2::Window}
+ * object.
+ *
+ * @return [SDL2::Window] the window which creates the event.
+ * @raise [NoMethodError] raised if the window_id attribute is not present.
+ */
+static VALUE Event_window(VALUE self)
+{
+    VALUE window_id = rb_funcall(self, rb_intern("window_id"), 0);
+    return find_window_by_id(NUM2UINT(window_id));
+}
+
+/*
+ * Document-class: SDL2::Event::Quit
+ *
+ * This class represents the quit requested event.
+ *
+ * This event occurs when a user try to close window, command-Q on OS X,
+ * or any other quit request by a user. Normally if your application
+ * receive this event, the application should exit. But the application
+ * can query something to the users like "save", or ignore it.
+ */
+
+/*
+ * Document-class: SDL2::Event::Window
+ *
+ * This class represents window event. This type of event occurs when
+ * window state is changed.
+ * 
+ * @attribute [rw] window_id
+ *   the associate window id
+ *   @return [Integer]
+ *
+ * @attribute [rw] event
+ *   event type, one of the following:
+ *
+ *   * SDL2::Event::Window::NONE - (never used)
+ *   * SDL2::Event::Window::SHOWN - window has been shown
+ *   * SDL2::Event::Window::HIDDEN - window has been hidden
+ *   * SDL2::Event::Window::EXPOSED - window has been exposed and should be redrawn
+ *   * SDL2::Event::Window::MOVED - window has been moved to data1, data2
+ *   * SDL2::Event::Window::RESIZED - window has been resized to data1xdata2;
+ *       this is event is always preceded by SIZE_CHANGED
+ *   * SDL2::Event::Window::SIZE_CHANGED -
+ *       window size has changed, either as a result of an API call or through
+ *       the system or user changing the window size;
+ *       this event is followed by
+ *       RESIZED if the size was changed by an external event,
+ *       i.e. the user or the window manager
+ *   * SDL2::Event::Window::MINIMIZED - window has been minimized
+ *   * SDL2::Event::Window::MAXIMIZED - window has been maximized
+ *   * SDL2::Event::Window::RESTORED - window has been restored to normal size and position
+ *   * SDL2::Event::Window::ENTER - window has gained mouse focus
+ *   * SDL2::Event::Window::LEAVE - window has lost mouse focus
+ *   * SDL2::Event::Window::FOCUS_GAINED - window has gained keyboard focus
+ *   * SDL2::Event::Window::FOCUS_LOST -window has lost keyboard focus
+ *   * SDL2::Event::Window::CLOSE - 
+ *       the window manager requests that the window be closed
+ *   
+ *   @return [Integer]
+ *
+ * @attribute data1
+ *   event dependent data
+ *   @return [Integer]
+ *
+ * @attribute data2
+ *   event dependent data
+ *   @return [Integer]
+ *
+ */
+EVENT_ACCESSOR_UINT(Window, window_id, window.windowID);
+EVENT_ACCESSOR_UINT(Window, event, window.event);
+EVENT_ACCESSOR_INT(Window, data1, window.data1);
+EVENT_ACCESSOR_INT(Window, data2, window.data2);
+
+/* @return [String] inspection string */
+static VALUE EvWindow_inspect(VALUE self)
+{
+    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    return rb_sprintf("<%s: type=%u timestamp=%u window_id=%u event=%u data1=%d data2=%d>",
+                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
+                      ev->window.windowID, ev->window.event,
+                      ev->window.data1, ev->window.data2);
+}
+
+/*
+ * Document-class: SDL2::Event::Keyboard
+ *
+ * This class represents keyboard event.
+ *
+ * You don't handle the instance 
+ * of this class directly, but you handle the instances of 
+ * two subclasses of this subclasses:
+ * {SDL2::Event::KeyDown} and {SDL2::Event::KeyUp}.
+ *
+ * @attribute [rw] window_id
+ *   the associate window id
+ *   @return [Integer]
+ *
+ * @attribute pressed
+ *   key is pressed
+ *   @return [boolean]
+ *
+ * @attribute repeat
+ *   key repeat
+ *   @return [boolean]
+ *   
+ * @attribute scancode
+ *   physical key code
+ *   @return [Integer]
+ *   @see SDL2::Key::Scan
+ *
+ * @attribute sym
+ *   virtual key code
+ *   @return [Integer]
+ *   @see SDL2::Key
+ *
+ * @attribute mod
+ *   current key modifier
+ *   @return [Integer]
+ *   @see SDL2::Key::Mod
+ *   
+ */
+EVENT_ACCESSOR_UINT(Keyboard, window_id, key.windowID);
+EVENT_ACCESSOR_BOOL(Keyboard, pressed, key.state);
+EVENT_ACCESSOR_BOOL(Keyboard, repeat, key.repeat);
+EVENT_ACCESSOR_UINT(Keyboard, scancode, key.keysym.scancode);
+EVENT_ACCESSOR_UINT(Keyboard, sym, key.keysym.sym);
+EVENT_ACCESSOR_UINT(Keyboard, mod, key.keysym.mod);
+/* @return [String] inspection string */
+static VALUE EvKeyboard_inspect(VALUE self)
+{
+    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    return rb_sprintf("<%s: type=%u timestamp=%u"
+                      " window_id=%u state=%u repeat=%u"
+                      " scancode=%u sym=%u mod=%u>",
+                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
+                      ev->key.windowID, ev->key.state, ev->key.repeat,
+                      ev->key.keysym.scancode, ev->key.keysym.sym, ev->key.keysym.mod);
+}
+
+
+/*
+ * Document-class: SDL2::Event::KeyDown
+ *
+ * This class represents a key down event.
+ */
+
+/*
+ * Document-class: SDL2::Event::KeyUp
+ *
+ * This class represents a key up event.
+ */
+
+/*
+ * Document-class: SDL2::Event::TextEditing
+ *
+ * This class represents text editing event.
+ *
+ * @attribute window_id
+ *   the associate window id
+ *   @return [Integer]
+ *
+ * @attribute text
+ *   the editing text
+ *   @return [String]
+ *
+ * @attribute start
+ *   the start cursor of selected editing text
+ *   @return [Integer]
+ *
+ * @attribute length
+ *   the length of selected editing text
+ *   @return [Integer]
+ */
+EVENT_ACCESSOR_UINT(TextEditing, window_id, edit.windowID);
+EVENT_ACCESSOR_INT(TextEditing, start, edit.start);
+EVENT_ACCESSOR_INT(TextEditing, length, edit.length);
+EVENT_READER(TextEditing, text, edit.text, utf8str_new_cstr);
+static VALUE EvTextEditing_set_text(VALUE self, VALUE str)
+{
+    SDL_Event* ev;
+    TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    set_string(ev->edit.text, str, 30);
+    return str;
+}
+
+/* @return [String] inspection string */
+static VALUE EvTextEditing_inspect(VALUE self)
+{
+    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    return rb_sprintf("<%s: type=%u timestamp=%u"
+                      " window_id=%u text=%s start=%d length=%d>",
+                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
+                      ev->edit.windowID, ev->edit.text, ev->edit.start, ev->edit.length);
+}
+
+
+/*
+ * Document-class: SDL2::Event::TextInput
+ *
+ * This class represents text input events.
+ *
+ * @attribute window_id
+ *   the associate window id
+ *   @return [Integer]
+ *
+ * @attribute text
+ *   the input text
+ *   @return [String]
+ */
+EVENT_ACCESSOR_UINT(TextInput, window_id, text.windowID);
+EVENT_READER(TextInput, text, text.text, utf8str_new_cstr);
+static VALUE EvTextInput_set_text(VALUE self, VALUE str)
+{
+    SDL_Event* ev;
+    TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    set_string(ev->text.text, str, 30);
+    return str;
+}
+
+/* @return [String] inspection string */
+static VALUE EvTextInput_inspect(VALUE self)
+{
+    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    return rb_sprintf("<%s: type=%u timestamp=%u window_id=%u text=%s>",
+                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
+                      ev->text.windowID, ev->text.text);
+}
+
+/*
+ * Document-class: SDL2::Event::MouseButton
+ *
+ * This class represents mouse button events.
+ * 
+ * You don't handle the instance 
+ * of this class directly, but you handle the instances of 
+ * two subclasses of this subclasses:
+ * {SDL2::Event::MouseButtonDown} and {SDL2::Event::MouseButtonUp}.
+ *
+ * @attribute window_id
+ *   the window id with mouse focus
+ *   @return [Integer]
+ *
+ * @attribute which
+ *   the mouse index
+ *   @return [Integer]
+ *
+ * @attribute button
+ *   the mouse button index
+ *   @return [Integer]
+ *
+ * @attribute pressed
+ *   button is pressed or not
+ *   @return [Boolean]
+ *
+ * @attribute clicks
+ *   1 for single click, 2 for double click
+ *   
+ *   This attribute is available after SDL 2.0.2
+ *   @return [Integer]
+ *
+ * @attribute x
+ *   the x coordinate of the mouse pointer, relative to window
+ *   @return [Integer]
+ *
+ * @attribute y
+ *   the y coordinate of the mouse pointer, relative to window
+ *   @return [Integer]
+ */
+EVENT_ACCESSOR_UINT(MouseButton, window_id, button.windowID);
+EVENT_ACCESSOR_UINT(MouseButton, which, button.which);
+EVENT_ACCESSOR_UINT8(MouseButton, button, button.button);
+EVENT_ACCESSOR_BOOL(MouseButton, pressed, button.state);
+#if SDL_VERSION_ATLEAST(2,0,2)
+EVENT_ACCESSOR_UINT8(MouseButton, clicks, button.clicks);
+#endif
+EVENT_ACCESSOR_INT(MouseButton, x, button.x);
+EVENT_ACCESSOR_INT(MouseButton, y, button.y);
+/* @return [String] inspection string */
+static VALUE EvMouseButton_inspect(VALUE self)
+{
+    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    return rb_sprintf("<%s: type=%u timestamp=%u"
+                      " window_id=%u which=%u button=%hhu pressed=%s"
+#if SDL_VERSION_ATLEAST(2,0,2)
+                      " clicks=%hhu"
+#endif
+                      " x=%d y=%d>",
+                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
+                      ev->button.windowID, ev->button.which,
+                      ev->button.button, INT2BOOLCSTR(ev->button.state),
+#if SDL_VERSION_ATLEAST(2,0,2)
+                      ev->button.clicks,
+#endif
+                      ev->button.x, ev->button.y);
+}
+
+/*
+ * Document-class: SDL2::Event::MouseButtonDown
+ * This class represents mouse button press events.
+ */
+/*
+ * Document-class: SDL2::Event::MouseButtonUp
+ * This class represents mouse button release events.
+ */
+
+/*
+ * Document-class: SDL2::Event::MouseMotion
+ *
+ * This class represents mouse motion events.
+ *
+ * @attribute window_id
+ *   the window id with mouse focus
+ *   @return [Integer]
+ *
+ * @attribute which
+ *   the mouse index 
+ *   @return [Integer]
+ *
+ * @attribute state
+ *   the current mouse state
+ *   @return [Integer]
+ *   @todo use SDL2::Mouse::State
+ *   
+ * @attribute x
+ *   the x coordinate of the mouse pointer, relative to window
+ *   @return [Integer]
+ *
+ * @attribute y
+ *   the y coordinate of the mouse pointer, relative to window
+ *   @return [Integer]
+ *
+ * @attribute xrel
+ *   the relative motion in the x direction
+ *   @return [Integer]
+ *
+ * @attribute yrel
+ *   the relative motion in the y direction
+ *   @return [Integer]
+ */
+EVENT_ACCESSOR_UINT(MouseMotion, window_id, motion.windowID);
+EVENT_ACCESSOR_UINT(MouseMotion, which, motion.which);
+EVENT_ACCESSOR_UINT(MouseMotion, state, motion.state);
+EVENT_ACCESSOR_INT(MouseMotion, x, motion.x);
+EVENT_ACCESSOR_INT(MouseMotion, y, motion.y);
+EVENT_ACCESSOR_INT(MouseMotion, xrel, motion.xrel);
+EVENT_ACCESSOR_INT(MouseMotion, yrel, motion.yrel);
+/* @return [String] inspection string */
+static VALUE EvMouseMotion_inspect(VALUE self)
+{
+    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    return rb_sprintf("<%s: type=%u timestamp=%u"
+                      " window_id=%u which=%u state=%u"
+                      " x=%d y=%d xrel=%d yrel=%d>",
+                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
+                      ev->motion.windowID, ev->motion.which, ev->motion.state,
+                      ev->motion.x, ev->motion.y, ev->motion.xrel, ev->motion.yrel);
+}
+
+/*
+ * Document-class: SDL2::Event::MouseWheel
+ *
+ * This class represents mouse wheel events.
+ *
+ * @attribute window_id
+ *   the window id with mouse focus
+ *   @return [Integer]
+ *
+ * @attribute which
+ *   the mouse index 
+ *   @return [Integer]
+ *
+ * @attribute x
+ *   the amount of scrolled horizontally, positive to the right and negative
+ *   to the left
+ *   @return [Integer]
+ *
+ * @attribute y
+ *   the amount of scrolled vertically, positve away from the user and negative
+ *   toward the user
+ *   @return [Integer]
+ */
+EVENT_ACCESSOR_UINT(MouseWheel, window_id, wheel.windowID);
+EVENT_ACCESSOR_UINT(MouseWheel, which, wheel.which);
+EVENT_ACCESSOR_INT(MouseWheel, x, wheel.x);
+EVENT_ACCESSOR_INT(MouseWheel, y, wheel.y);
+/* @return [String] inspection string */
+static VALUE EvMouseWheel_inspect(VALUE self)
+{
+    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    return rb_sprintf("<%s: type=%u timestamp=%u"
+                      " window_id=%u which=%u x=%d y=%d>",
+                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
+                      ev->wheel.windowID, ev->wheel.which, ev->wheel.x, ev->wheel.y);
+}
+
+/*
+ * Document-class: SDL2::Event::JoyButton
+ *
+ * This class represents joystick button events.
  *
  * You don't handle the instance 
  * of this class directly, but you handle the instances of 
  * two subclasses of this subclasses:
- * {SDL2::Event::KeyDown} and {SDL2::Event::KeyUp}.
+ * {SDL2::Event::JoyButtonDown} and {SDL2::Event::JoyButtonUp}.
  *
- * @attribute [rw] window_id
- *   the associate window id
+ * @attribute which
+ *   the joystick index
+ *   @return [Integer]
+ *
+ * @attribute button
+ *   the joystick button index
  *   @return [Integer]
  *
  * @attribute pressed
- *   key is pressed
- *   @return [boolean]
+ *   button is pressed or not
+ *   @return [Boolean]
+ * 
+ */
+EVENT_ACCESSOR_INT(JoyButton, which, jbutton.which);
+EVENT_ACCESSOR_UINT8(JoyButton, button, jbutton.button);
+EVENT_ACCESSOR_BOOL(JoyButton, pressed, jbutton.state);
+/* @return [String] inspection string */
+static VALUE EvJoyButton_inspect(VALUE self)
+{
+    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    return rb_sprintf("<%s: type=%u timestamp=%u"
+                      " which=%d button=%u pressed=%s>",
+                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
+                      ev->jbutton.which, ev->jbutton.button,
+                      INT2BOOLCSTR(ev->jbutton.state));
+}
+/*
+ * Document-class: SDL2::Event::JoyButtonDown
  *
- * @attribute repeat
- *   key repeat
- *   @return [boolean]
- *   
- * @attribute scancode
- *   physical key code
+ * This class represents the joystick button press events.
+ */
+
+/*
+ * Document-class: SDL2::Event::JoyButtonUp
+ *
+ * This class represents the joystick button release events.
+ */
+
+/*
+ * Document-class: SDL2::Event::JoyAxisMotion
+ *
+ * This class represents the joystick axis motion events.
+ *
+ * @attribute which
+ *   the joystick index
  *   @return [Integer]
- *   @see SDL2::Key::Scan
  *
- * @attribute sym
- *   virtual key code
+ * @attribute axis
+ *   the axis index
  *   @return [Integer]
- *   @see SDL2::Key
  *
- * @attribute mod
- *   current key modifier
+ * @attribute value
+ *   the axis value (range: -32768 to -32767, 0 for newtral)
  *   @return [Integer]
- *   @see SDL2::Key::Mod
- *   
  */
-EVENT_ACCESSOR_UINT(Keyboard, window_id, key.windowID);
-EVENT_ACCESSOR_BOOL(Keyboard, pressed, key.state);
-EVENT_ACCESSOR_BOOL(Keyboard, repeat, key.repeat);
-EVENT_ACCESSOR_UINT(Keyboard, scancode, key.keysym.scancode);
-EVENT_ACCESSOR_UINT(Keyboard, sym, key.keysym.sym);
-EVENT_ACCESSOR_UINT(Keyboard, mod, key.keysym.mod);
+EVENT_ACCESSOR_INT(JoyAxisMotion, which, jaxis.which);
+EVENT_ACCESSOR_UINT8(JoyAxisMotion, axis, jaxis.axis);
+EVENT_ACCESSOR_INT(JoyAxisMotion, value, jaxis.value);
 /* @return [String] inspection string */
-static VALUE EvKeyboard_inspect(VALUE self)
+static VALUE EvJoyAxisMotion_inspect(VALUE self)
 {
     SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
     return rb_sprintf("<%s: type=%u timestamp=%u"
-                      " window_id=%u state=%u repeat=%u"
-                      " scancode=%u sym=%u mod=%u>",
+                      " which=%d axis=%u value=%d>",
                       rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->key.windowID, ev->key.state, ev->key.repeat,
-                      ev->key.keysym.scancode, ev->key.keysym.sym, ev->key.keysym.mod);
+                      ev->jaxis.which, ev->jaxis.axis, ev->jaxis.value);
+}
+
+/*
+ * Document-class: SDL2::Event::JoyBallMotion
+ *
+ * This class represents the joystick trackball motion events.
+ *
+ * @attribute which
+ *   the joystick index
+ *   @return [Integer]
+ *
+ * @attribute ball
+ *   the joystick trackball index
+ *   @return [Integer]
+ *
+ * @attribute xrel
+ *   the relative motion in the x direction
+ *   @return [Integer]
+ *
+ * @attribute yrel
+ *   the relative motion in the y direction
+ *   @return [Integer]
+ */
+EVENT_ACCESSOR_INT(JoyBallMotion, which, jball.which);
+EVENT_ACCESSOR_UINT8(JoyBallMotion, ball, jball.ball);
+EVENT_ACCESSOR_INT(JoyBallMotion, xrel, jball.xrel);
+EVENT_ACCESSOR_INT(JoyBallMotion, yrel, jball.yrel);
+/* @return [String] inspection string */
+static VALUE EvJoyBallMotion_inspect(VALUE self)
+{
+    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    return rb_sprintf("<%s: type=%u timestamp=%u"
+                      " which=%d ball=%u xrel=%d yrel=%d>",
+                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
+                      ev->jball.which, ev->jball.ball, ev->jball.xrel, ev->jball.yrel);
+}
+
+/*
+ * Document-class: SDL2::Event::JoyHatMotion
+ *
+ * This class represents the joystick hat position change events.
+ *
+ * @attribute which
+ *   the joystick index
+ *   @return [Integer]
+ *
+ * @attribute hat
+ *   the joystick hat index
+ *   @return [Integer]
+ *
+ * @attribute value
+ *   the hat position value, same value as {SDL2::Joystick#hat}.
+ *   @return [Integer]
+ */
+EVENT_ACCESSOR_INT(JoyHatMotion, which, jhat.which);
+EVENT_ACCESSOR_UINT8(JoyHatMotion, hat, jhat.hat);
+EVENT_ACCESSOR_UINT8(JoyHatMotion, value, jhat.value);
+/* @return [String] inspection string */
+static VALUE EvJoyHatMotion_inspect(VALUE self)
+{
+    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    return rb_sprintf("<%s: type=%u timestamp=%u which=%d hat=%u value=%u>",
+                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
+                      ev->jhat.which, ev->jhat.hat, ev->jhat.value);
+}
+
+/*
+ * Document-class: SDL2::Event::JoyDevice
+ *
+ * This class represents joystick device events
+ * ({SDL2::Event::JoyDeviceAdded joystick connected events} and
+ *  {SDL2::Event::JoyDeviceRemoved joystick disconnected events}).
+ */
+EVENT_ACCESSOR_INT(JoyDevice, which, jdevice.which);
+/* @return [String] inspection string */
+static VALUE EvJoyDevice_inspect(VALUE self)
+{
+    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    return rb_sprintf("<%s: type=%u timestamp=%u which=%d>",
+                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
+                      ev->jdevice.which);
 }
 
-
 /*
- * Document-class: SDL2::Event::KeyDown
+ * Document-class: SDL2::Event::JoyDeviceAdded
  *
- * This class represents a key down event.
+ * This class represents joystick device connected events.
  */
-
 /*
- * Document-class: SDL2::Event::KeyUp
+ * Document-class: SDL2::Event::JoyDeviceRemoved
  *
- * This class represents a key up event.
+ * This class represents joystick device disconnected events.
  */
 
+
 /*
- * Document-class: SDL2::Event::TextEditing
+ * Document-class: SDL2::Event::ControllerAxisMotion
  *
- * This class represents text editing event.
+ * This class represents the {SDL2::GameController controller} axis motion events.
  *
- * @attribute window_id
- *   the associate window id
+ * @attribute which
+ *   the controller index
  *   @return [Integer]
  *
- * @attribute text
- *   the editing text
- *   @return [String]
- *
- * @attribute start
- *   the start cursor of selected editing text
+ * @attribute axis
+ *   the axis index
  *   @return [Integer]
  *
- * @attribute length
- *   the length of selected editing text
+ * @attribute value
+ *   the axis value (range: -32768 to -32767, 0 for newtral)
  *   @return [Integer]
  */
-EVENT_ACCESSOR_UINT(TextEditing, window_id, edit.windowID);
-EVENT_ACCESSOR_INT(TextEditing, start, edit.start);
-EVENT_ACCESSOR_INT(TextEditing, length, edit.length);
-EVENT_READER(TextEditing, text, edit.text, utf8str_new_cstr);
-static VALUE EvTextEditing_set_text(VALUE self, VALUE str)
-{
-    SDL_Event* ev;
-    TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    set_string(ev->edit.text, str, 30);
-    return str;
-}
-
+EVENT_ACCESSOR_INT(ControllerAxis, which, caxis.which);
+EVENT_ACCESSOR_UINT8(ControllerAxis, axis, caxis.axis);
+EVENT_ACCESSOR_INT(ControllerAxis, value, caxis.value);
 /* @return [String] inspection string */
-static VALUE EvTextEditing_inspect(VALUE self)
+static VALUE ControllerAxis_inspect(VALUE self)
 {
     SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
     return rb_sprintf("<%s: type=%u timestamp=%u"
-                      " window_id=%u text=%s start=%d length=%d>",
+                      " which=%d axis=%s value=%d>",
                       rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->edit.windowID, ev->edit.text, ev->edit.start, ev->edit.length);
+                      ev->caxis.which, SDL_GameControllerGetStringForAxis(ev->caxis.axis),
+                      ev->caxis.value);
 }
 
-
 /*
- * Document-class: SDL2::Event::TextInput
- *
- * This class represents text input events.
- *
- * @attribute window_id
- *   the associate window id
- *   @return [Integer]
+ * Document-class: SDL2::Event::ControllerButton
  *
- * @attribute text
- *   the input text
- *   @return [String]
- */
-EVENT_ACCESSOR_UINT(TextInput, window_id, text.windowID);
-EVENT_READER(TextInput, text, text.text, utf8str_new_cstr);
-static VALUE EvTextInput_set_text(VALUE self, VALUE str)
-{
-    SDL_Event* ev;
-    TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    set_string(ev->text.text, str, 30);
-    return str;
-}
-
-/* @return [String] inspection string */
-static VALUE EvTextInput_inspect(VALUE self)
-{
-    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    return rb_sprintf("<%s: type=%u timestamp=%u window_id=%u text=%s>",
-                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->text.windowID, ev->text.text);
-}
-
-/*
- * Document-class: SDL2::Event::MouseButton
+ * This class represents the {SDL2::GameController controller} button events.
  *
- * This class represents mouse button events.
- * 
  * You don't handle the instance 
  * of this class directly, but you handle the instances of 
  * two subclasses of this subclasses:
- * {SDL2::Event::MouseButtonDown} and {SDL2::Event::MouseButtonUp}.
- *
- * @attribute window_id
- *   the window id with mouse focus
- *   @return [Integer]
+ * {SDL2::Event::ControllerButtonDown} and {SDL2::Event::ControllerButtonUp}.
  *
  * @attribute which
- *   the mouse index
+ *   the controller index
  *   @return [Integer]
  *
  * @attribute button
- *   the mouse button index
+ *   the controller button index
  *   @return [Integer]
  *
  * @attribute pressed
  *   button is pressed or not
  *   @return [Boolean]
  *
- * @attribute clicks
- *   1 for single click, 2 for double click
- *   
- *   This attribute is available after SDL 2.0.2
- *   @return [Integer]
+ */
+EVENT_ACCESSOR_INT(ControllerButton, which, cbutton.which);
+EVENT_ACCESSOR_UINT8(ControllerButton, button, cbutton.button);
+EVENT_ACCESSOR_BOOL(ControllerButton, pressed, cbutton.state);
+/* @return [String] inspection string */
+static VALUE ControllerButton_inspect(VALUE self)
+{
+    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    return rb_sprintf("<%s: type=%u timestamp=%u"
+                      " which=%d button=%s state=%s>",
+                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
+                      ev->cbutton.which,
+                      SDL_GameControllerGetStringForButton(ev->cbutton.button),
+                      INT2BOOLCSTR(ev->cbutton.state));
+}
+/*
+ * Document-class: SDL2::Event::ControllerButtonDown
  *
- * @attribute x
- *   the x coordinate of the mouse pointer, relative to window
- *   @return [Integer]
+ * This class represents the {SDL2::GameController controller} button press events.
+ */
+
+/*
+ * Document-class: SDL2::Event::ControllerButtonUp
  *
- * @attribute y
- *   the y coordinate of the mouse pointer, relative to window
+ * This class represents the {SDL2::GameController controller} button release events.
+ */
+
+/*
+ * Document-class: SDL2::Event::ControllerDevice
+ *
+ * This class represents {SDL2::GameController controller} device events (connected/disconnected/remapped).
+ *
+ * The event of this event doesn't occur. Only the event of the following subclasses
+ * occur in Ruby/SDL2.
+ *
+ *   * {SDL2::Event::ControllerDeviceAdded}
+ *   * {SDL2::Event::ControllerDeviceRemoved}
+ *   * {SDL2::Event::ControllerDeviceRemapped}
+ *
+ * @attribute which
+ *   the controller index
  *   @return [Integer]
  */
-EVENT_ACCESSOR_UINT(MouseButton, window_id, button.windowID);
-EVENT_ACCESSOR_UINT(MouseButton, which, button.which);
-EVENT_ACCESSOR_UINT8(MouseButton, button, button.button);
-EVENT_ACCESSOR_BOOL(MouseButton, pressed, button.state);
-#if SDL_VERSION_ATLEAST(2,0,2)
-EVENT_ACCESSOR_UINT8(MouseButton, clicks, button.clicks);
-#endif
-EVENT_ACCESSOR_INT(MouseButton, x, button.x);
-EVENT_ACCESSOR_INT(MouseButton, y, button.y);
+EVENT_ACCESSOR_INT(ControllerDevice, which, cdevice.which);
 /* @return [String] inspection string */
-static VALUE EvMouseButton_inspect(VALUE self)
+static VALUE ControllerDevice_inspect(VALUE self)
 {
     SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    return rb_sprintf("<%s: type=%u timestamp=%u"
-                      " window_id=%u which=%u button=%hhu pressed=%s"
-#if SDL_VERSION_ATLEAST(2,0,2)
-                      " clicks=%hhu"
-#endif
-                      " x=%d y=%d>",
+    return rb_sprintf("<%s: type=%u timestamp=%u which=%d>",
                       rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->button.windowID, ev->button.which,
-                      ev->button.button, INT2BOOLCSTR(ev->button.state),
-#if SDL_VERSION_ATLEAST(2,0,2)
-                      ev->button.clicks,
-#endif
-                      ev->button.x, ev->button.y);
+                      ev->cdevice.which);
 }
 
 /*
- * Document-class: SDL2::Event::MouseButtonDown
- * This class represents mouse button press events.
+ * Document-class: SDL2::Event::ControllerDeviceAdded
+ *
+ * This class represents {SDL2::GameController controller} device connected events.
  */
 /*
- * Document-class: SDL2::Event::MouseButtonUp
- * This class represents mouse button release events.
+ * Document-class: SDL2::Event::ControllerDeviceRemoved
+ *
+ * This class represents {SDL2::GameController controller} device disconnected events.
+ */
+/*
+ * Document-class: SDL2::Event::ControllerDeviceRemapped
+ *
+ * This class represents {SDL2::GameController controller} device remapped events.
  */
 
 /*
- * Document-class: SDL2::Event::MouseMotion
+ * Document-class: SDL2::Event::TouchFinger
  *
- * This class represents mouse motion events.
+ * This class represents touch finger events.
+ * 
+ * You don't handle the instance 
+ * of this class directly, but you handle the instances of 
+ * two subclasses of this subclasses:
+ * {SDL2::Event::FingerMotion}, {SDL2::Event::FingerDown}, and {SDL2::Event::FingerUp}.
  *
- * @attribute window_id
- *   the window id with mouse focus
+ * @attribute touch_id
+ *   the touch device id
  *   @return [Integer]
  *
- * @attribute which
- *   the mouse index 
+ * @attribute finger_id
+ *   the finger id
  *   @return [Integer]
  *
- * @attribute state
- *   the current mouse state
- *   @return [Integer]
- *   @todo use SDL2::Mouse::State
- *   
  * @attribute x
- *   the x coordinate of the mouse pointer, relative to window
- *   @return [Integer]
+ *   the x-axis location of the touch event, normalized (0...1)
+ *   @return [Float]
  *
  * @attribute y
- *   the y coordinate of the mouse pointer, relative to window
- *   @return [Integer]
- *
- * @attribute xrel
- *   the relative motion in the x direction
- *   @return [Integer]
+ *   the y-axis location of the touch event, normalized (0...1)
+ *   @return [Float]
  *
- * @attribute yrel
- *   the relative motion in the y direction
- *   @return [Integer]
+ * @attribute pressure
+ *   the quantity of pressure applied, normalized (0...1)
+ *   @return [Float]
  */
-EVENT_ACCESSOR_UINT(MouseMotion, window_id, motion.windowID);
-EVENT_ACCESSOR_UINT(MouseMotion, which, motion.which);
-EVENT_ACCESSOR_UINT(MouseMotion, state, motion.state);
-EVENT_ACCESSOR_INT(MouseMotion, x, motion.x);
-EVENT_ACCESSOR_INT(MouseMotion, y, motion.y);
-EVENT_ACCESSOR_INT(MouseMotion, xrel, motion.xrel);
-EVENT_ACCESSOR_INT(MouseMotion, yrel, motion.yrel);
+EVENT_ACCESSOR_INT(TouchFinger, touch_id, tfinger.touchId);
+EVENT_ACCESSOR_INT(TouchFinger, finger_id, tfinger.fingerId);
+EVENT_ACCESSOR_DBL(TouchFinger, x, tfinger.x);
+EVENT_ACCESSOR_DBL(TouchFinger, y, tfinger.y);
+EVENT_ACCESSOR_DBL(TouchFinger, pressure, tfinger.pressure);
 /* @return [String] inspection string */
-static VALUE EvMouseMotion_inspect(VALUE self)
+static VALUE EvTouchFinger_inspect(VALUE self)
 {
     SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
     return rb_sprintf("<%s: type=%u timestamp=%u"
-                      " window_id=%u which=%u state=%u"
-                      " x=%d y=%d xrel=%d yrel=%d>",
+                      " touch_id=%d finger_id=%d"
+                      " x=%f y=%f pressure=%f>",
                       rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->motion.windowID, ev->motion.which, ev->motion.state,
-                      ev->motion.x, ev->motion.y, ev->motion.xrel, ev->motion.yrel);
+                      (int)ev->tfinger.touchId, (int)ev->tfinger.fingerId,
+                      ev->tfinger.x, ev->tfinger.y, ev->tfinger.pressure);
 }
 
 /*
- * Document-class: SDL2::Event::MouseWheel
- *
- * This class represents mouse wheel events.
+ * Document-class: SDL2::Event::FingerUp
+ * This class represents finger touch events.
+ */
+/*
+ * Document-class: SDL2::Event::FingerDown
+ * This class represents finger release events.
+ */
+
+/*
+ * Document-class: SDL2::Event::FingerMotion
  *
- * @attribute window_id
- *   the window id with mouse focus
- *   @return [Integer]
+ * This class represents touch move events.
  *
- * @attribute which
- *   the mouse index 
- *   @return [Integer]
+ * @attribute dx
+ *   the distance moved in the x-axis, normalized (0...1)
+ *   @return [Float]
  *
- * @attribute x
- *   the amount of scrolled horizontally, positive to the right and negative
- *   to the left
- *   @return [Integer]
+ * @attribute dy
+ *   the distance moved in the y-axis, normalized (0...1)
+ *   @return [Float]
  *
- * @attribute y
- *   the amount of scrolled vertically, positve away from the user and negative
- *   toward the user
- *   @return [Integer]
  */
-EVENT_ACCESSOR_UINT(MouseWheel, window_id, wheel.windowID);
-EVENT_ACCESSOR_UINT(MouseWheel, which, wheel.which);
-EVENT_ACCESSOR_INT(MouseWheel, x, wheel.x);
-EVENT_ACCESSOR_INT(MouseWheel, y, wheel.y);
+EVENT_ACCESSOR_DBL(FingerMotion, dx, tfinger.dx);
+EVENT_ACCESSOR_DBL(FingerMotion, dy, tfinger.dy);
 /* @return [String] inspection string */
-static VALUE EvMouseWheel_inspect(VALUE self)
+static VALUE EvFingerMotion_inspect(VALUE self)
 {
     SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
     return rb_sprintf("<%s: type=%u timestamp=%u"
-                      " window_id=%u which=%u x=%d y=%d>",
+                      " touch_id=%d finger_id=%d"
+                      " x=%f y=%f pressure=%f"
+                      " dy=%f dx=%f>",
                       rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->wheel.windowID, ev->wheel.which, ev->wheel.x, ev->wheel.y);
+                      (int) ev->tfinger.touchId, (int) ev->tfinger.fingerId,
+                      ev->tfinger.x, ev->tfinger.y, ev->tfinger.pressure,
+                      ev->tfinger.dx, ev->tfinger.dx);
 }
 
 /*
- * Document-class: SDL2::Event::JoyButton
- *
- * This class represents joystick button events.
- *
- * You don't handle the instance 
- * of this class directly, but you handle the instances of 
- * two subclasses of this subclasses:
- * {SDL2::Event::JoyButtonDown} and {SDL2::Event::JoyButtonUp}.
+ * Document-class: SDL2::Event::User
+ *
+ * This class represents user-defined events.
+ *
+ * Types for user-defined events are allocated by {SDL2::Event.register_types},
+ * and events are pushed by {SDL2::Event::User.push} or {SDL2::Event.push}
+ * from any thread.
+ *
+ * @example wake the main loop up when an asset is loaded
+ *   ASSET_LOADED = SDL2::Event.register_types
+ *   Thread.new do
+ *     SDL2::Event::User.push(ASSET_LOADED, 0, File.binread("level1.dat"))
+ *   end
+ *   loop do
+ *     ev = SDL2::Event.wait
+ *     if ev.type == ASSET_LOADED
+ *       load_level(ev.data)
+ *       p ev.latency
+ *     end
+ *   end
  *
- * @attribute which
- *   the joystick index
+ * @attribute [rw] window_id
+ *   the associated window id
  *   @return [Integer]
  *
- * @attribute button
- *   the joystick button index
+ * @attribute [rw] code
+ *   user defined event code
  *   @return [Integer]
+ */
+EVENT_ACCESSOR_UINT(User, window_id, user.windowID);
+EVENT_ACCESSOR_INT(User, code, user.code);
+
+/*
+ * @overload type=(type)
+ *   Set the event type.
  *
- * @attribute pressed
- *   button is pressed or not
- *   @return [Boolean]
- * 
+ *   @param [Integer] type a type allocated by {SDL2::Event.register_types}
  */
-EVENT_ACCESSOR_INT(JoyButton, which, jbutton.which);
-EVENT_ACCESSOR_UINT8(JoyButton, button, jbutton.button);
-EVENT_ACCESSOR_BOOL(JoyButton, pressed, jbutton.state);
-/* @return [String] inspection string */
-static VALUE EvJoyButton_inspect(VALUE self)
+static VALUE EvUser_set_type(VALUE self, VALUE type)
 {
-    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    return rb_sprintf("<%s: type=%u timestamp=%u"
-                      " which=%d button=%u pressed=%s>",
-                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->jbutton.which, ev->jbutton.button,
-                      INT2BOOLCSTR(ev->jbutton.state));
+    SDL_Event* ev;
+    Uint32 t = NUM2UINT(type);
+    TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
+    if (t < SDL_USEREVENT || t >= SDL_LASTEVENT)
+        rb_raise(rb_eArgError, "not a user-defined event type (%u)", t);
+    ev->type = t;
+    return type;
 }
+
 /*
- * Document-class: SDL2::Event::JoyButtonDown
+ * The payload of the event.
  *
- * This class represents the joystick button press events.
+ * The payload is passed from {SDL2::Event.push} to the fetched event object
+ * without crossing native threads.
+ *
+ * @return [Object]
  */
+static VALUE EvUser_data(VALUE self)
+{
+    return rb_iv_get(self, "data");
+}
 
 /*
- * Document-class: SDL2::Event::JoyButtonUp
+ * @overload data=(data)
+ *   Set the payload of the event.
  *
- * This class represents the joystick button release events.
+ *   @param [Object] data any Ruby object
  */
+static VALUE EvUser_set_data(VALUE self, VALUE data)
+{
+    rb_iv_set(self, "data", data);
+    return data;
+}
 
 /*
- * Document-class: SDL2::Event::JoyAxisMotion
- *
- * This class represents the joystick axis motion events.
- *
- * @attribute which
- *   the joystick index
- *   @return [Integer]
+ * Get the time from pushing the event by {SDL2::Event.push} to
+ * fetching it (for example, by {SDL2::Event.poll} or {SDL2::Event.wait}).
  *
- * @attribute axis
- *   the axis index
- *   @return [Integer]
+ * This is the wakeup latency of the receiving thread.
  *
- * @attribute value
- *   the axis value (range: -32768 to -32767, 0 for newtral)
- *   @return [Integer]
+ * @return [Float] the latency in seconds
+ * @return [nil] the event is not pushed by {SDL2::Event.push}
  */
-EVENT_ACCESSOR_INT(JoyAxisMotion, which, jaxis.which);
-EVENT_ACCESSOR_UINT8(JoyAxisMotion, axis, jaxis.axis);
-EVENT_ACCESSOR_INT(JoyAxisMotion, value, jaxis.value);
-/* @return [String] inspection string */
-static VALUE EvJoyAxisMotion_inspect(VALUE self)
+static VALUE EvUser_latency(VALUE self)
 {
-    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    return rb_sprintf("<%s: type=%u timestamp=%u"
-                      " which=%d axis=%u value=%d>",
-                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->jaxis.which, ev->jaxis.axis, ev->jaxis.value);
+    return rb_iv_get(self, "latency");
 }
 
 /*
- * Document-class: SDL2::Event::JoyBallMotion
- *
- * This class represents the joystick trackball motion events.
+ * @overload push(type, code=0, data=nil)
+ *   Push a user-defined event to the event queue.
+ *
+ *   This is the same as creating an {SDL2::Event::User} object and
+ *   pushing it with {SDL2::Event.push}, but no event object is created.
+ *   This method can be called from any Ruby thread.
+ *
+ *   @param [Integer] type a type allocated by {SDL2::Event.register_types}
+ *   @param [Integer] code user defined event code
+ *   @param [Object] data the payload
+ *   @return [Boolean] false if the event is dropped by the event filter
+ *   @raise [SDL2::Error] raised when the event queue is full
+ */
+static VALUE EvUser_s_push(int argc, VALUE* argv, VALUE self)
+{
+    VALUE type, code, data;
+    SDL_Event ev;
+
+    rb_scan_args(argc, argv, "12", &type, &code, &data);
+    memset(&ev, 0, sizeof(ev));
+    ev.type = NUM2UINT(type);
+    if (!is_user_event(&ev))
+        rb_raise(rb_eArgError, "not a user-defined event type (%u)", ev.type);
+    ev.user.timestamp = SDL_GetTicks();
+    ev.user.code = (code == Qnil) ? 0 : NUM2INT(code);
+    return push_event(&ev, data);
+}
+
+/*
+ * Get the number of user events pushed by {SDL2::Event.push} and not fetched yet,
+ * whose entries (payloads and tags) are kept in the registry.
  *
- * @attribute which
- *   the joystick index
- *   @return [Integer]
+ * Entries of user events removed from the queue without being fetched
+ * (e.g. disabled by {SDL2::Event.enable=}) remain until {.clear_payloads}.
  *
- * @attribute ball
- *   the joystick trackball index
- *   @return [Integer]
+ * @return [Integer]
+ */
+static VALUE EvUser_s_pending_payloads(VALUE self)
+{
+    return LONG2NUM(RHASH_SIZE(user_payloads));
+}
+
+/*
+ * Discard all entries kept for pushed events.
  *
- * @attribute xrel
- *   the relative motion in the x direction
- *   @return [Integer]
+ * Pushed events still in the queue are then fetched as events without
+ * payloads and latencies.
  *
- * @attribute yrel
- *   the relative motion in the y direction
- *   @return [Integer]
+ * @return [nil]
  */
-EVENT_ACCESSOR_INT(JoyBallMotion, which, jball.which);
-EVENT_ACCESSOR_UINT8(JoyBallMotion, ball, jball.ball);
-EVENT_ACCESSOR_INT(JoyBallMotion, xrel, jball.xrel);
-EVENT_ACCESSOR_INT(JoyBallMotion, yrel, jball.yrel);
+static VALUE EvUser_s_clear_payloads(VALUE self)
+{
+    rb_hash_clear(user_payloads);
+    return Qnil;
+}
+
 /* @return [String] inspection string */
-static VALUE EvJoyBallMotion_inspect(VALUE self)
+static VALUE EvUser_inspect(VALUE self)
 {
     SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    return rb_sprintf("<%s: type=%u timestamp=%u"
-                      " which=%d ball=%u xrel=%d yrel=%d>",
+    return rb_sprintf("<%s: type=%u timestamp=%u window_id=%u code=%d>",
                       rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->jball.which, ev->jball.ball, ev->jball.xrel, ev->jball.yrel);
+                      ev->user.windowID, ev->user.code);
 }
 
 /*
- * Document-class: SDL2::Event::JoyHatMotion
+ * Handlers of SDL2::EventDispatcher are kept in a Ruby Array (the hidden ivar "handlers"),
+ * and the native table maps event types to indices of the Array.
+ * The table is split into pages of 256 types allocated on demand.
+ * Slots of handlers no longer referenced by the table are cleared and reused,
+ * so the Array never grows beyond the number of registered handlers.
+ */
+#define DISPATCH_PAGE_BITS 8
+#define DISPATCH_PAGE_SIZE (1 << DISPATCH_PAGE_BITS)
+#define DISPATCH_NUM_PAGES ((SDL_LASTEVENT + DISPATCH_PAGE_SIZE - 1) / DISPATCH_PAGE_SIZE)
+
+typedef struct DispatchEntry {
+    int handler; /* index of the handler + 1, or 0 if no handler */
+    int raw;
+} DispatchEntry;
+
+typedef struct EventDispatcher {
+    DispatchEntry* pages[DISPATCH_NUM_PAGES];
+} EventDispatcher;
+
+static void EventDispatcher_free(EventDispatcher* d)
+{
+    int i;
+    for (i=0; i<DISPATCH_NUM_PAGES; ++i)
+        free(d->pages[i]);
+    free(d);
+}
+
+DEFINE_DATA_TYPE(EventDispatcher, EventDispatcher_free);
+DEFINE_GETTER(static, EventDispatcher, cEventDispatcher, "SDL2::EventDispatcher");
+
+static VALUE EventDispatcher_s_allocate(VALUE klass)
+{
+    EventDispatcher* d;
+    VALUE obj = TypedData_Make_Struct(klass, EventDispatcher, &EventDispatcher_data_type, d);
+    memset(d->pages, 0, sizeof(d->pages));
+    return obj;
+}
+
+static DispatchEntry* dispatch_entry(EventDispatcher* d, Uint32 type, int create)
+{
+    DispatchEntry* page = d->pages[type >> DISPATCH_PAGE_BITS];
+    if (!page) {
+        if (!create)
+            return NULL;
+        page = calloc(DISPATCH_PAGE_SIZE, sizeof(DispatchEntry));
+        if (!page)
+            rb_raise(rb_eNoMemError, "Cannot allocate event dispatcher");
+        d->pages[type >> DISPATCH_PAGE_BITS] = page;
+    }
+    return &page[type & (DISPATCH_PAGE_SIZE - 1)];
+}
+
+/*
+ * Clear the slots of the handlers which are referenced by no event type,
+ * so that replaced or unregistered handlers can be garbage collected.
+ */
+static void sweep_handlers(VALUE handlers, EventDispatcher* d)
+{
+    long len = RARRAY_LEN(handlers);
+    VALUE vbuf;
+    char* used = ALLOCV_N(char, vbuf, len);
+    long i;
+    int j;
+
+    memset(used, 0, len);
+    for (i=0; i<DISPATCH_NUM_PAGES; ++i) {
+        if (!d->pages[i])
+            continue;
+        for (j=0; j<DISPATCH_PAGE_SIZE; ++j) {
+            int handler = d->pages[i][j].handler;
+            if (handler > 0 && handler <= len)
+                used[handler - 1] = 1;
+        }
+    }
+    for (i=0; i<len; ++i)
+        if (!used[i])
+            rb_ary_store(handlers, i, Qnil);
+    ALLOCV_END(vbuf);
+}
+
+/* Store the handler in a free slot of handlers and return its index + 1 */
+static int store_handler(VALUE handlers, VALUE handler)
+{
+    long i;
+
+    for (i=0; i<RARRAY_LEN(handlers); ++i) {
+        if (RARRAY_AREF(handlers, i) == Qnil) {
+            rb_ary_store(handlers, i, handler);
+            return (int)(i + 1);
+        }
+    }
+    rb_ary_push(handlers, handler);
+    return (int)RARRAY_LEN(handlers);
+}
+
+/*
+ * Set the raw arguments of the event passed to handlers registered with raw=true.
+ * Return the number of arguments.
+ */
+static int raw_event_args(SDL_Event* ev, VALUE* args)
+{
+    switch (ev->type) {
+    case SDL_QUIT:
+        return 0;
+    case SDL_WINDOWEVENT:
+        args[0] = UINT2NUM(ev->window.windowID); args[1] = INT2NUM(ev->window.event);
+        args[2] = INT2NUM(ev->window.data1); args[3] = INT2NUM(ev->window.data2);
+        return 4;
+    case SDL_KEYDOWN: case SDL_KEYUP:
+        args[0] = INT2NUM(ev->key.keysym.scancode); args[1] = INT2NUM(ev->key.keysym.sym);
+        args[2] = INT2NUM(ev->key.keysym.mod); args[3] = INT2BOOL(ev->key.repeat);
+        return 4;
+    case SDL_TEXTINPUT:
+        args[0] = utf8str_new_cstr(ev->text.text);
+        return 1;
+    case SDL_MOUSEMOTION:
+        args[0] = INT2NUM(ev->motion.x); args[1] = INT2NUM(ev->motion.y);
+        args[2] = INT2NUM(ev->motion.xrel); args[3] = INT2NUM(ev->motion.yrel);
+        args[4] = UINT2NUM(ev->motion.state);
+        return 5;
+    case SDL_MOUSEBUTTONDOWN: case SDL_MOUSEBUTTONUP:
+        args[0] = INT2NUM(ev->button.x); args[1] = INT2NUM(ev->button.y);
+        args[2] = INT2NUM(ev->button.button);
+#if SDL_VERSION_ATLEAST(2,0,2)
+        args[3] = INT2NUM(ev->button.clicks);
+#else
+        args[3] = INT2FIX(1);
+#endif
+        return 4;
+    case SDL_MOUSEWHEEL:
+        args[0] = INT2NUM(ev->wheel.x); args[1] = INT2NUM(ev->wheel.y);
+        return 2;
+    case SDL_JOYAXISMOTION:
+        args[0] = INT2NUM(ev->jaxis.which); args[1] = INT2NUM(ev->jaxis.axis);
+        args[2] = INT2NUM(ev->jaxis.value);
+        return 3;
+    case SDL_JOYBALLMOTION:
+        args[0] = INT2NUM(ev->jball.which); args[1] = INT2NUM(ev->jball.ball);
+        args[2] = INT2NUM(ev->jball.xrel); args[3] = INT2NUM(ev->jball.yrel);
+        return 4;
+    case SDL_JOYHATMOTION:
+        args[0] = INT2NUM(ev->jhat.which); args[1] = INT2NUM(ev->jhat.hat);
+        args[2] = INT2NUM(ev->jhat.value);
+        return 3;
+    case SDL_JOYBUTTONDOWN: case SDL_JOYBUTTONUP:
+        args[0] = INT2NUM(ev->jbutton.which); args[1] = INT2NUM(ev->jbutton.button);
+        return 2;
+    case SDL_JOYDEVICEADDED: case SDL_JOYDEVICEREMOVED:
+        args[0] = INT2NUM(ev->jdevice.which);
+        return 1;
+    case SDL_CONTROLLERAXISMOTION:
+        args[0] = INT2NUM(ev->caxis.which); args[1] = INT2NUM(ev->caxis.axis);
+        args[2] = INT2NUM(ev->caxis.value);
+        return 3;
+    case SDL_CONTROLLERBUTTONDOWN: case SDL_CONTROLLERBUTTONUP:
+        args[0] = INT2NUM(ev->cbutton.which); args[1] = INT2NUM(ev->cbutton.button);
+        return 2;
+    case SDL_CONTROLLERDEVICEADDED: case SDL_CONTROLLERDEVICEREMOVED:
+    case SDL_CONTROLLERDEVICEREMAPPED:
+        args[0] = INT2NUM(ev->cdevice.which);
+        return 1;
+    case SDL_FINGERDOWN: case SDL_FINGERUP: case SDL_FINGERMOTION:
+        args[0] = LL2NUM(ev->tfinger.fingerId);
+        args[1] = DBL2NUM(ev->tfinger.x); args[2] = DBL2NUM(ev->tfinger.y);
+        args[3] = DBL2NUM(ev->tfinger.dx); args[4] = DBL2NUM(ev->tfinger.dy);
+        return 5;
+    default:
+        if (is_user_event(ev)) {
+            args[0] = INT2NUM(ev->user.code);
+            args[1] = take_pushed_payload(ev, NULL);
+            if (args[1] == Qundef)
+                args[1] = Qnil;
+            return 2;
+        }
+        args[0] = UINT2NUM(ev->type); args[1] = UINT2NUM(ev->common.timestamp);
+        return 2;
+    }
+}
+
+/*
+ * Document-class: SDL2::EventDispatcher
+ *
+ * This class dispatches events to handlers registered for each event type.
+ *
+ * {#dispatch} fetches pending events and looks up the handler of each event
+ * in a native table, so the cost of dispatching does not depend on the
+ * number of handlers. Events without a handler are discarded without
+ * creating any Ruby object.
+ *
+ * Handlers receive an {SDL2::Event} object by default, or the fields of
+ * the event as arguments if registered with raw=true (see {#on}); raw
+ * handlers avoid creating event objects.
+ *
+ * @example
+ *   dispatcher = SDL2::EventDispatcher.new
+ *   dispatcher.on(SDL2::Event::Quit) { exit }
+ *   dispatcher.on(SDL2::Event::KeyDown) {|ev| keys << ev.sym }
+ *   dispatcher.on(SDL2::Event::MouseMotion, true) {|x, y, xrel, yrel, state| cursor.move(x, y) }
+ *   loop do
+ *     dispatcher.dispatch
+ *     game.update
+ *   end
+ */
+
+/*
+ * @overload on(type, raw=false){|*args| ... }
+ * @overload on(type, raw=false, handler)
+ *   Register the handler of events of the given type.
+ *
+ *   If **type** is a class which has subclasses (such as {SDL2::Event::Keyboard}),
+ *   the handler is registered for all event types of the subclasses.
+ *   An existing handler of the same type is replaced.
+ *
+ *   If **raw** is true, the handler receives the following arguments
+ *   instead of an event object:
+ *
+ *   * Quit: none
+ *   * Window: window_id, event, data1, data2
+ *   * KeyDown/KeyUp: scancode, sym, mod, repeat
+ *   * TextInput: text
+ *   * MouseMotion: x, y, xrel, yrel, state
+ *   * MouseButtonDown/MouseButtonUp: x, y, button, clicks
+ *   * MouseWheel: x, y
+ *   * JoyAxisMotion/ControllerAxisMotion: which, axis, value
+ *   * JoyBallMotion: which, ball, xrel, yrel
+ *   * JoyHatMotion: which, hat, value
+ *   * JoyButton*, ControllerButton*: which, button
+ *   * JoyDevice*, ControllerDevice*: which
+ *   * Finger*: finger_id, x, y, dx, dy
+ *   * User: code, data
+ *   * others: type, timestamp
+ *
+ *   @param [Integer,Class] type the event type, or a subclass of SDL2::Event;
+ *     use the Integer returned by {SDL2::Event.register_types} for user-defined events
+ *   @param [Boolean] raw true to pass the fields of the event as arguments
+ *   @param [#call] handler the handler; the block is used if not given
+ *   @return [self]
+ */
+static VALUE EventDispatcher_on(int argc, VALUE* argv, VALUE self)
+{
+    EventDispatcher* d = Get_EventDispatcher(self);
+    VALUE type, raw, handler, block, handlers;
+    int index, found = 0;
+    Uint32 i;
+
+    rb_scan_args(argc, argv, "12&", &type, &raw, &handler, &block);
+    if (handler == Qnil)
+        handler = block;
+    if (handler == Qnil)
+        rb_raise(rb_eArgError, "no handler given");
+
+    handlers = rb_iv_get(self, "handlers");
+    if (handlers == Qnil) {
+        handlers = rb_ary_new();
+        rb_iv_set(self, "handlers", handlers);
+    }
+    index = store_handler(handlers, handler);
+
+    if (RB_TYPE_P(type, T_CLASS) && rb_iv_get(type, "event_type") == Qnil) {
+        for (i=0; i<SDL_LASTEVENT; ++i) {
+            if (event_type_to_class[i] != cEvent &&
+                RTEST(rb_class_inherited_p(event_type_to_class[i], type))) {
+                DispatchEntry* entry = dispatch_entry(d, i, 1);
+                entry->handler = index;
+                entry->raw = RTEST(raw);
+                found = 1;
+            }
+        }
+        if (!found)
+            rb_raise(rb_eArgError, "%s has no event type", rb_class2name(type));
+    } else {
+        Uint32 t = event_type_arg(type, 0);
+        DispatchEntry* entry;
+        if (t >= SDL_LASTEVENT)
+            rb_raise(rb_eArgError, "event type out of range (%u)", t);
+        entry = dispatch_entry(d, t, 1);
+        entry->handler = index;
+        entry->raw = RTEST(raw);
+    }
+    sweep_handlers(handlers, d);
+    return self;
+}
+
+/*
+ * @overload off(type)
+ *   Unregister the handler of events of the given type.
  *
- * This class represents the joystick hat position change events.
+ *   @param [Integer,Class] type the event type, or a subclass of SDL2::Event
+ *   @return [self]
+ */
+static VALUE EventDispatcher_off(VALUE self, VALUE type)
+{
+    EventDispatcher* d = Get_EventDispatcher(self);
+    Uint32 i;
+
+    if (RB_TYPE_P(type, T_CLASS) && rb_iv_get(type, "event_type") == Qnil) {
+        for (i=0; i<SDL_LASTEVENT; ++i) {
+            DispatchEntry* entry = dispatch_entry(d, i, 0);
+            if (entry && RTEST(rb_class_inherited_p(event_type_to_class[i], type)))
+                entry->handler = 0;
+        }
+    } else {
+        DispatchEntry* entry = dispatch_entry(d, event_type_arg(type, 0), 0);
+        if (entry)
+            entry->handler = 0;
+    }
+    if (rb_iv_get(self, "handlers") != Qnil)
+        sweep_handlers(rb_iv_get(self, "handlers"), d);
+    return self;
+}
+
+/*
+ * @overload handles?(type)
+ *   Return true if a handler is registered for the event type.
  *
- * @attribute which
- *   the joystick index
- *   @return [Integer]
+ *   @param [Integer,Class] type the event type, or a subclass of SDL2::Event
+ *     with an event type
+ */
+static VALUE EventDispatcher_handles_p(VALUE self, VALUE type)
+{
+    DispatchEntry* entry = dispatch_entry(Get_EventDispatcher(self), event_type_arg(type, 0), 0);
+    return INT2BOOL(entry && entry->handler);
+}
+
+/* Call the handler of the event; return 0 if there is no handler */
+static int dispatch_event(VALUE self, EventDispatcher* d, SDL_Event* ev)
+{
+    DispatchEntry* entry = dispatch_entry(d, ev->type, 0);
+    VALUE handler;
+
+    if (!entry || !entry->handler) {
+        /* discard the payload of user events without handlers */
+        if (is_user_event(ev))
+            take_pushed_payload(ev, NULL);
+        return 0;
+    }
+    handler = rb_ary_entry(rb_iv_get(self, "handlers"), entry->handler - 1);
+    if (entry->raw) {
+        VALUE args[5];
+        int n = raw_event_args(ev, args);
+        rb_funcallv(handler, id_call, n, args);
+    } else {
+        VALUE event = Event_new(ev);
+        rb_funcallv(handler, id_call, 1, &event);
+    }
+    return 1;
+}
+
+/*
+ * Fetch all pending events and call the handlers.
  *
- * @attribute hat
- *   the joystick hat index
- *   @return [Integer]
+ * Events are fetched one by one, so if a handler raises an exception, the following
+ * events are left in the queue. Only the events pending at the call are dispatched;
+ * events pushed by handlers are left for the next call.
  *
- * @attribute value
- *   the hat position value, same value as {SDL2::Joystick#hat}.
- *   @return [Integer]
+ * @return [Integer] the number of events passed to handlers
  */
-EVENT_ACCESSOR_INT(JoyHatMotion, which, jhat.which);
-EVENT_ACCESSOR_UINT8(JoyHatMotion, hat, jhat.hat);
-EVENT_ACCESSOR_UINT8(JoyHatMotion, value, jhat.value);
-/* @return [String] inspection string */
-static VALUE EvJoyHatMotion_inspect(VALUE self)
+static VALUE EventDispatcher_dispatch(VALUE self)
+{
+    EventDispatcher* d = Get_EventDispatcher(self);
+    SDL_Event ev;
+    long count = 0;
+    int n, pending;
+
+    SDL_PumpEvents();
+    pending = HANDLE_ERROR(SDL_PeepEvents(NULL, 0, SDL_PEEKEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT));
+    while (pending-- > 0) {
+        PROFILE_BEGIN(start);
+        n = HANDLE_ERROR(SDL_PeepEvents(&ev, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT));
+        PROFILE_END(PROFILE_EVENT_POLL, start);
+        if (n == 0)
+            break;
+        coalesce_following(&ev);
+        LATENCY_INPUT(&ev);
+        count += dispatch_event(self, d, &ev);
+    }
+    return LONG2NUM(count);
+}
+
+/*
+ * @overload dispatch_event(event)
+ *   Call the handler of the given event.
+ *
+ *   @param [SDL2::Event] event the event to dispatch
+ *   @return [Boolean] false if there is no handler for the event
+ */
+static VALUE EventDispatcher_dispatch_event(VALUE self, VALUE event)
+{
+    SDL_Event* ev;
+    TypedData_Get_Struct(event, SDL_Event, &SDL_Event_data_type, ev);
+    {
+        DispatchEntry* entry = dispatch_entry(Get_EventDispatcher(self), ev->type, 0);
+        VALUE handler;
+        if (!entry || !entry->handler)
+            return Qfalse;
+        handler = rb_ary_entry(rb_iv_get(self, "handlers"), entry->handler - 1);
+        if (entry->raw && !is_user_event(ev)) {
+            VALUE args[5];
+            int n = raw_event_args(ev, args);
+            rb_funcallv(handler, id_call, n, args);
+        } else if (entry->raw) {
+            VALUE args[2];
+            args[0] = INT2NUM(ev->user.code);
+            args[1] = rb_iv_get(event, "data");
+            rb_funcallv(handler, id_call, 2, args);
+        } else {
+            rb_funcallv(handler, id_call, 1, &event);
+        }
+        return Qtrue;
+    }
+}
+
+/* The header of event logs written by SDL2::Event::Recorder */
+#define EVENT_LOG_MAGIC "RSDL2EVT"
+#define EVENT_LOG_VERSION 1
+#define EVENT_LOG_HEADER_SIZE 16
+
+/* Return true if the event can be replayed (has no pointers to SDL's or user's data) */
+static int event_recordable(const SDL_Event* ev)
+{
+    switch (ev->type) {
+    case SDL_SYSWMEVENT:
+#if SDL_VERSION_ATLEAST(2,0,0)
+    case SDL_DROPFILE:
+#endif
+#if SDL_VERSION_ATLEAST(2,0,5)
+    case SDL_DROPTEXT:
+#endif
+#if SDL_VERSION_ATLEAST(2,0,22)
+    case SDL_TEXTEDITING_EXT: /* text is a heap pointer owned by SDL */
+#endif
+        return 0;
+    default:
+        return ev->type < SDL_USEREVENT;
+    }
+}
+
+typedef struct EventRecorder {
+    SDL_mutex* mutex;
+    char* buf;
+    size_t len;
+    size_t capa;
+    Uint32 start_ticks;
+    int recording;
+    Uint64 count;
+    Uint64 lost;
+} EventRecorder;
+
+static void EventRecorder_stop(EventRecorder* r);
+
+static void EventRecorder_free(EventRecorder* r)
 {
-    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    return rb_sprintf("<%s: type=%u timestamp=%u which=%d hat=%u value=%u>",
-                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->jhat.which, ev->jhat.hat, ev->jhat.value);
+    if (r->recording) {
+        /*
+         * Garbage collected without #stop. The watch may be running on another
+         * thread right now and about to lock the mutex, so the mutex and the
+         * struct are leaked; only the buffer is freed after the watch
+         * sees recording == 0.
+         */
+        EventRecorder_stop(r);
+        SDL_LockMutex(r->mutex);
+        free(r->buf);
+        r->buf = NULL;
+        r->len = r->capa = 0;
+        SDL_UnlockMutex(r->mutex);
+        return;
+    }
+    if (r->mutex)
+        SDL_DestroyMutex(r->mutex);
+    free(r->buf);
+    free(r);
 }
 
+DEFINE_DATA_TYPE(EventRecorder, EventRecorder_free);
+DEFINE_GETTER(static, EventRecorder, cEventRecorder, "SDL2::Event::Recorder");
+
 /*
- * Document-class: SDL2::Event::JoyDevice
+ * Append a record to the buffer; r->mutex must be locked.
  *
- * This class represents joystick device events
- * ({SDL2::Event::JoyDeviceAdded joystick connected events} and
- *  {SDL2::Event::JoyDeviceRemoved joystick disconnected events}).
+ * A record is the time in milliseconds since the recording started (Uint32),
+ * the length of the event (Uint8), and the SDL_Event without trailing zero bytes.
  */
-EVENT_ACCESSOR_INT(JoyDevice, which, jdevice.which);
-/* @return [String] inspection string */
-static VALUE EvJoyDevice_inspect(VALUE self)
+static void EventRecorder_append(EventRecorder* r, const SDL_Event* ev)
 {
-    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    return rb_sprintf("<%s: type=%u timestamp=%u which=%d>",
-                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->jdevice.which);
+    const Uint8* bytes = (const Uint8*)ev;
+    size_t size = sizeof(SDL_Event);
+    /* events queued before start are recorded at time 0 */
+    Uint32 time = ((Sint32)(ev->common.timestamp - r->start_ticks) > 0) ?
+        ev->common.timestamp - r->start_ticks : 0;
+
+    while (size > sizeof(Uint32) && bytes[size-1] == 0)
+        --size;
+    if (r->len + sizeof(Uint32) + 1 + size > r->capa) {
+        size_t capa = r->capa ? r->capa * 2 : 4096;
+        char* buf = realloc(r->buf, capa);
+        if (!buf) {
+            ++r->lost;
+            return;
+        }
+        r->buf = buf;
+        r->capa = capa;
+    }
+    memcpy(r->buf + r->len, &time, sizeof(Uint32));
+    r->buf[r->len + sizeof(Uint32)] = (char)size;
+    memcpy(r->buf + r->len + sizeof(Uint32) + 1, ev, size);
+    r->len += sizeof(Uint32) + 1 + size;
+    ++r->count;
+}
+
+/* The callback for SDL_AddEventWatch; called from the thread pushing the event */
+static int SDLCALL EventRecorder_watch(void* userdata, SDL_Event* ev)
+{
+    EventRecorder* r = userdata;
+    if (!event_recordable(ev))
+        return 0;
+    SDL_LockMutex(r->mutex);
+    if (r->recording)
+        EventRecorder_append(r, ev);
+    SDL_UnlockMutex(r->mutex);
+    return 0;
+}
+
+static void EventRecorder_stop(EventRecorder* r)
+{
+    if (!r->recording)
+        return;
+    SDL_DelEventWatch(EventRecorder_watch, r);
+    SDL_LockMutex(r->mutex);
+    r->recording = 0;
+    SDL_UnlockMutex(r->mutex);
+}
+
+static VALUE EventRecorder_s_allocate(VALUE klass)
+{
+    EventRecorder* r;
+    VALUE obj = TypedData_Make_Struct(klass, EventRecorder, &EventRecorder_data_type, r);
+    r->mutex = NULL;
+    r->buf = NULL;
+    r->len = r->capa = 0;
+    r->recording = 0;
+    r->count = r->lost = 0;
+    return obj;
 }
 
 /*
- * Document-class: SDL2::Event::JoyDeviceAdded
- *
- * This class represents joystick device connected events.
+ * Document-class: SDL2::Event::Recorder
+ *
+ * This class records events to a compact binary log, which can be
+ * replayed by {SDL2::Event::Player}.
+ *
+ * Events are captured in C by SDL_AddEventWatch when they are pushed
+ * to the event queue, so all events are recorded regardless of
+ * how they are fetched. Events are buffered natively and written to
+ * the IO by {#flush} and {#stop}.
+ *
+ * Each record is the time since {#start} in milliseconds, and the raw SDL_Event
+ * without trailing zero bytes; a mouse motion event takes about 40 bytes.
+ * Wrap the IO with Zlib::GzipWriter to compress the log further.
+ *
+ * The log depends on the SDL version and the platform (the layout and the byte order of
+ * SDL_Event). Events with pointers to external data (drop events, system
+ * dependent events, extended text editing events and user events) are not recorded.
+ *
+ * Call {#stop} before discarding a recorder. The event watch can run on
+ * any thread, so a recorder garbage collected while recording cannot
+ * safely release its native state and leaks it.
+ *
+ * @example
+ *   Zlib::GzipWriter.open("session.log.gz") do |gz|
+ *     recorder = SDL2::Event::Recorder.new(gz)
+ *     recorder.start
+ *     main_loop
+ *     recorder.stop
+ *   end
  */
+
 /*
- * Document-class: SDL2::Event::JoyDeviceRemoved
+ * @overload initialize(io)
+ *   Create a recorder writing to the IO and write the header of the log.
  *
- * This class represents joystick device disconnected events.
+ *   @param [IO] io the destination of the log; any object with a write method,
+ *     such as File, StringIO and Zlib::GzipWriter
  */
-
+static VALUE EventRecorder_initialize(VALUE self, VALUE io)
+{
+    EventRecorder* r = Get_EventRecorder(self);
+    char header[EVENT_LOG_HEADER_SIZE];
+    Uint32 version = EVENT_LOG_VERSION, event_size = sizeof(SDL_Event);
+
+    if (!r->mutex) {
+        r->mutex = SDL_CreateMutex();
+        if (!r->mutex)
+            SDL_ERROR();
+    }
+    memcpy(header, EVENT_LOG_MAGIC, 8);
+    memcpy(header + 8, &version, sizeof(Uint32));
+    memcpy(header + 12, &event_size, sizeof(Uint32));
+    rb_funcall(io, rb_intern("write"), 1, rb_str_new(header, EVENT_LOG_HEADER_SIZE));
+    rb_iv_set(self, "io", io);
+    return Qnil;
+}
 
 /*
- * Document-class: SDL2::Event::ControllerAxisMotion
- *
- * This class represents the {SDL2::GameController controller} axis motion events.
- *
- * @attribute which
- *   the controller index
- *   @return [Integer]
+ * Start recording.
  *
- * @attribute axis
- *   the axis index
- *   @return [Integer]
+ * Times in the log are relative to this call.
  *
- * @attribute value
- *   the axis value (range: -32768 to -32767, 0 for newtral)
- *   @return [Integer]
+ * @return [self]
  */
-EVENT_ACCESSOR_INT(ControllerAxis, which, caxis.which);
-EVENT_ACCESSOR_UINT8(ControllerAxis, axis, caxis.axis);
-EVENT_ACCESSOR_INT(ControllerAxis, value, caxis.value);
-/* @return [String] inspection string */
-static VALUE ControllerAxis_inspect(VALUE self)
+static VALUE EventRecorder_start(VALUE self)
 {
-    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    return rb_sprintf("<%s: type=%u timestamp=%u"
-                      " which=%d axis=%s value=%d>",
-                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->caxis.which, SDL_GameControllerGetStringForAxis(ev->caxis.axis),
-                      ev->caxis.value);
+    EventRecorder* r = Get_EventRecorder(self);
+    if (!r->mutex)
+        rb_raise(eSDL2Error, "recorder is not initialized");
+    if (r->recording)
+        return self;
+    SDL_LockMutex(r->mutex);
+    r->start_ticks = SDL_GetTicks();
+    r->recording = 1;
+    SDL_UnlockMutex(r->mutex);
+    SDL_AddEventWatch(EventRecorder_watch, r);
+    return self;
+}
+
+typedef struct RecordBuffer {
+    char* buf;
+    size_t len;
+} RecordBuffer;
+
+static VALUE RecordBuffer_to_str(VALUE arg)
+{
+    RecordBuffer* b = (RecordBuffer*)arg;
+    return rb_str_new(b->buf, b->len);
 }
 
 /*
- * Document-class: SDL2::Event::ControllerButton
- *
- * This class represents the {SDL2::GameController controller} button events.
- *
- * You don't handle the instance 
- * of this class directly, but you handle the instances of 
- * two subclasses of this subclasses:
- * {SDL2::Event::ControllerButtonDown} and {SDL2::Event::ControllerButtonUp}.
- *
- * @attribute which
- *   the controller index
- *   @return [Integer]
- *
- * @attribute button
- *   the controller button index
- *   @return [Integer]
+ * Write buffered records to the IO.
  *
- * @attribute pressed
- *   button is pressed or not
- *   @return [Boolean]
+ * Call this method periodically in long sessions to bound the memory usage.
  *
+ * @return [self]
  */
-EVENT_ACCESSOR_INT(ControllerButton, which, cbutton.which);
-EVENT_ACCESSOR_UINT8(ControllerButton, button, cbutton.button);
-EVENT_ACCESSOR_BOOL(ControllerButton, pressed, cbutton.state);
-/* @return [String] inspection string */
-static VALUE ControllerButton_inspect(VALUE self)
+static VALUE EventRecorder_flush(VALUE self)
 {
-    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    return rb_sprintf("<%s: type=%u timestamp=%u"
-                      " which=%d button=%s state=%s>",
-                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->cbutton.which,
-                      SDL_GameControllerGetStringForButton(ev->cbutton.button),
-                      INT2BOOLCSTR(ev->cbutton.state));
+    EventRecorder* r = Get_EventRecorder(self);
+    RecordBuffer b;
+    VALUE data;
+    int state;
+
+    if (!r->mutex)
+        return self;
+    /* take the buffer; the watch allocates a new one. Ruby objects are
+     * created after unlocking, since a raise must not leave the mutex locked */
+    SDL_LockMutex(r->mutex);
+    b.buf = r->buf;
+    b.len = r->len;
+    r->buf = NULL;
+    r->len = r->capa = 0;
+    SDL_UnlockMutex(r->mutex);
+    if (b.len == 0) {
+        free(b.buf);
+        return self;
+    }
+    data = rb_protect(RecordBuffer_to_str, (VALUE)&b, &state);
+    free(b.buf);
+    if (state)
+        rb_jump_tag(state);
+    rb_funcall(rb_iv_get(self, "io"), rb_intern("write"), 1, data);
+    return self;
 }
-/*
- * Document-class: SDL2::Event::ControllerButtonDown
- *
- * This class represents the {SDL2::GameController controller} button press events.
- */
 
 /*
- * Document-class: SDL2::Event::ControllerButtonUp
+ * Stop recording, and write buffered records to the IO.
  *
- * This class represents the {SDL2::GameController controller} button release events.
+ * The IO is not closed.
+ *
+ * @return [self]
  */
+static VALUE EventRecorder_stop_rb(VALUE self)
+{
+    EventRecorder_stop(Get_EventRecorder(self));
+    return EventRecorder_flush(self);
+}
 
 /*
- * Document-class: SDL2::Event::ControllerDevice
- *
- * This class represents {SDL2::GameController controller} device events (connected/disconnected/remapped).
- *
- * The event of this event doesn't occur. Only the event of the following subclasses
- * occur in Ruby/SDL2.
+ * @overload record(event)
+ *   Record an event explicitly.
  *
- *   * {SDL2::Event::ControllerDeviceAdded}
- *   * {SDL2::Event::ControllerDeviceRemoved}
- *   * {SDL2::Event::ControllerDeviceRemapped}
+ *   This is useful for events which do not pass the event queue.
  *
- * @attribute which
- *   the controller index
- *   @return [Integer]
+ *   @param [SDL2::Event] event the event to record
+ *   @return [self]
  */
-EVENT_ACCESSOR_INT(ControllerDevice, which, cdevice.which);
-/* @return [String] inspection string */
-static VALUE ControllerDevice_inspect(VALUE self)
+static VALUE EventRecorder_record(VALUE self, VALUE event)
 {
-    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    return rb_sprintf("<%s: type=%u timestamp=%u which=%d>",
-                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      ev->cdevice.which);
+    EventRecorder* r = Get_EventRecorder(self);
+    SDL_Event* ev;
+
+    TypedData_Get_Struct(event, SDL_Event, &SDL_Event_data_type, ev);
+    if (!r->recording)
+        rb_raise(eSDL2Error, "recorder is not started");
+    if (!event_recordable(ev))
+        rb_raise(rb_eArgError, "event type %u cannot be recorded", ev->type);
+    SDL_LockMutex(r->mutex);
+    EventRecorder_append(r, ev);
+    SDL_UnlockMutex(r->mutex);
+    return self;
+}
+
+/* Return true if recording. */
+static VALUE EventRecorder_recording_p(VALUE self)
+{
+    return INT2BOOL(Get_EventRecorder(self)->recording);
+}
+
+/* @return [Integer] the number of recorded events */
+static VALUE EventRecorder_count(VALUE self)
+{
+    return ULL2NUM(Get_EventRecorder(self)->count);
+}
+
+/* @return [Integer] the number of events not recorded because of memory shortage */
+static VALUE EventRecorder_lost(VALUE self)
+{
+    return ULL2NUM(Get_EventRecorder(self)->lost);
+}
+
+typedef struct EventPlayer {
+    /* the content of the hidden ivar "log"; refreshed by Get_EventPlayer_data
+     * because GC compaction can move embedded strings */
+    const char* data;
+    long len;
+    long pos;
+    Uint64 index;
+    Uint32 start_ticks;
+    int started;
+} EventPlayer;
+
+DEFINE_DATA_TYPE(EventPlayer, free);
+DEFINE_GETTER(static, EventPlayer, cEventPlayer, "SDL2::Event::Player");
+
+/* Get the player, with data pointing to the current buffer of the log */
+static EventPlayer* Get_EventPlayer_data(VALUE self)
+{
+    EventPlayer* p = Get_EventPlayer(self);
+    VALUE log = rb_iv_get(self, "log");
+    p->data = NIL_P(log) ? NULL : RSTRING_PTR(log);
+    return p;
+}
+
+static VALUE EventPlayer_s_allocate(VALUE klass)
+{
+    EventPlayer* p;
+    VALUE obj = TypedData_Make_Struct(klass, EventPlayer, &EventPlayer_data_type, p);
+    p->data = NULL;
+    p->len = p->pos = 0;
+    p->index = 0;
+    p->started = 0;
+    return obj;
 }
 
 /*
- * Document-class: SDL2::Event::ControllerDeviceAdded
- *
- * This class represents {SDL2::GameController controller} device connected events.
+ * Read the record at the current position to ev (without advancing).
+ * Return 0 at the end of the log.
  */
+static int EventPlayer_peek(EventPlayer* p, SDL_Event* ev, Uint32* time)
+{
+    size_t size;
+
+    if (p->pos + (long)sizeof(Uint32) + 1 > p->len)
+        return 0;
+    size = (Uint8)p->data[p->pos + sizeof(Uint32)];
+    if (size > sizeof(SDL_Event) || p->pos + (long)(sizeof(Uint32) + 1 + size) > p->len)
+        rb_raise(eSDL2Error, "broken event log at %ld", p->pos);
+    memcpy(time, p->data + p->pos, sizeof(Uint32));
+    memset(ev, 0, sizeof(SDL_Event));
+    memcpy(ev, p->data + p->pos + sizeof(Uint32) + 1, size);
+    if (ev->type >= SDL_LASTEVENT)
+        rb_raise(eSDL2Error, "broken event log at %ld", p->pos);
+    return 1;
+}
+
+static void EventPlayer_advance(EventPlayer* p)
+{
+    p->pos += sizeof(Uint32) + 1 + (Uint8)p->data[p->pos + sizeof(Uint32)];
+    ++p->index;
+}
+
 /*
- * Document-class: SDL2::Event::ControllerDeviceRemoved
- *
- * This class represents {SDL2::GameController controller} device disconnected events.
+ * Document-class: SDL2::Event::Player
+ *
+ * This class replays an event log written by {SDL2::Event::Recorder}.
+ *
+ * Events can be pushed to the event queue by SDL_PushEvent
+ * (in real time by {#push_due}, or as fast as possible by {#push}), or
+ * fetched directly as {SDL2::Event} objects by {#poll} without the event queue.
+ *
+ * The player works with the dummy video driver
+ * (SDL_VIDEODRIVER=dummy), so recorded sessions can be replayed headlessly.
+ * Note that window IDs and joystick instance IDs in the log refer to
+ * the windows and joysticks at the time of recording.
+ *
+ * @example replay a session as fast as possible
+ *   player = SDL2::Event::Player.new(Zlib::GzipReader.open("session.log.gz", &:read))
+ *   until player.finished?
+ *     player.push(256)
+ *     SDL2::Event.drain{|ev| game.handle(ev) }
+ *     game.update
+ *   end
  */
+
 /*
- * Document-class: SDL2::Event::ControllerDeviceRemapped
+ * @overload initialize(log)
+ *   Load an event log.
  *
- * This class represents {SDL2::GameController controller} device remapped events.
+ *   @param [String,IO] log the content of the log, or an IO to read it from
+ *   @raise [SDL2::Error] raised when the log is not written by
+ *     {SDL2::Event::Recorder} of the same SDL version and platform
  */
+static VALUE EventPlayer_initialize(VALUE self, VALUE log)
+{
+    EventPlayer* p = Get_EventPlayer(self);
+    Uint32 version, event_size;
+    const char* data;
+
+    if (!RB_TYPE_P(log, T_STRING))
+        log = rb_funcall(log, rb_intern("read"), 0);
+    log = rb_str_new_frozen(StringValue(log));
+    data = RSTRING_PTR(log);
+    if (RSTRING_LEN(log) < EVENT_LOG_HEADER_SIZE || memcmp(data, EVENT_LOG_MAGIC, 8) != 0)
+        rb_raise(eSDL2Error, "not an event log");
+    memcpy(&version, data + 8, sizeof(Uint32));
+    memcpy(&event_size, data + 12, sizeof(Uint32));
+    if (version != EVENT_LOG_VERSION || event_size != sizeof(SDL_Event))
+        rb_raise(eSDL2Error, "incompatible event log (version %u, event size %u)",
+                 version, event_size);
+
+    rb_iv_set(self, "log", log);
+    p->data = data;
+    p->len = RSTRING_LEN(log);
+    p->pos = EVENT_LOG_HEADER_SIZE;
+    p->index = 0;
+    p->started = 0;
+    return Qnil;
+}
 
 /*
- * Document-class: SDL2::Event::TouchFinger
- *
- * This class represents touch finger events.
- * 
- * You don't handle the instance 
- * of this class directly, but you handle the instances of 
- * two subclasses of this subclasses:
- * {SDL2::Event::FingerMotion}, {SDL2::Event::FingerDown}, and {SDL2::Event::FingerUp}.
- *
- * @attribute touch_id
- *   the touch device id
- *   @return [Integer]
- *
- * @attribute finger_id
- *   the finger id
- *   @return [Integer]
- *
- * @attribute x
- *   the x-axis location of the touch event, normalized (0...1)
- *   @return [Float]
+ * Fetch the next event directly, ignoring the recorded time.
  *
- * @attribute y
- *   the y-axis location of the touch event, normalized (0...1)
- *   @return [Float]
+ * The event does not pass the event queue, so event filters and
+ * {SDL2::Event.coalesce_motion=} are not applied, and the recorded timestamp is kept.
  *
- * @attribute pressure
- *   the quantity of pressure applied, normalized (0...1)
- *   @return [Float]
+ * @return [SDL2::Event] the next event
+ * @return [nil] at the end of the log
  */
-EVENT_ACCESSOR_INT(TouchFinger, touch_id, tfinger.touchId);
-EVENT_ACCESSOR_INT(TouchFinger, finger_id, tfinger.fingerId);
-EVENT_ACCESSOR_DBL(TouchFinger, x, tfinger.x);
-EVENT_ACCESSOR_DBL(TouchFinger, y, tfinger.y);
-EVENT_ACCESSOR_DBL(TouchFinger, pressure, tfinger.pressure);
-/* @return [String] inspection string */
-static VALUE EvTouchFinger_inspect(VALUE self)
+static VALUE EventPlayer_poll(VALUE self)
 {
-    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    return rb_sprintf("<%s: type=%u timestamp=%u"
-                      " touch_id=%d finger_id=%d"
-                      " x=%f y=%f pressure=%f>",
-                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      (int)ev->tfinger.touchId, (int)ev->tfinger.fingerId,
-                      ev->tfinger.x, ev->tfinger.y, ev->tfinger.pressure);
+    EventPlayer* p = Get_EventPlayer_data(self);
+    SDL_Event ev;
+    Uint32 time;
+
+    if (!EventPlayer_peek(p, &ev, &time))
+        return Qnil;
+    EventPlayer_advance(p);
+    return Event_new(&ev);
+}
+
+/* Push events by SDL_PushEvent until the log ends, max events are pushed, or
+ * (if realtime) the next event is not due yet. */
+static long EventPlayer_push_events(EventPlayer* p, long max, int realtime)
+{
+    SDL_Event ev;
+    Uint32 time, now;
+    long count = 0;
+
+    if (!p->started) {
+        p->start_ticks = SDL_GetTicks();
+        p->started = 1;
+    }
+    now = SDL_GetTicks() - p->start_ticks;
+    while ((max < 0 || count < max) && EventPlayer_peek(p, &ev, &time)) {
+        if (realtime && time > now)
+            break;
+        /* SDL_PushEvent fails when the queue is full; retry at the next call */
+        if (SDL_PushEvent(&ev) < 0)
+            break;
+        EventPlayer_advance(p);
+        ++count;
+    }
+    return count;
 }
 
 /*
- * Document-class: SDL2::Event::FingerUp
- * This class represents finger touch events.
- */
-/*
- * Document-class: SDL2::Event::FingerDown
- * This class represents finger release events.
+ * @overload push(max=nil)
+ *   Push the following events to the event queue as fast as possible.
+ *
+ *   Events are pushed until the log ends, **max** events are pushed,
+ *   or the event queue is full.
+ *   Call this in the main loop with a moderate **max** to run
+ *   a recorded session at full speed.
+ *
+ *   @param [Integer,nil] max the maximum number of events to push, nil for no limit
+ *   @return [Integer] the number of pushed events
  */
+static VALUE EventPlayer_push(int argc, VALUE* argv, VALUE self)
+{
+    VALUE max;
+    rb_scan_args(argc, argv, "01", &max);
+    return LONG2NUM(EventPlayer_push_events(Get_EventPlayer_data(self),
+                                            max == Qnil ? -1 : NUM2LONG(max), 0));
+}
 
 /*
- * Document-class: SDL2::Event::FingerMotion
- *
- * This class represents touch move events.
+ * Push the events whose recorded time has come to the event queue.
  *
- * @attribute dx
- *   the distance moved in the x-axis, normalized (0...1)
- *   @return [Float]
+ * Time is measured from the first call of {#push_due} or {#push}
+ * after creation or {#rewind}. Call this once per frame to replay the
+ * session in real time.
  *
- * @attribute dy
- *   the distance moved in the y-axis, normalized (0...1)
- *   @return [Float]
+ * @return [Integer] the number of pushed events
+ */
+static VALUE EventPlayer_push_due(VALUE self)
+{
+    return LONG2NUM(EventPlayer_push_events(Get_EventPlayer_data(self), -1, 1));
+}
+
+/*
+ * Rewind to the beginning of the log.
  *
+ * @return [self]
  */
-EVENT_ACCESSOR_DBL(FingerMotion, dx, tfinger.dx);
-EVENT_ACCESSOR_DBL(FingerMotion, dy, tfinger.dy);
-/* @return [String] inspection string */
-static VALUE EvFingerMotion_inspect(VALUE self)
+static VALUE EventPlayer_rewind(VALUE self)
 {
-    SDL_Event* ev; TypedData_Get_Struct(self, SDL_Event, &SDL_Event_data_type, ev);
-    return rb_sprintf("<%s: type=%u timestamp=%u"
-                      " touch_id=%d finger_id=%d"
-                      " x=%f y=%f pressure=%f"
-                      " dy=%f dx=%f>",
-                      rb_obj_classname(self), ev->common.type, ev->common.timestamp,
-                      (int) ev->tfinger.touchId, (int) ev->tfinger.fingerId,
-                      ev->tfinger.x, ev->tfinger.y, ev->tfinger.pressure,
-                      ev->tfinger.dx, ev->tfinger.dx);
+    EventPlayer* p = Get_EventPlayer(self);
+    if (p->data)
+        p->pos = EVENT_LOG_HEADER_SIZE;
+    p->index = 0;
+    p->started = 0;
+    return self;
+}
+
+/* Return true if all events are replayed. */
+static VALUE EventPlayer_finished_p(VALUE self)
+{
+    EventPlayer* p = Get_EventPlayer(self);
+    return INT2BOOL(p->pos + (long)sizeof(Uint32) + 1 > p->len);
+}
+
+/* @return [Integer] the number of events already replayed */
+static VALUE EventPlayer_position(VALUE self)
+{
+    return ULL2NUM(Get_EventPlayer(self)->index);
 }
 
 /*
@@ -1054,6 +3306,9 @@ static void init_event_type_to_class(void)
     connect_event_class(SDL_FINGERDOWN, cEvFingerDown);
     connect_event_class(SDL_FINGERUP, cEvFingerUp);
     connect_event_class(SDL_FINGERMOTION, cEvFingerMotion);
+    for (i=SDL_USEREVENT; i<SDL_LASTEVENT; ++i)
+        event_type_to_class[i] = cEvUser;
+    rb_iv_set(cEvUser, "event_type", INT2NUM(SDL_USEREVENT));
 }
 
 #define DEFINE_EVENT_READER(classname, classvar, name)                  \
@@ -1073,6 +3328,26 @@ void rubysdl2_init_event(void)
     cEvent = rb_define_class_under(mSDL2, "Event", rb_cObject);
     rb_define_alloc_func(cEvent, Event_s_allocate);
     rb_define_singleton_method(cEvent, "poll", Event_s_poll, 0);
+    rb_define_singleton_method(cEvent, "poll_all", Event_s_poll_all, -1);
+    rb_define_singleton_method(cEvent, "wait", Event_s_wait, -1);
+    rb_define_singleton_method(cEvent, "poll_into", Event_s_poll_into, -1);
+    rb_define_singleton_method(cEvent, "poll_raw_into", Event_s_poll_raw_into, -1);
+    rb_define_singleton_method(cEvent, "event_type", Event_s_event_type, 0);
+    rb_define_singleton_method(cEvent, "coalesce_motion?", Event_s_coalesce_motion_p, 0);
+    rb_define_singleton_method(cEvent, "coalesce_motion=", Event_s_set_coalesce_motion, 1);
+    rb_define_singleton_method(cEvent, "coalesced_count", Event_s_coalesced_count, 0);
+    rb_define_singleton_method(cEvent, "set_filter", Event_s_set_filter, 1);
+    rb_define_singleton_method(cEvent, "clear_filter", Event_s_clear_filter, 0);
+    rb_define_singleton_method(cEvent, "filtered_count", Event_s_filtered_count, 0);
+    rb_define_singleton_method(cEvent, "push", Event_s_push, 1);
+    rb_define_singleton_method(cEvent, "register_types", Event_s_register_types, -1);
+    /* Size of a record written by {.poll_into} */
+    rb_define_const(cEvent, "COMPACT_SIZE", INT2NUM(sizeof(CompactEvent)));
+    /* Layout of a record written by {.poll_into} in Array#pack notation */
+    rb_define_const(cEvent, "COMPACT_FORMAT", rb_str_freeze(rb_str_new2("L3l5")));
+    /* Size of a record (SDL_Event) written by {.poll_raw_into} */
+    rb_define_const(cEvent, "RAW_SIZE", INT2NUM(sizeof(SDL_Event)));
+    rb_define_singleton_method(cEvent, "drain", Event_s_drain, -1);
     rb_define_singleton_method(cEvent, "enabled?", Event_s_enabled_p, 0);
     rb_define_singleton_method(cEvent, "enable=", Event_s_set_enable, 1);
     
@@ -1110,12 +3385,43 @@ void rubysdl2_init_event(void)
     cEvFingerUp = rb_define_class_under(cEvent, "FingerUp", cEvTouchFinger);
     cEvFingerDown = rb_define_class_under(cEvent, "FingerDown", cEvTouchFinger);
     cEvFingerMotion = rb_define_class_under(cEvent, "FingerMotion", cEvTouchFinger);
+    cEvUser = rb_define_class_under(cEvent, "User", cEvent);
+
+    cEventRecorder = rb_define_class_under(cEvent, "Recorder", rb_cObject);
+    rb_define_alloc_func(cEventRecorder, EventRecorder_s_allocate);
+    rb_define_method(cEventRecorder, "initialize", EventRecorder_initialize, 1);
+    rb_define_method(cEventRecorder, "start", EventRecorder_start, 0);
+    rb_define_method(cEventRecorder, "stop", EventRecorder_stop_rb, 0);
+    rb_define_method(cEventRecorder, "flush", EventRecorder_flush, 0);
+    rb_define_method(cEventRecorder, "record", EventRecorder_record, 1);
+    rb_define_method(cEventRecorder, "recording?", EventRecorder_recording_p, 0);
+    rb_define_method(cEventRecorder, "count", EventRecorder_count, 0);
+    rb_define_method(cEventRecorder, "lost", EventRecorder_lost, 0);
+
+    cEventPlayer = rb_define_class_under(cEvent, "Player", rb_cObject);
+    rb_define_alloc_func(cEventPlayer, EventPlayer_s_allocate);
+    rb_define_method(cEventPlayer, "initialize", EventPlayer_initialize, 1);
+    rb_define_method(cEventPlayer, "poll", EventPlayer_poll, 0);
+    rb_define_method(cEventPlayer, "push", EventPlayer_push, -1);
+    rb_define_method(cEventPlayer, "push_due", EventPlayer_push_due, 0);
+    rb_define_method(cEventPlayer, "rewind", EventPlayer_rewind, 0);
+    rb_define_method(cEventPlayer, "finished?", EventPlayer_finished_p, 0);
+    rb_define_method(cEventPlayer, "position", EventPlayer_position, 0);
+
+    cEventDispatcher = rb_define_class_under(mSDL2, "EventDispatcher", rb_cObject);
+    rb_define_alloc_func(cEventDispatcher, EventDispatcher_s_allocate);
+    rb_define_method(cEventDispatcher, "on", EventDispatcher_on, -1);
+    rb_define_method(cEventDispatcher, "off", EventDispatcher_off, 1);
+    rb_define_method(cEventDispatcher, "handles?", EventDispatcher_handles_p, 1);
+    rb_define_method(cEventDispatcher, "dispatch", EventDispatcher_dispatch, 0);
+    rb_define_method(cEventDispatcher, "dispatch_event", EventDispatcher_dispatch_event, 1);
     
     
     
     DEFINE_EVENT_READER(Event, cEvent, type);
     DEFINE_EVENT_ACCESSOR(Event, cEvent, timestamp);
     rb_define_method(cEvent, "inspect", Event_inspect, 0);
+    rb_define_method(cEvent, "initialize_copy", Event_initialize_copy, 1);
     rb_define_method(cEvent, "window", Event_window, 0);
     
     DEFINE_EVENT_ACCESSOR(Window, cEvWindow, window_id);
@@ -1227,6 +3533,17 @@ void rubysdl2_init_event(void)
     DEFINE_EVENT_ACCESSOR(ControllerDevice, cEvControllerDevice, which);
     rb_define_method(cEvControllerDevice, "inspect", ControllerDevice_inspect, 0);
 
+    DEFINE_EVENT_ACCESSOR(User, cEvUser, window_id);
+    DEFINE_EVENT_ACCESSOR(User, cEvUser, code);
+    rb_define_method(cEvUser, "type=", EvUser_set_type, 1);
+    rb_define_method(cEvUser, "data", EvUser_data, 0);
+    rb_define_method(cEvUser, "data=", EvUser_set_data, 1);
+    rb_define_method(cEvUser, "latency", EvUser_latency, 0);
+    rb_define_method(cEvUser, "inspect", EvUser_inspect, 0);
+    rb_define_singleton_method(cEvUser, "push", EvUser_s_push, -1);
+    rb_define_singleton_method(cEvUser, "pending_payloads", EvUser_s_pending_payloads, 0);
+    rb_define_singleton_method(cEvUser, "clear_payloads", EvUser_s_clear_payloads, 0);
+
     DEFINE_EVENT_ACCESSOR(TouchFinger, cEvTouchFinger, touch_id);
     DEFINE_EVENT_ACCESSOR(TouchFinger, cEvTouchFinger, finger_id);
     DEFINE_EVENT_ACCESSOR(TouchFinger, cEvTouchFinger, x); 
@@ -1239,4 +3556,14 @@ void rubysdl2_init_event(void)
     rb_define_method(cEvFingerMotion, "inspect", EvFingerMotion_inspect, 0);
     
     init_event_type_to_class();
+    reusable_events = rb_ary_new();
+    rb_gc_register_address(&reusable_events);
+    user_payloads = rb_hash_new();
+    rb_gc_register_address(&user_payloads);
+
+    sym_types = ID2SYM(rb_intern("types"));
+    sym_window_ids = ID2SYM(rb_intern("window_ids"));
+    sym_joysticks = ID2SYM(rb_intern("joysticks"));
+    sym_scancodes = ID2SYM(rb_intern("scancodes"));
+    id_call = rb_intern("call");
 }
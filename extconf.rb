@@ -56,5 +56,7 @@ have_const("MIX_INIT_MID", "SDL_mixer.h")
 have_const("SDL_RENDERER_PRESENTVSYNC", "SDL_render.h")
 have_const("SDL_WINDOW_ALLOW_HIGHDPI", "SDL_video.h")
 have_const("SDL_WINDOW_MOUSE_CAPTURE", "SDL_video.h")
+have_func("rb_io_buffer_get_bytes_for_reading", "ruby/io/buffer.h")
+have_func("rb_memory_view_register", "ruby/memory_view.h")
 
 create_makefile('sdl2_ext')
@@ -86,6 +86,243 @@ static VALUE Key_s_pressed_p(VALUE self, VALUE code)
     return INT2BOOL(state[scancode]);
 }
 
+/*
+ * Document-class: SDL2::Key::Snapshot
+ *
+ * This class keeps snapshots of the keyboard state of the current and
+ * the previous frames.
+ *
+ * {#update} copies the keyboard state of SDL once per frame into a native
+ * double buffer. Queries of this class only look at the snapshots,
+ * so they are cheap and consistent within a frame, and the keys
+ * pressed or released since the last frame are detected without diffing in Ruby.
+ *
+ * Keys pressed and released between two updates are not detected,
+ * because only the state at each {#update} is recorded.
+ *
+ * @example
+ *   keys = SDL2::Key::Snapshot.new
+ *   jump_keys = [SDL2::Key::Scan::SPACE, SDL2::Key::Scan::W, SDL2::Key::Scan::UP]
+ *   loop do
+ *     while ev = SDL2::Event.poll; end
+ *     keys.update
+ *     player.jump if keys.just_pressed_mask(jump_keys) != 0
+ *     player.run if keys.pressed?(SDL2::Key::Scan::LSHIFT)
+ *   end
+ */
+static VALUE cKeySnapshot;
+
+typedef struct KeySnapshot {
+    Uint8 states[2][SDL_NUM_SCANCODES];
+    int current;
+} KeySnapshot;
+
+DEFINE_DATA_TYPE(KeySnapshot, free);
+DEFINE_GETTER(static, KeySnapshot, cKeySnapshot, "SDL2::Key::Snapshot");
+
+enum {
+    KEY_PRESSED, KEY_JUST_PRESSED, KEY_JUST_RELEASED
+};
+
+static VALUE KeySnapshot_s_allocate(VALUE klass)
+{
+    KeySnapshot* snapshot;
+    VALUE obj = TypedData_Make_Struct(klass, KeySnapshot, &KeySnapshot_data_type, snapshot);
+    memset(snapshot->states, 0, sizeof(snapshot->states));
+    snapshot->current = 0;
+    return obj;
+}
+
+static int key_state(const KeySnapshot* snapshot, int scancode, int kind)
+{
+    Uint8 now = snapshot->states[snapshot->current][scancode];
+    Uint8 before = snapshot->states[!snapshot->current][scancode];
+    switch (kind) {
+    case KEY_PRESSED: return now;
+    case KEY_JUST_PRESSED: return now && !before;
+    default: return !now && before;
+    }
+}
+
+static int scancode_arg(VALUE code)
+{
+    int scancode = NUM2INT(code);
+    if (scancode < 0 || scancode >= SDL_NUM_SCANCODES)
+        rb_raise(rb_eArgError, "scancode out of range (%d)", scancode);
+    return scancode;
+}
+
+/*
+ * Take a new snapshot of the keyboard state.
+ *
+ * The current snapshot becomes the previous one.
+ * Call this once per frame after processing events.
+ *
+ * @return [self]
+ */
+static VALUE KeySnapshot_update(VALUE self)
+{
+    KeySnapshot* snapshot = Get_KeySnapshot(self);
+    int numkeys;
+    const Uint8* state = SDL_GetKeyboardState(&numkeys);
+
+    if (!state)
+        rb_raise(eSDL2Error, "Event subsystem is not initialized");
+    if (numkeys > SDL_NUM_SCANCODES)
+        numkeys = SDL_NUM_SCANCODES;
+    snapshot->current = !snapshot->current;
+    memcpy(snapshot->states[snapshot->current], state, numkeys);
+    return self;
+}
+
+static VALUE key_query(VALUE self, VALUE code, int kind)
+{
+    return INT2BOOL(key_state(Get_KeySnapshot(self), scancode_arg(code), kind));
+}
+
+/*
+ * @overload pressed?(code)
+ *   @param [Integer] code scancode
+ *   @return [Boolean] true if the key is pressed in the current snapshot
+ */
+static VALUE KeySnapshot_pressed_p(VALUE self, VALUE code)
+{
+    return key_query(self, code, KEY_PRESSED);
+}
+
+/*
+ * @overload just_pressed?(code)
+ *   @param [Integer] code scancode
+ *   @return [Boolean] true if the key is pressed in the current snapshot
+ *     and not pressed in the previous one
+ */
+static VALUE KeySnapshot_just_pressed_p(VALUE self, VALUE code)
+{
+    return key_query(self, code, KEY_JUST_PRESSED);
+}
+
+/*
+ * @overload just_released?(code)
+ *   @param [Integer] code scancode
+ *   @return [Boolean] true if the key is pressed in the previous snapshot
+ *     and not pressed in the current one
+ */
+static VALUE KeySnapshot_just_released_p(VALUE self, VALUE code)
+{
+    return key_query(self, code, KEY_JUST_RELEASED);
+}
+
+/* Return an Integer whose i-th bit is the state of codes[i] */
+static VALUE key_mask(VALUE self, VALUE codes, int kind)
+{
+    KeySnapshot* snapshot = Get_KeySnapshot(self);
+    long i, n;
+    unsigned long bits = 0;
+    VALUE mask;
+
+    Check_Type(codes, T_ARRAY);
+    n = RARRAY_LEN(codes);
+    if (n <= (long)(sizeof(bits) * 8)) {
+        for (i=0; i<n; ++i)
+            if (key_state(snapshot, scancode_arg(rb_ary_entry(codes, i)), kind))
+                bits |= 1UL << i;
+        return ULONG2NUM(bits);
+    }
+    mask = INT2FIX(0);
+    for (i=0; i<n; ++i)
+        if (key_state(snapshot, scancode_arg(rb_ary_entry(codes, i)), kind))
+            mask = rb_funcall(mask, '|', 1, rb_funcall(INT2FIX(1), rb_intern("<<"), 1, LONG2NUM(i)));
+    return mask;
+}
+
+/*
+ * @overload pressed_mask(codes)
+ *   Query the states of many keys at once.
+ *
+ *   @param [Array<Integer>] codes scancodes
+ *   @return [Integer] the bitmask whose i-th bit is set if codes[i] is pressed;
+ *     0 if none of the keys are pressed
+ */
+static VALUE KeySnapshot_pressed_mask(VALUE self, VALUE codes)
+{
+    return key_mask(self, codes, KEY_PRESSED);
+}
+
+/*
+ * @overload just_pressed_mask(codes)
+ *   Same as {#pressed_mask}, but the bits are set for {#just_pressed?} keys.
+ *
+ *   @param [Array<Integer>] codes scancodes
+ *   @return [Integer]
+ */
+static VALUE KeySnapshot_just_pressed_mask(VALUE self, VALUE codes)
+{
+    return key_mask(self, codes, KEY_JUST_PRESSED);
+}
+
+/*
+ * @overload just_released_mask(codes)
+ *   Same as {#pressed_mask}, but the bits are set for {#just_released?} keys.
+ *
+ *   @param [Array<Integer>] codes scancodes
+ *   @return [Integer]
+ */
+static VALUE KeySnapshot_just_released_mask(VALUE self, VALUE codes)
+{
+    return key_mask(self, codes, KEY_JUST_RELEASED);
+}
+
+static VALUE key_list(VALUE self, int kind)
+{
+    KeySnapshot* snapshot = Get_KeySnapshot(self);
+    VALUE list = rb_ary_new();
+    int i;
+    for (i=0; i<SDL_NUM_SCANCODES; ++i)
+        if (key_state(snapshot, i, kind))
+            rb_ary_push(list, INT2FIX(i));
+    return list;
+}
+
+/* @return [Array<Integer>] the scancodes of all pressed keys */
+static VALUE KeySnapshot_pressed_keys(VALUE self)
+{
+    return key_list(self, KEY_PRESSED);
+}
+
+/* @return [Array<Integer>] the scancodes of all {#just_pressed?} keys */
+static VALUE KeySnapshot_just_pressed_keys(VALUE self)
+{
+    return key_list(self, KEY_JUST_PRESSED);
+}
+
+/* @return [Array<Integer>] the scancodes of all {#just_released?} keys */
+static VALUE KeySnapshot_just_released_keys(VALUE self)
+{
+    return key_list(self, KEY_JUST_RELEASED);
+}
+
+/*
+ * Get the current snapshot as a bitset.
+ *
+ * The bit of scancode i is (1 << (i % 8)) of the (i / 8)-th byte.
+ * The size of the String is SDL_NUM_SCANCODES/8 bytes (usually 64).
+ *
+ * @return [String] the bitset of pressed keys
+ */
+static VALUE KeySnapshot_bitset(VALUE self)
+{
+    KeySnapshot* snapshot = Get_KeySnapshot(self);
+    VALUE str = rb_str_new(NULL, (SDL_NUM_SCANCODES + 7) / 8);
+    Uint8* bits = (Uint8*)RSTRING_PTR(str);
+    int i;
+
+    memset(bits, 0, RSTRING_LEN(str));
+    for (i=0; i<SDL_NUM_SCANCODES; ++i)
+        if (snapshot->states[snapshot->current][i])
+            bits[i >> 3] |= 1 << (i & 7);
+    return str;
+}
+
 /*
  * Document-module: SDL2::Key::Scan
  *
@@ -265,6 +502,20 @@ void rubysdl2_init_key(void)
     rb_define_module_function(mKey, "keycode_from_name", Key_s_keycode_from_name, 1);
     rb_define_module_function(mKey, "keycode_from_scancode", Key_s_keycode_from_scancode, 1);
     rb_define_module_function(mKey, "pressed?", Key_s_pressed_p, 1);
+
+    cKeySnapshot = rb_define_class_under(mKey, "Snapshot", rb_cObject);
+    rb_define_alloc_func(cKeySnapshot, KeySnapshot_s_allocate);
+    rb_define_method(cKeySnapshot, "update", KeySnapshot_update, 0);
+    rb_define_method(cKeySnapshot, "pressed?", KeySnapshot_pressed_p, 1);
+    rb_define_method(cKeySnapshot, "just_pressed?", KeySnapshot_just_pressed_p, 1);
+    rb_define_method(cKeySnapshot, "just_released?", KeySnapshot_just_released_p, 1);
+    rb_define_method(cKeySnapshot, "pressed_mask", KeySnapshot_pressed_mask, 1);
+    rb_define_method(cKeySnapshot, "just_pressed_mask", KeySnapshot_just_pressed_mask, 1);
+    rb_define_method(cKeySnapshot, "just_released_mask", KeySnapshot_just_released_mask, 1);
+    rb_define_method(cKeySnapshot, "pressed_keys", KeySnapshot_pressed_keys, 0);
+    rb_define_method(cKeySnapshot, "just_pressed_keys", KeySnapshot_just_pressed_keys, 0);
+    rb_define_method(cKeySnapshot, "just_released_keys", KeySnapshot_just_released_keys, 0);
+    rb_define_method(cKeySnapshot, "bitset", KeySnapshot_bitset, 0);
     rb_define_module_function(mScan, "name_of", Scan_s_name_of, 1);
     rb_define_module_function(mScan, "from_name", Scan_s_from_name, 1);
     rb_define_module_function(mScan, "from_keycode", Scan_s_from_keycode, 1);
@@ -14,6 +14,9 @@
 #endif
 #include <stdarg.h>
 #include <ruby/encoding.h>
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES_FOR_READING
+#include <ruby/io/buffer.h>
+#endif
 
 int rubysdl2_handle_error(int code, const char* cfunc)
 {
@@ -64,6 +67,43 @@ const char* INT2BOOLCSTR(int n)
     return n ? "true" : "false";
 }
 
+/*
+ * Get the memory of a String or an IO::Buffer to read raw bytes from.
+ * The caller must keep obj alive (RB_GC_GUARD) while using the memory.
+ */
+const void* bytes_for_reading(VALUE obj, size_t* len)
+{
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES_FOR_READING
+    if (rb_obj_is_kind_of(obj, rb_cIOBuffer)) {
+        const void* base;
+        rb_io_buffer_get_bytes_for_reading(obj, &base, len);
+        return base;
+    }
+#endif
+    StringValue(obj);
+    *len = RSTRING_LEN(obj);
+    return RSTRING_PTR(obj);
+}
+
+/*
+ * Get the memory of a String or an IO::Buffer to write raw bytes into.
+ * A frozen string or a read-only buffer raises an exception.
+ */
+void* bytes_for_writing(VALUE obj, size_t* len)
+{
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES_FOR_READING
+    if (rb_obj_is_kind_of(obj, rb_cIOBuffer)) {
+        void* base;
+        rb_io_buffer_get_bytes_for_writing(obj, &base, len);
+        return base;
+    }
+#endif
+    StringValue(obj);
+    rb_str_modify(obj);
+    *len = RSTRING_LEN(obj);
+    return RSTRING_PTR(obj);
+}
+
 typedef enum {
     NOT_INITIALIZED, INITIALIZDED, FINALIZED
 } sdl2_state;
@@ -230,8 +270,10 @@ void Init_sdl2_ext(void)
     rubysdl2_init_joystick();
     rubysdl2_init_gamecontorller();
     rubysdl2_init_timer();
+    rubysdl2_init_profiler();
     rubysdl2_init_image();
     rubysdl2_init_mixer();
+    rubysdl2_init_audio();
     rubysdl2_init_ttf();
     rubysdl2_init_filesystem();
     rubysdl2_init_clipboard();
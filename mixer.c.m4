@@ -2,10 +2,19 @@
 #ifdef HAVE_SDL_MIXER_H
 #include "rubysdl2_internal.h"
 #include <SDL_mixer.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+#include <SDL_cpuinfo.h>
+#include <SDL_events.h>
+#include <ruby/thread.h>
+#include <math.h>
 
 static VALUE mMixer;
 static VALUE cChunk;
 static VALUE cMusic;
+static VALUE cChunkFuture;
+static VALUE cSoundBank;
+static VALUE cEffect;
 static VALUE mChannels;
 static VALUE cGroup;
 static VALUE mMusicChannel;
@@ -19,16 +28,21 @@ static VALUE playing_music = Qnil;
 
 typedef struct Chunk {
     Mix_Chunk* chunk;
+    /* the samples of a chunk created by Mix_QuickLoad_RAW, owned by this object */
+    Uint8* raw;
 } Chunk;
 
 typedef struct Music {
     Mix_Music* music;
+    /* the source data of a music loaded from memory; streamed while playing */
+    void* data;
 } Music;
 
 static void Chunk_free(Chunk* c)
 {
     if (rubysdl2_is_active() && c->chunk)
         Mix_FreeChunk(c->chunk);
+    free(c->raw);
     free(c);
 }
 
@@ -39,6 +53,7 @@ static VALUE Chunk_new(Mix_Chunk* chunk)
     Chunk* c;
     VALUE obj = TypedData_Make_Struct(cChunk, Chunk, &Chunk_data_type, c);
     c->chunk = chunk;
+    c->raw = NULL;
     return obj;
 }
 
@@ -48,6 +63,7 @@ static void Music_free(Music* m)
 {
     if (rubysdl2_is_active() && m->music)
         Mix_FreeMusic(m->music);
+    free(m->data);
     free(m);
 }
 
@@ -58,11 +74,167 @@ static VALUE Music_new(Mix_Music* music)
     Music* c;
     VALUE obj = TypedData_Make_Struct(cMusic, Music, &Music_data_type, c);
     c->music = music;
+    c->data = NULL;
     return obj;
 }
 
 DEFINE_WRAPPER(Mix_Music, Music, music, cMusic, "SDL2::Mixer::Music");
 
+/*
+ * SDL_RWops reading a Ruby IO object.
+ *
+ * The callbacks call methods of the IO, so they must be used only on
+ * a Ruby thread holding the GVL. Exceptions raised by the IO are caught
+ * and reported as I/O errors to SDL; the loader re-raises them afterwards.
+ */
+typedef struct IORW {
+    VALUE io;
+    int state;
+} IORW;
+
+struct io_call {
+    VALUE io;
+    ID mid;
+    int argc;
+    VALUE argv[2];
+    /* if nonzero, the result is converted to offset in rb_protect */
+    int want_offset;
+    Sint64 offset;
+};
+
+static ID id_read, id_seek, id_pos, id_size;
+
+static VALUE io_call_body(VALUE arg)
+{
+    struct io_call* call = (struct io_call*)arg;
+    VALUE result = rb_funcallv(call->io, call->mid, call->argc, call->argv);
+    if (call->want_offset)
+        call->offset = NUM2LL(result);
+    return result;
+}
+
+/* Call a method of the IO with rb_protect; return Qundef if an exception is raised */
+static VALUE io_call_protect(IORW* iorw, struct io_call* call)
+{
+    VALUE result;
+    int state = 0;
+
+    if (iorw->state)
+        return Qundef;
+    call->io = iorw->io;
+    result = rb_protect(io_call_body, (VALUE)call, &state);
+    if (state) {
+        iorw->state = state;
+        SDL_SetError("exception raised in IO");
+        return Qundef;
+    }
+    return result;
+}
+
+/* Call a method of the IO; return Qundef if an exception is raised */
+static VALUE io_call(IORW* iorw, ID mid, int argc, VALUE arg0, VALUE arg1)
+{
+    struct io_call call;
+
+    call.mid = mid;
+    call.argc = argc;
+    call.argv[0] = arg0;
+    call.argv[1] = arg1;
+    call.want_offset = 0;
+    return io_call_protect(iorw, &call);
+}
+
+/* Call a method of the IO returning an Integer offset; return -1 on error */
+static Sint64 io_call_offset(IORW* iorw, ID mid)
+{
+    struct io_call call;
+
+    call.mid = mid;
+    call.argc = 0;
+    call.want_offset = 1;
+    call.offset = -1;
+    if (io_call_protect(iorw, &call) == Qundef)
+        return -1;
+    return call.offset;
+}
+
+static Sint64 SDLCALL io_rw_size(SDL_RWops* rw)
+{
+    return io_call_offset(rw->hidden.unknown.data1, id_size);
+}
+
+static Sint64 SDLCALL io_rw_seek(SDL_RWops* rw, Sint64 offset, int whence)
+{
+    IORW* iorw = rw->hidden.unknown.data1;
+    /* RW_SEEK_{SET,CUR,END} have the same values as IO::SEEK_{SET,CUR,END} */
+    if (io_call(iorw, id_seek, 2, LL2NUM(offset), INT2FIX(whence)) == Qundef)
+        return -1;
+    return io_call_offset(iorw, id_pos);
+}
+
+static size_t SDLCALL io_rw_read(SDL_RWops* rw, void* ptr, size_t size, size_t maxnum)
+{
+    IORW* iorw = rw->hidden.unknown.data1;
+    VALUE str;
+    long len;
+
+    if (size == 0 || maxnum == 0)
+        return 0;
+    str = io_call(iorw, id_read, 1, SIZET2NUM(size * maxnum), Qnil);
+    if (str == Qundef || str == Qnil || !RB_TYPE_P(str, T_STRING))
+        return 0;
+    len = RSTRING_LEN(str);
+    if ((size_t)len > size * maxnum)
+        len = size * maxnum;
+    memcpy(ptr, RSTRING_PTR(str), len);
+    return len / size;
+}
+
+static size_t SDLCALL io_rw_write(SDL_RWops* rw, const void* ptr, size_t size, size_t num)
+{
+    SDL_SetError("IO is opened for reading");
+    return 0;
+}
+
+static int SDLCALL io_rw_close(SDL_RWops* rw)
+{
+    SDL_FreeRW(rw);
+    return 0;
+}
+
+/* Create an SDL_RWops reading the IO; iorw must live until the RWops is closed */
+static SDL_RWops* io_rw_new(IORW* iorw, VALUE io)
+{
+    SDL_RWops* rw = SDL_AllocRW();
+    if (!rw)
+        SDL_ERROR();
+    iorw->io = io;
+    iorw->state = 0;
+    rw->size = io_rw_size;
+    rw->seek = io_rw_seek;
+    rw->read = io_rw_read;
+    rw->write = io_rw_write;
+    rw->close = io_rw_close;
+    rw->type = SDL_RWOPS_UNKNOWN;
+    rw->hidden.unknown.data1 = iorw;
+    return rw;
+}
+
+/* Create an SDL_RWops reading the bytes of a String or an IO::Buffer */
+static SDL_RWops* bytes_rw_new(VALUE data)
+{
+    size_t len;
+    const void* ptr = bytes_for_reading(data, &len);
+    SDL_RWops* rw;
+
+    if (len > INT_MAX)
+        rb_raise(rb_eArgError, "too large data");
+    rw = SDL_RWFromConstMem(ptr, (int)len);
+    if (!rw)
+        SDL_ERROR();
+    return rw;
+}
+
 /*
  * Document-module: SDL2::Mixer
  *
@@ -160,7 +332,9 @@ static void check_channel(VALUE ch, int allow_minus_1)
  *     many kinds of game because 44100 requires too much CPU power on older computers.
  *   @param format [Integer] output sample format
  *   @param channels 1 is for mono, and 2 is for stereo.
- *   @param chunksize bytes used per output sample
+ *   @param chunksize the number of sample frames in the output buffer.
+ *     Smaller values reduce the latency and increase the CPU cost;
+ *     256 or 512 is low latency, and 4096 or more is robust.
  *
  *   @return [nil]
  *
@@ -928,6 +1102,512 @@ static VALUE Chunk_s_load(VALUE self, VALUE fname)
     return c;
 }
 
+/*
+ * @overload from_string(data)
+ *   Load a sample from the content of a sound file in memory.
+ *
+ *   This is the same as {.load}, but reads the file from a String
+ *   (or an IO::Buffer), e.g. an entry of an archive, without writing a temporary file.
+ *   The sample is decoded and converted when loaded, so the data is not
+ *   referred after this method returns.
+ *
+ *   @note {SDL2::Mixer.open} must be called before calling this method.
+ *
+ *   @param data [String,IO::Buffer] the content of a WAVE, AIFF, RIFF, OGG, or VOC file
+ *   @return [SDL2::Mixer::Chunk]
+ *
+ *   @raise [SDL2::Error] raised when failing to load
+ *   @see .from_io
+ */
+static VALUE Chunk_s_from_string(VALUE self, VALUE data)
+{
+    Mix_Chunk* chunk = Mix_LoadWAV_RW(bytes_rw_new(data), 1);
+    VALUE c;
+    RB_GC_GUARD(data);
+    if (!chunk)
+        MIX_ERROR();
+    c = Chunk_new(chunk);
+    rb_iv_set(c, "@filename", Qnil);
+    return c;
+}
+
+/*
+ * @overload from_io(io)
+ *   Load a sample from an IO.
+ *
+ *   The IO is read through a custom SDL_RWops calling its read, seek, pos and size
+ *   methods, so the IO must be seekable (File, StringIO, etc.).
+ *   The IO is not closed.
+ *
+ *   @note {SDL2::Mixer.open} must be called before calling this method.
+ *
+ *   @param io [IO] the IO positioned at the beginning of a sound file
+ *   @return [SDL2::Mixer::Chunk]
+ *
+ *   @raise [SDL2::Error] raised when failing to load
+ *   @see .from_string
+ */
+static VALUE Chunk_s_from_io(VALUE self, VALUE io)
+{
+    IORW iorw;
+    Mix_Chunk* chunk = Mix_LoadWAV_RW(io_rw_new(&iorw, io), 1);
+    VALUE c;
+
+    if (iorw.state) {
+        if (chunk)
+            Mix_FreeChunk(chunk);
+        rb_jump_tag(iorw.state);
+    }
+    if (!chunk)
+        MIX_ERROR();
+    c = Chunk_new(chunk);
+    rb_iv_set(c, "@filename", Qnil);
+    return c;
+}
+
+/*
+ * @overload from_raw(data)
+ *   Create a sample from raw PCM data.
+ *
+ *   The data is used by Mix_QuickLoad_RAW without decoding and conversion,
+ *   so it must be in the output format of the opened device
+ *   (see {SDL2::Mixer.query}): the sample format, the number of channels,
+ *   and the frequency. The data is copied once into a buffer owned by the chunk.
+ *
+ *   @note {SDL2::Mixer.open} must be called before calling this method.
+ *
+ *   @param data [String,IO::Buffer] interleaved samples
+ *   @return [SDL2::Mixer::Chunk]
+ *
+ *   @raise [SDL2::Error] raised when the audio device is not opened
+ *   @raise [ArgumentError] raised when the length is not a multiple of the frame size
+ */
+static VALUE Chunk_s_from_raw(VALUE self, VALUE data)
+{
+    int frequency, channels, frame_size;
+    Uint16 format;
+    size_t len;
+    const void* ptr = bytes_for_reading(data, &len);
+    Uint8* raw;
+    Mix_Chunk* chunk;
+    VALUE c;
+
+    if (!Mix_QuerySpec(&frequency, &format, &channels))
+        MIX_ERROR();
+    frame_size = SDL_AUDIO_BITSIZE(format) / 8 * channels;
+    if (len % frame_size != 0)
+        rb_raise(rb_eArgError, "data length (%ld) is not a multiple of the frame size (%d)",
+                 (long)len, frame_size);
+    if (len > UINT32_MAX)
+        rb_raise(rb_eArgError, "too large data");
+    raw = malloc(len ? len : 1);
+    if (!raw)
+        rb_raise(rb_eNoMemError, "Cannot allocate sample buffer");
+    memcpy(raw, ptr, len);
+    RB_GC_GUARD(data);
+
+    chunk = Mix_QuickLoad_RAW(raw, (Uint32)len);
+    if (!chunk) {
+        free(raw);
+        MIX_ERROR();
+    }
+    c = Chunk_new(chunk);
+    Get_Chunk(c)->raw = raw;
+    rb_iv_set(c, "@filename", Qnil);
+    return c;
+}
+
+/*
+ * Asynchronous loading of samples.
+ *
+ * Jobs are decoded by a pool of native worker threads, which never touch
+ * Ruby objects. A job is shared by the worker and the SDL2::Mixer::Chunk::Future
+ * object, and freed when both release it.
+ */
+typedef struct LoadJob {
+    char* path;
+    Mix_Chunk* chunk;
+    char* error;
+    int done;
+    int interrupted;
+    int refcount;
+    Uint32 event_type;
+    Sint32 id;
+    struct LoadJob* next;
+} LoadJob;
+
+/* The maximum number of worker threads */
+#define MAX_LOAD_WORKERS 8
+
+static SDL_mutex* load_mutex = NULL;
+static SDL_cond* load_queued = NULL;
+static SDL_cond* load_done = NULL;
+static LoadJob* load_queue_head = NULL;
+static LoadJob* load_queue_tail = NULL;
+static int num_load_workers = 0;
+static Sint32 last_load_job_id = 0;
+
+/*
+ * Jobs released by all owners while still holding a chunk, which are
+ * left for the main thread because workers never call Mix_FreeChunk.
+ */
+static LoadJob* load_orphans = NULL;
+
+/* Release a reference of the job; load_mutex must be locked */
+static void LoadJob_release(LoadJob* job)
+{
+    if (--job->refcount > 0)
+        return;
+    free(job->path);
+    free(job->error);
+    if (job->chunk) {
+        job->path = job->error = NULL;
+        job->next = load_orphans;
+        load_orphans = job;
+        return;
+    }
+    free(job);
+}
+
+/* Free the chunks of orphaned jobs; called on a Ruby thread */
+static void free_load_orphans(void)
+{
+    LoadJob* job;
+
+    if (!load_mutex)
+        return;
+    SDL_LockMutex(load_mutex);
+    job = load_orphans;
+    load_orphans = NULL;
+    SDL_UnlockMutex(load_mutex);
+    while (job) {
+        LoadJob* next = job->next;
+        if (rubysdl2_is_active())
+            Mix_FreeChunk(job->chunk);
+        free(job);
+        job = next;
+    }
+}
+
+static char* copy_cstr(const char* str)
+{
+    size_t len = strlen(str) + 1;
+    char* copy = malloc(len);
+    if (copy)
+        memcpy(copy, str, len);
+    return copy;
+}
+
+static int SDLCALL load_worker(void* unused)
+{
+    for (;;) {
+        LoadJob* job;
+        Mix_Chunk* chunk;
+        char* error = NULL;
+        Uint32 event_type;
+        Sint32 id;
+
+        SDL_LockMutex(load_mutex);
+        while (!load_queue_head)
+            SDL_CondWait(load_queued, load_mutex);
+        job = load_queue_head;
+        load_queue_head = job->next;
+        if (!load_queue_head)
+            load_queue_tail = NULL;
+        SDL_UnlockMutex(load_mutex);
+
+        chunk = Mix_LoadWAV(job->path);
+        if (!chunk)
+            error = copy_cstr(Mix_GetError());
+
+        SDL_LockMutex(load_mutex);
+        job->chunk = chunk;
+        job->error = error;
+        job->done = 1;
+        event_type = job->event_type;
+        id = job->id;
+        SDL_CondBroadcast(load_done);
+        LoadJob_release(job);
+        SDL_UnlockMutex(load_mutex);
+
+        if (event_type) {
+            SDL_Event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.type = event_type;
+            ev.user.code = id;
+            SDL_PushEvent(&ev);
+        }
+    }
+    return 0;
+}
+
+static void start_load_workers(void)
+{
+    int i, n;
+
+    if (num_load_workers > 0)
+        return;
+    if (!load_mutex) {
+        load_mutex = SDL_CreateMutex();
+        load_queued = SDL_CreateCond();
+        load_done = SDL_CreateCond();
+        if (!load_mutex || !load_queued || !load_done)
+            SDL_ERROR();
+    }
+    n = SDL_GetCPUCount();
+    if (n < 1)
+        n = 1;
+    if (n > MAX_LOAD_WORKERS)
+        n = MAX_LOAD_WORKERS;
+    for (i=0; i<n; ++i) {
+        SDL_Thread* thread = SDL_CreateThread(load_worker, "rubysdl2-mixer-loader", NULL);
+        if (!thread) {
+            if (num_load_workers == 0)
+                SDL_ERROR();
+            break;
+        }
+        SDL_DetachThread(thread);
+        ++num_load_workers;
+    }
+}
+
+/* Create and enqueue a job. The returned job has a reference for the caller */
+static LoadJob* enqueue_load_job(VALUE path, Uint32 event_type)
+{
+    LoadJob* job;
+    int frequency, channels;
+    Uint16 format;
+
+    if (!Mix_QuerySpec(&frequency, &format, &channels))
+        MIX_ERROR();
+    free_load_orphans();
+    start_load_workers();
+    job = malloc(sizeof(LoadJob));
+    if (!job)
+        rb_raise(rb_eNoMemError, "Cannot allocate loading job");
+    memset(job, 0, sizeof(LoadJob));
+    job->path = copy_cstr(StringValueCStr(path));
+    if (!job->path) {
+        free(job);
+        rb_raise(rb_eNoMemError, "Cannot allocate loading job");
+    }
+    job->refcount = 2; /* the caller and the worker */
+    job->event_type = event_type;
+
+    SDL_LockMutex(load_mutex);
+    job->id = ++last_load_job_id;
+    if (load_queue_tail)
+        load_queue_tail->next = job;
+    else
+        load_queue_head = job;
+    load_queue_tail = job;
+    SDL_CondSignal(load_queued);
+    SDL_UnlockMutex(load_mutex);
+    return job;
+}
+
+/* Wait until the job is done; called without the GVL */
+static void* wait_load_job(void* data)
+{
+    LoadJob* job = data;
+    SDL_LockMutex(load_mutex);
+    while (!job->done && !job->interrupted)
+        SDL_CondWait(load_done, load_mutex);
+    job->interrupted = 0;
+    SDL_UnlockMutex(load_mutex);
+    return NULL;
+}
+
+static void wait_load_job_unblock(void* data)
+{
+    LoadJob* job = data;
+    SDL_LockMutex(load_mutex);
+    job->interrupted = 1;
+    SDL_CondBroadcast(load_done);
+    SDL_UnlockMutex(load_mutex);
+}
+
+static int load_job_done(LoadJob* job)
+{
+    int done;
+    SDL_LockMutex(load_mutex);
+    done = job->done;
+    SDL_UnlockMutex(load_mutex);
+    return done;
+}
+
+/* Wait for the job (releasing the GVL) and raise an error if loading failed */
+static void finish_load_job(LoadJob* job)
+{
+    while (!load_job_done(job)) {
+        rb_thread_call_without_gvl(wait_load_job, job, wait_load_job_unblock, job);
+        rb_thread_check_ints();
+    }
+    if (job->error) {
+        SDL_SetError("%s", job->error);
+        SDL_ERROR();
+    }
+}
+
+/*
+ * Take the loaded chunk from the finished job. The GVL is held from here
+ * until the result is stored, so it cannot race with other threads.
+ */
+static Mix_Chunk* take_load_job_chunk(LoadJob* job)
+{
+    Mix_Chunk* chunk;
+    SDL_LockMutex(load_mutex);
+    chunk = job->chunk;
+    job->chunk = NULL;
+    SDL_UnlockMutex(load_mutex);
+    return chunk;
+}
+
+typedef struct ChunkFuture {
+    LoadJob* job;
+} ChunkFuture;
+
+static void ChunkFuture_free(ChunkFuture* f)
+{
+    if (f->job) {
+        Mix_Chunk* chunk = NULL;
+        SDL_LockMutex(load_mutex);
+        if (f->job->done) {
+            chunk = f->job->chunk;
+            f->job->chunk = NULL;
+        }
+        LoadJob_release(f->job);
+        SDL_UnlockMutex(load_mutex);
+        if (chunk && rubysdl2_is_active())
+            Mix_FreeChunk(chunk);
+    }
+    free(f);
+    free_load_orphans();
+}
+
+DEFINE_DATA_TYPE(ChunkFuture, ChunkFuture_free);
+DEFINE_GETTER(static, ChunkFuture, cChunkFuture, "SDL2::Mixer::Chunk::Future");
+
+/*
+ * Document-class: SDL2::Mixer::Chunk::Future
+ *
+ * This class represents a sample being loaded by {SDL2::Mixer::Chunk.load_async}.
+ *
+ * @!attribute [r] path
+ *   @return [String] the path of the file
+ */
+
+/*
+ * @overload load_async(path, event_type=nil)
+ *   Start loading a sample from file on a background thread.
+ *
+ *   The file is decoded by a pool of native worker threads (one per CPU core,
+ *   up to 8) without the GVL, so other Ruby threads keep running.
+ *
+ *   If **event_type** is given, an {SDL2::Event::User} event of the type
+ *   is pushed when loading finishes (successfully or not); its
+ *   {SDL2::Event::User#code code} is {SDL2::Mixer::Chunk::Future#id}.
+ *   The event has no data, and its {SDL2::Event::User#latency latency} is nil.
+ *
+ *   @note {SDL2::Mixer.open} must be called before calling this method.
+ *
+ *   @param path [String] the file name
+ *   @param event_type [Integer,nil] an event type allocated by {SDL2::Event.register_types}
+ *   @return [SDL2::Mixer::Chunk::Future]
+ *
+ *   @example
+ *     futures = sounds.map{|path| SDL2::Mixer::Chunk.load_async(path) }
+ *     # ... show a loading screen ...
+ *     chunks = futures.map(&:value)
+ *
+ *   @see .load_all
+ */
+static VALUE Chunk_s_load_async(int argc, VALUE* argv, VALUE self)
+{
+    VALUE path, event_type, obj;
+    ChunkFuture* f;
+
+    rb_scan_args(argc, argv, "11", &path, &event_type);
+    path = rb_str_new_frozen(StringValue(path));
+    obj = TypedData_Make_Struct(cChunkFuture, ChunkFuture, &ChunkFuture_data_type, f);
+    f->job = enqueue_load_job(path, event_type == Qnil ? 0 : NUM2UINT(event_type));
+    rb_iv_set(obj, "@path", path);
+    return obj;
+}
+
+/*
+ * @overload load_all(paths)
+ *   Load samples from files in parallel.
+ *
+ *   Files are decoded by the worker threads of {.load_async}, and
+ *   this method waits for all of them without the GVL.
+ *
+ *   @note {SDL2::Mixer.open} must be called before calling this method.
+ *
+ *   @param paths [Array<String>] the file names
+ *   @return [Array<SDL2::Mixer::Chunk>] the loaded samples, in the same order as paths
+ *
+ *   @raise [SDL2::Error] raised when failing to load any of the files
+ */
+static VALUE Chunk_s_load_all(VALUE self, VALUE paths)
+{
+    VALUE futures, chunks;
+    long i;
+
+    Check_Type(paths, T_ARRAY);
+    futures = rb_ary_new2(RARRAY_LEN(paths));
+    for (i=0; i<RARRAY_LEN(paths); ++i) {
+        VALUE path = rb_ary_entry(paths, i);
+        rb_ary_push(futures, Chunk_s_load_async(1, &path, self));
+    }
+    chunks = rb_ary_new2(RARRAY_LEN(futures));
+    for (i=0; i<RARRAY_LEN(futures); ++i)
+        rb_ary_push(chunks, rb_funcall(rb_ary_entry(futures, i), rb_intern("value"), 0));
+    return chunks;
+}
+
+/* Return true if loading is finished (successfully or not). */
+static VALUE ChunkFuture_ready_p(VALUE self)
+{
+    return INT2BOOL(load_job_done(Get_ChunkFuture(self)->job));
+}
+
+/*
+ * Wait until loading is finished, and get the loaded sample.
+ *
+ * The GVL is released while waiting.
+ *
+ * @return [SDL2::Mixer::Chunk] the loaded sample (the same object for each call)
+ * @raise [SDL2::Error] raised when failing to load
+ */
+static VALUE ChunkFuture_value(VALUE self)
+{
+    LoadJob* job = Get_ChunkFuture(self)->job;
+    VALUE chunk = rb_iv_get(self, "chunk");
+    Mix_Chunk* loaded;
+
+    if (chunk != Qnil)
+        return chunk;
+    finish_load_job(job);
+    /* another thread may have taken the chunk while this thread was waiting */
+    chunk = rb_iv_get(self, "chunk");
+    if (chunk != Qnil)
+        return chunk;
+    loaded = take_load_job_chunk(job);
+    if (!loaded)
+        rb_raise(eSDL2Error, "the loaded chunk is already taken");
+    chunk = Chunk_new(loaded);
+    rb_iv_set(chunk, "@filename", rb_iv_get(self, "@path"));
+    rb_iv_set(self, "chunk", chunk);
+    return chunk;
+}
+
+/* @return [Integer] the ID of the job, passed as the code of the finish event */
+static VALUE ChunkFuture_id(VALUE self)
+{
+    return INT2NUM(Get_ChunkFuture(self)->job->id);
+}
+
 /*
  * Get the names of the sample decoders.
  *
@@ -956,6 +1636,8 @@ static VALUE Chunk_destroy(VALUE self)
     Chunk* c = Get_Chunk(self);
     if (c->chunk) Mix_FreeChunk(c->chunk);
     c->chunk = NULL;
+    free(c->raw);
+    c->raw = NULL;
     return Qnil;
 }
 
@@ -991,6 +1673,9 @@ static VALUE Chunk_inspect(VALUE self)
     VALUE filename = rb_iv_get(self, "@filename");
     if (RTEST(Chunk_destroy_p(self)))
         return rb_sprintf("<%s: destroyed>", rb_obj_classname(self));
+    if (NIL_P(filename))
+        return rb_sprintf("<%s: (memory) volume=%d>", rb_obj_classname(self),
+                          Mix_VolumeChunk(Get_Mix_Chunk(self), -1));
     
     return rb_sprintf("<%s: filename=\"%s\" volume=%d>",
                       rb_obj_classname(self),
@@ -999,81 +1684,1270 @@ static VALUE Chunk_inspect(VALUE self)
 }
 
 /*
- * Document-class: SDL2::Mixer::Music
- *
- * This class represents music, a kind of sound sources.
- *
- * Music is playable on {SDL2::Mixer::MusicChannel}, not on {SDL2::Mixer::Channels}.
- *
- * @!method destroy?
- *   Return true if the memory is deallocated by {#destroy}.
+ * Document-class: SDL2::Mixer::SoundBank
+ *
+ * This class is a cache of samples with a memory budget.
+ *
+ * Samples are keyed by the absolute path of the file ({#load}) or by
+ * a hash of the file content ({#load_string}), so that each sound is decoded once
+ * and a single {SDL2::Mixer::Chunk} object is shared by all callers.
+ *
+ * The bank tracks the size of the decoded samples. When the total size exceeds
+ * {#budget}, the least recently used samples (loaded or played via the bank)
+ * are evicted and destroyed, except for samples now playing on any channel.
+ * Since evicted chunks are destroyed, you should get chunks from the bank
+ * each time instead of keeping references to them.
+ *
+ * @example
+ *   bank = SDL2::Mixer::SoundBank.new(32 * 1024 * 1024)
+ *   bank.play(-1, "se/shot.wav", 0)
+ *
+ * @!attribute [r] bytes
+ *   @return [Integer] the total size of the decoded samples in the bank
+ * @!attribute [r] hits
+ *   @return [Integer] the number of lookups that found a cached sample
+ * @!attribute [r] misses
+ *   @return [Integer] the number of lookups that decoded a sample
+ * @!attribute [r] evictions
+ *   @return [Integer] the number of samples evicted to keep the budget
  */
+typedef struct SoundBank {
+    size_t budget; /* 0 for no limit */
+    size_t bytes;
+    size_t hits, misses, evictions;
+} SoundBank;
 
-/*
- * Get the names of music decoders.
- *
- * @return [Array<String>] the names of decorders (supported sound formats),
- *   such as: "OGG", "WAVE", "MP3"
- */
-static VALUE Music_s_decoders(VALUE self)
+static void SoundBank_free(SoundBank* b)
 {
-    int num_decoders = Mix_GetNumMusicDecoders();
-    int i;
-    VALUE decoders = rb_ary_new2(num_decoders);
-    for (i=0; i<num_decoders; ++i)
-        rb_ary_push(decoders, utf8str_new_cstr(Mix_GetMusicDecoder(i)));
-    return decoders;
+    free(b);
 }
 
-/*
- * @overload load(path)
- *   Load a music from file.
- *
- *   @param path [String] the file path
- *   @return [SDL2::Mixer::Music]
- *
- *   @raise [SDL2::Error] raised when failing to load.
- */
-static VALUE Music_s_load(VALUE self, VALUE fname)
+DEFINE_DATA_TYPE(SoundBank, SoundBank_free);
+DEFINE_GETTER(static, SoundBank, cSoundBank, "SDL2::Mixer::SoundBank");
+
+static VALUE SoundBank_s_allocate(VALUE klass)
 {
-    Mix_Music* music = Mix_LoadMUS(StringValueCStr(fname));
-    VALUE mus;
-    if (!music) MIX_ERROR();
-    mus = Music_new(music);
-    rb_iv_set(mus, "@filename", fname);
-    return mus;
+    SoundBank* b;
+    VALUE obj = TypedData_Make_Struct(klass, SoundBank, &SoundBank_data_type, b);
+    b->budget = b->bytes = 0;
+    b->hits = b->misses = b->evictions = 0;
+    return obj;
 }
 
 /*
- * Deallocate the music memory.
+ * @overload initialize(budget=nil)
+ *   Create a new empty sound bank.
  *
- * Normally, the memory is deallocated by ruby's GC, but 
- * you can surely deallocate the memory with this method at any time.
- * 
- * @return [nil]
+ *   @param budget [Integer,nil] the maximum total size of the decoded samples
+ *     in bytes, or nil for no limit
  */
-static VALUE Music_destroy(VALUE self)
+static VALUE SoundBank_initialize(int argc, VALUE* argv, VALUE self)
 {
-    Music* c = Get_Music(self);
-    if (c) Mix_FreeMusic(c->music);
-    c->music = NULL;
+    VALUE budget;
+    rb_scan_args(argc, argv, "01", &budget);
+    Get_SoundBank(self)->budget = NIL_P(budget) ? 0 : NUM2SIZET(budget);
+    /* key => [chunk, size], ordered from the least recently used */
+    rb_iv_set(self, "entries", rb_hash_new());
     return Qnil;
 }
 
-/* @return [String] inspection string */
-static VALUE Music_inspect(VALUE self)
+static VALUE SoundBank_entries(VALUE self)
 {
-    VALUE filename = rb_iv_get(self, "@filename");
-    if (RTEST(Music_destroy_p(self)))
-        return rb_sprintf("<%s: destroyed>", rb_obj_classname(self));
-    
-    return rb_sprintf("<%s: filename=\"%s\" type=%d>",
-                      rb_obj_classname(self), StringValueCStr(filename),
-                      Mix_GetMusicType(Get_Mix_Music(self)));
+    return rb_iv_get(self, "entries");
 }
 
-
-void rubysdl2_init_mixer(void)
+static size_t chunk_bytes(VALUE chunk)
+{
+    Chunk* c = Get_Chunk(chunk);
+    return c->chunk ? c->chunk->alen : 0;
+}
+
+/* Return true if chunk is now playing on any channel */
+static int chunk_is_playing(VALUE chunk)
+{
+    long i;
+    if (NIL_P(playing_chunks))
+        return 0;
+    for (i=0; i<RARRAY_LEN(playing_chunks); ++i)
+        if (rb_ary_entry(playing_chunks, i) == chunk && Mix_Playing(i))
+            return 1;
+    return 0;
+}
+
+/* Evict the least recently used samples until the bank fits the budget */
+static void SoundBank_shrink(VALUE self, VALUE keep)
+{
+    SoundBank* b = Get_SoundBank(self);
+    VALUE entries = SoundBank_entries(self);
+    VALUE keys;
+    long i;
+
+    if (b->budget == 0 || b->bytes <= b->budget)
+        return;
+    keys = rb_funcall(entries, rb_intern("keys"), 0);
+    for (i=0; i<RARRAY_LEN(keys) && b->bytes > b->budget; ++i) {
+        VALUE key = rb_ary_entry(keys, i);
+        VALUE entry = rb_hash_aref(entries, key);
+        VALUE chunk = rb_ary_entry(entry, 0);
+
+        if (rb_str_equal(key, keep) == Qtrue || chunk_is_playing(chunk))
+            continue;
+        rb_hash_delete(entries, key);
+        b->bytes -= NUM2SIZET(rb_ary_entry(entry, 1));
+        ++b->evictions;
+        Chunk_destroy(chunk);
+    }
+}
+
+/* Look up key and mark it as the most recently used; return nil if not found */
+static VALUE SoundBank_touch(VALUE self, VALUE key)
+{
+    VALUE entries = SoundBank_entries(self);
+    VALUE entry = rb_hash_delete(entries, key);
+
+    if (NIL_P(entry))
+        return Qnil;
+    if (RTEST(Chunk_destroy_p(rb_ary_entry(entry, 0)))) {
+        /* destroyed by the user */
+        Get_SoundBank(self)->bytes -= NUM2SIZET(rb_ary_entry(entry, 1));
+        return Qnil;
+    }
+    rb_hash_aset(entries, key, entry);
+    return rb_ary_entry(entry, 0);
+}
+
+static VALUE SoundBank_insert(VALUE self, VALUE key, VALUE chunk)
+{
+    SoundBank* b = Get_SoundBank(self);
+    size_t size = chunk_bytes(chunk);
+
+    rb_hash_aset(SoundBank_entries(self), key, rb_assoc_new(chunk, SIZET2NUM(size)));
+    b->bytes += size;
+    ++b->misses;
+    SoundBank_shrink(self, key);
+    return chunk;
+}
+
+/*
+ * @overload load(path)
+ *   Get the sample of the file, decoding it only if it is not in the bank.
+ *
+ *   @param path [String] the file name
+ *   @return [SDL2::Mixer::Chunk]
+ *
+ *   @raise [SDL2::Error] raised when failing to load
+ */
+static VALUE SoundBank_load(VALUE self, VALUE path)
+{
+    VALUE key = rb_str_new_frozen(rb_file_expand_path(path, Qnil));
+    VALUE chunk = SoundBank_touch(self, key);
+
+    if (!NIL_P(chunk)) {
+        ++Get_SoundBank(self)->hits;
+        return chunk;
+    }
+    return SoundBank_insert(self, key, Chunk_s_load(cChunk, key));
+}
+
+/*
+ * @overload load_string(data)
+ *   Get the sample of the sound file content, decoding it only if the same
+ *   content is not in the bank.
+ *
+ *   @param data [String,IO::Buffer] the content of a sound file
+ *   @return [SDL2::Mixer::Chunk]
+ *
+ *   @raise [SDL2::Error] raised when failing to load
+ *   @see SDL2::Mixer::Chunk.from_string
+ */
+static VALUE SoundBank_load_string(VALUE self, VALUE data)
+{
+    size_t len, i;
+    const Uint8* ptr = bytes_for_reading(data, &len);
+    Uint64 hash = 0xcbf29ce484222325ULL; /* FNV-1a */
+    char buf[64];
+    VALUE key, chunk;
+
+    for (i=0; i<len; ++i)
+        hash = (hash ^ ptr[i]) * 0x100000001b3ULL;
+    snprintf(buf, sizeof(buf), "content:%016llx:%lu",
+             (unsigned long long)hash, (unsigned long)len);
+    key = rb_obj_freeze(rb_str_new_cstr(buf));
+    chunk = SoundBank_touch(self, key);
+    if (!NIL_P(chunk)) {
+        ++Get_SoundBank(self)->hits;
+        return chunk;
+    }
+    return SoundBank_insert(self, key, Chunk_s_from_string(cChunk, data));
+}
+
+/*
+ * @overload play(channel, path, loops, ticks = -1)
+ *   Load a sample via {#load} and play it.
+ *
+ *   @param channel [Integer] the channel to play, or -1 for the first free unreserved
+ *     channel
+ *   @param path [String] the file name
+ *   @param loops [Integer] the number of loops, or -1 for infite loops.
+ *   @param ticks [Integer] milliseconds limit to play, at most.
+ *   @return [Integer] the channel that plays the sample.
+ *
+ *   @see SDL2::Mixer::Channels.play
+ */
+static VALUE SoundBank_play(int argc, VALUE* argv, VALUE self)
+{
+    VALUE channel, path, loops, ticks;
+    VALUE args[4];
+    rb_scan_args(argc, argv, "31", &channel, &path, &loops, &ticks);
+    args[0] = channel;
+    args[1] = SoundBank_load(self, path);
+    args[2] = loops;
+    args[3] = ticks;
+    return Channels_s_play(4, args, mChannels);
+}
+
+/* @return [Integer,nil] the budget in bytes, or nil for no limit */
+static VALUE SoundBank_budget(VALUE self)
+{
+    SoundBank* b = Get_SoundBank(self);
+    return b->budget ? SIZET2NUM(b->budget) : Qnil;
+}
+
+/*
+ * @overload budget=(bytes)
+ *   Set the budget, evicting samples if needed.
+ *
+ *   @param bytes [Integer,nil] the budget in bytes, or nil for no limit
+ */
+static VALUE SoundBank_set_budget(VALUE self, VALUE bytes)
+{
+    Get_SoundBank(self)->budget = NIL_P(bytes) ? 0 : NUM2SIZET(bytes);
+    SoundBank_shrink(self, Qnil);
+    return bytes;
+}
+
+static VALUE SoundBank_bytes(VALUE self)
+{
+    return SIZET2NUM(Get_SoundBank(self)->bytes);
+}
+
+static VALUE SoundBank_hits(VALUE self)
+{
+    return SIZET2NUM(Get_SoundBank(self)->hits);
+}
+
+static VALUE SoundBank_misses(VALUE self)
+{
+    return SIZET2NUM(Get_SoundBank(self)->misses);
+}
+
+static VALUE SoundBank_evictions(VALUE self)
+{
+    return SIZET2NUM(Get_SoundBank(self)->evictions);
+}
+
+/* @return [Integer] the number of samples in the bank */
+static VALUE SoundBank_size(VALUE self)
+{
+    return rb_funcall(SoundBank_entries(self), rb_intern("size"), 0);
+}
+
+/*
+ * @overload include?(path)
+ *   Return true if the sample of the file is in the bank.
+ *
+ *   @param path [String] the file name
+ */
+static VALUE SoundBank_include_p(VALUE self, VALUE path)
+{
+    VALUE entry = rb_hash_aref(SoundBank_entries(self), rb_file_expand_path(path, Qnil));
+    return INT2BOOL(!NIL_P(entry) && !RTEST(Chunk_destroy_p(rb_ary_entry(entry, 0))));
+}
+
+/*
+ * Remove all samples from the bank, and destroy the samples not playing now.
+ *
+ * @return [nil]
+ */
+static VALUE SoundBank_clear(VALUE self)
+{
+    VALUE entries = SoundBank_entries(self);
+    VALUE values = rb_funcall(entries, rb_intern("values"), 0);
+    long i;
+
+    for (i=0; i<RARRAY_LEN(values); ++i) {
+        VALUE chunk = rb_ary_entry(rb_ary_entry(values, i), 0);
+        if (!chunk_is_playing(chunk))
+            Chunk_destroy(chunk);
+    }
+    rb_hash_clear(entries);
+    Get_SoundBank(self)->bytes = 0;
+    return Qnil;
+}
+
+/*
+ * Document-class: SDL2::Mixer::Music
+ *
+ * This class represents music, a kind of sound sources.
+ *
+ * Music is playable on {SDL2::Mixer::MusicChannel}, not on {SDL2::Mixer::Channels}.
+ *
+ * @!method destroy?
+ *   Return true if the memory is deallocated by {#destroy}.
+ */
+
+/*
+ * Get the names of music decoders.
+ *
+ * @return [Array<String>] the names of decorders (supported sound formats),
+ *   such as: "OGG", "WAVE", "MP3"
+ */
+static VALUE Music_s_decoders(VALUE self)
+{
+    int num_decoders = Mix_GetNumMusicDecoders();
+    int i;
+    VALUE decoders = rb_ary_new2(num_decoders);
+    for (i=0; i<num_decoders; ++i)
+        rb_ary_push(decoders, utf8str_new_cstr(Mix_GetMusicDecoder(i)));
+    return decoders;
+}
+
+/*
+ * @overload load(path)
+ *   Load a music from file.
+ *
+ *   @param path [String] the file path
+ *   @return [SDL2::Mixer::Music]
+ *
+ *   @raise [SDL2::Error] raised when failing to load.
+ */
+static VALUE Music_s_load(VALUE self, VALUE fname)
+{
+    Mix_Music* music = Mix_LoadMUS(StringValueCStr(fname));
+    VALUE mus;
+    if (!music) MIX_ERROR();
+    mus = Music_new(music);
+    rb_iv_set(mus, "@filename", fname);
+    return mus;
+}
+
+/*
+ * @overload from_string(data)
+ *   Load a music from the content of a sound file in memory.
+ *
+ *   Music is decoded while playing, so the data is copied into
+ *   a buffer kept by the returned object.
+ *
+ *   @param data [String,IO::Buffer] the content of a music file
+ *   @return [SDL2::Mixer::Music]
+ *
+ *   @raise [SDL2::Error] raised when failing to load.
+ *   @see .from_io
+ */
+static VALUE Music_s_from_string(VALUE self, VALUE data)
+{
+    size_t len;
+    const void* ptr = bytes_for_reading(data, &len);
+    void* copy;
+    SDL_RWops* rw;
+    Mix_Music* music;
+    VALUE mus;
+
+    if (len > INT_MAX)
+        rb_raise(rb_eArgError, "too large data");
+    copy = malloc(len ? len : 1);
+    if (!copy)
+        rb_raise(rb_eNoMemError, "Cannot allocate music buffer");
+    memcpy(copy, ptr, len);
+    RB_GC_GUARD(data);
+
+    rw = SDL_RWFromConstMem(copy, (int)len);
+    if (!rw) {
+        free(copy);
+        SDL_ERROR();
+    }
+    music = Mix_LoadMUS_RW(rw, 1);
+    if (!music) {
+        free(copy);
+        MIX_ERROR();
+    }
+    mus = Music_new(music);
+    Get_Music(mus)->data = copy;
+    rb_iv_set(mus, "@filename", Qnil);
+    return mus;
+}
+
+/*
+ * @overload from_io(io)
+ *   Load a music from an IO.
+ *
+ *   Music is decoded on the audio thread while playing, where Ruby methods
+ *   cannot be called, so the whole IO is read into memory first
+ *   (same as {.from_string}(io.read)).
+ *
+ *   @param io [IO] the IO positioned at the beginning of a music file
+ *   @return [SDL2::Mixer::Music]
+ *
+ *   @raise [SDL2::Error] raised when failing to load.
+ */
+static VALUE Music_s_from_io(VALUE self, VALUE io)
+{
+    return Music_s_from_string(self, rb_funcall(io, id_read, 0));
+}
+
+/*
+ * Deallocate the music memory.
+ *
+ * Normally, the memory is deallocated by ruby's GC, but 
+ * you can surely deallocate the memory with this method at any time.
+ * 
+ * @return [nil]
+ */
+static VALUE Music_destroy(VALUE self)
+{
+    Music* c = Get_Music(self);
+    if (c) Mix_FreeMusic(c->music);
+    c->music = NULL;
+    free(c->data);
+    c->data = NULL;
+    return Qnil;
+}
+
+/* @return [String] inspection string */
+static VALUE Music_inspect(VALUE self)
+{
+    VALUE filename = rb_iv_get(self, "@filename");
+    if (RTEST(Music_destroy_p(self)))
+        return rb_sprintf("<%s: destroyed>", rb_obj_classname(self));
+    if (NIL_P(filename))
+        return rb_sprintf("<%s: (memory) type=%d>", rb_obj_classname(self),
+                          Mix_GetMusicType(Get_Mix_Music(self)));
+    
+    return rb_sprintf("<%s: filename=\"%s\" type=%d>",
+                      rb_obj_classname(self), StringValueCStr(filename),
+                      Mix_GetMusicType(Get_Mix_Music(self)));
+}
+
+
+/*
+ * Document-class: SDL2::Mixer::Effect
+ *
+ * This class represents a native DSP effect attached to a channel
+ * or to the final mixed stream with Mix_RegisterEffect.
+ *
+ * Effects are processed on the audio thread in C, never calling Ruby,
+ * so they do not wait for the GVL. Parameters are changed by {#update}
+ * at any time without locking: the audio thread picks up the new
+ * parameters at the beginning of the next block, and keeps the previous
+ * ones if an update is in progress.
+ *
+ * The device must be opened by {SDL2::Mixer.open} with
+ * AUDIO_S16SYS (the default) or AUDIO_F32SYS format before creating effects.
+ *
+ * Note that SDL_mixer removes the effects of a channel when the channel
+ * finishes playing, so attach effects to a channel after starting playing.
+ * Effects attached to {POST} are kept until {#detach} or {SDL2::Mixer.close}.
+ *
+ * An effect keeps filter states, so attach an effect to one channel at a time;
+ * create an effect object for each channel.
+ *
+ * @example
+ *   ch = SDL2::Mixer::Channels.play(-1, chunk, 0)
+ *   lowpass = SDL2::Mixer::Effect.lowpass(800)
+ *   lowpass.attach(ch)
+ *   lowpass.update(cutoff: 2000)
+ *
+ *   # ducking the whole mix
+ *   duck = SDL2::Mixer::Effect.gain(1.0, ramp: 0.2)
+ *   duck.attach(SDL2::Mixer::Effect::POST)
+ *   duck.update(gain: 0.3)
+ *
+ * @!attribute [r] kind
+ *   @return [Symbol] the kind of the effect, such as :lowpass
+ */
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#ifndef M_SQRT1_2
+#define M_SQRT1_2 0.70710678118654752440
+#endif
+
+/* Blocks of S16 samples are converted to float on the stack */
+#define EFFECT_BLOCK_FRAMES 256
+#define MAX_EFFECT_CHANNELS 8
+#define REVERB_COMBS 4
+#define REVERB_ALLPASSES 2
+/* The maximum number of effects attached at the same time */
+#define MAX_ATTACHED_EFFECTS 32
+
+enum {
+    EFFECT_GAIN, EFFECT_LOWPASS, EFFECT_HIGHPASS, EFFECT_COMPRESSOR, EFFECT_REVERB
+};
+
+/* Parameters read by the audio thread, derived from the settings */
+typedef struct EffectParams {
+    int enabled;
+    float gain, gain_step;
+    float b0, b1, b2, a1, a2;
+    float threshold, slope, attack, release, makeup;
+    float feedback, damping, wet, dry;
+} EffectParams;
+
+/* User-facing settings, only touched with the GVL */
+typedef struct EffectSettings {
+    double gain, ramp;
+    double cutoff, q;
+    double threshold, ratio, attack, release, makeup;
+    double room_size, damping, wet, dry;
+} EffectSettings;
+
+typedef struct DelayLine {
+    float* buf;
+    int size;
+    int pos;
+    float store;
+} DelayLine;
+
+typedef struct EffectState {
+    int kind;
+    int frequency;
+    Uint16 format;
+    int channels;
+    /* one reference from the Ruby object, and one while attached */
+    SDL_atomic_t refcount;
+    /* the slot of effect_trampolines and the channel while attached */
+    int slot;
+    int channel;
+
+    /* published parameters; seq is odd while being written */
+    SDL_atomic_t seq;
+    EffectParams shared;
+
+    /* the state of the audio thread */
+    int local_seq;
+    EffectParams local;
+    float cur_gain;
+    float z1[MAX_EFFECT_CHANNELS], z2[MAX_EFFECT_CHANNELS];
+    float env;
+    DelayLine combs[MAX_EFFECT_CHANNELS][REVERB_COMBS];
+    DelayLine allpasses[MAX_EFFECT_CHANNELS][REVERB_ALLPASSES];
+    float* delay_buf;
+
+    EffectSettings settings;
+} EffectState;
+
+typedef struct Effect {
+    EffectState* state;
+} Effect;
+
+static void EffectState_release(EffectState* s)
+{
+    if (SDL_AtomicAdd(&s->refcount, -1) != 1)
+        return;
+    free(s->delay_buf);
+    free(s);
+}
+
+static void Effect_free(Effect* e)
+{
+    if (e->state)
+        EffectState_release(e->state);
+    free(e);
+}
+
+DEFINE_DATA_TYPE(Effect, Effect_free);
+DEFINE_GETTER(static, Effect, cEffect, "SDL2::Mixer::Effect");
+
+/* Called by the audio thread; never blocks */
+#if !SDL_VERSION_ATLEAST(2,0,6)
+/* SDL_AtomicAdd is a full memory barrier */
+static SDL_atomic_t effect_barrier;
+#define SDL_MemoryBarrierAcquire() SDL_AtomicAdd(&effect_barrier, 0)
+#define SDL_MemoryBarrierRelease() SDL_AtomicAdd(&effect_barrier, 0)
+#endif
+
+/*
+ * The barriers keep the plain copy of the parameters between the two
+ * reads (or writes) of seq on weakly ordered CPUs.
+ */
+static void effect_sync_params(EffectState* s)
+{
+    int seq = SDL_AtomicGet(&s->seq);
+    EffectParams params;
+
+    if ((seq & 1) || seq == s->local_seq)
+        return;
+    SDL_MemoryBarrierAcquire();
+    params = s->shared;
+    SDL_MemoryBarrierAcquire();
+    if (SDL_AtomicGet(&s->seq) != seq)
+        return; /* updated while copying; retry at the next block */
+    s->local = params;
+    s->local_seq = seq;
+}
+
+static void effect_publish(EffectState* s, const EffectParams* params)
+{
+    SDL_AtomicAdd(&s->seq, 1);
+    SDL_MemoryBarrierRelease();
+    s->shared = *params;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicAdd(&s->seq, 1);
+}
+
+static void effect_gain(EffectState* s, float* buf, int frames)
+{
+    const EffectParams* p = &s->local;
+    int channels = s->channels;
+    int i, c;
+
+    if (s->cur_gain == p->gain) {
+        /* the common case; a flat loop the compiler vectorizes */
+        float g = p->gain;
+        int n = frames * channels;
+        for (i=0; i<n; ++i)
+            buf[i] *= g;
+        return;
+    }
+    for (i=0; i<frames; ++i) {
+        float g = s->cur_gain;
+        if (g < p->gain)
+            g = (g + p->gain_step < p->gain) ? g + p->gain_step : p->gain;
+        else
+            g = (g - p->gain_step > p->gain) ? g - p->gain_step : p->gain;
+        s->cur_gain = g;
+        for (c=0; c<channels; ++c)
+            buf[i*channels + c] *= g;
+    }
+}
+
+/* Transposed direct form II */
+static void effect_biquad(EffectState* s, float* buf, int frames)
+{
+    const EffectParams* p = &s->local;
+    int channels = s->channels;
+    int i, c;
+
+    for (c=0; c<channels; ++c) {
+        float z1 = s->z1[c], z2 = s->z2[c];
+        for (i=0; i<frames; ++i) {
+            float x = buf[i*channels + c];
+            float y = p->b0*x + z1;
+            z1 = p->b1*x - p->a1*y + z2;
+            z2 = p->b2*x - p->a2*y;
+            buf[i*channels + c] = y;
+        }
+        s->z1[c] = z1;
+        s->z2[c] = z2;
+    }
+}
+
+/* A feed-forward peak compressor, linked across channels */
+static void effect_compressor(EffectState* s, float* buf, int frames)
+{
+    const EffectParams* p = &s->local;
+    int channels = s->channels;
+    int i, c;
+
+    for (i=0; i<frames; ++i) {
+        float* frame = buf + i*channels;
+        float peak = 0.0f, level, reduction, g;
+
+        for (c=0; c<channels; ++c) {
+            float a = fabsf(frame[c]);
+            if (a > peak)
+                peak = a;
+        }
+        level = 20.0f * log10f(peak + 1e-9f);
+        reduction = (level > p->threshold) ? (level - p->threshold) * p->slope : 0.0f;
+        if (reduction > s->env)
+            s->env = p->attack * s->env + (1.0f - p->attack) * reduction;
+        else
+            s->env = p->release * s->env + (1.0f - p->release) * reduction;
+        g = powf(10.0f, -s->env / 20.0f) * p->makeup;
+        for (c=0; c<channels; ++c)
+            frame[c] *= g;
+    }
+}
+
+/* Schroeder reverb: parallel damped comb filters followed by allpass filters */
+static void effect_reverb(EffectState* s, float* buf, int frames)
+{
+    const EffectParams* p = &s->local;
+    int channels = s->channels;
+    int i, c, k;
+
+    for (c=0; c<channels; ++c) {
+        for (i=0; i<frames; ++i) {
+            float x = buf[i*channels + c];
+            float in = x * 0.015f;
+            float out = 0.0f;
+
+            for (k=0; k<REVERB_COMBS; ++k) {
+                DelayLine* d = &s->combs[c][k];
+                float y = d->buf[d->pos];
+                d->store = y * (1.0f - p->damping) + d->store * p->damping;
+                d->buf[d->pos] = in + d->store * p->feedback;
+                if (++d->pos >= d->size)
+                    d->pos = 0;
+                out += y;
+            }
+            for (k=0; k<REVERB_ALLPASSES; ++k) {
+                DelayLine* d = &s->allpasses[c][k];
+                float y = d->buf[d->pos];
+                d->buf[d->pos] = out + y * 0.5f;
+                if (++d->pos >= d->size)
+                    d->pos = 0;
+                out = y - out;
+            }
+            buf[i*channels + c] = x * p->dry + out * p->wet;
+        }
+    }
+}
+
+static void effect_process(EffectState* s, float* buf, int frames)
+{
+    switch (s->kind) {
+    case EFFECT_GAIN: effect_gain(s, buf, frames); break;
+    case EFFECT_LOWPASS:
+    case EFFECT_HIGHPASS: effect_biquad(s, buf, frames); break;
+    case EFFECT_COMPRESSOR: effect_compressor(s, buf, frames); break;
+    case EFFECT_REVERB: effect_reverb(s, buf, frames); break;
+    }
+}
+
+static void effect_run(int slot, void* stream, int len, void* udata)
+{
+    EffectState* s = udata;
+
+    if (s->slot != slot)
+        return;
+    effect_sync_params(s);
+    if (!s->local.enabled)
+        return;
+    if (s->format == AUDIO_F32SYS) {
+        effect_process(s, stream, len / (int)(sizeof(float) * s->channels));
+    } else {
+        Sint16* samples = stream;
+        int frames = len / (int)(sizeof(Sint16) * s->channels);
+        float buf[EFFECT_BLOCK_FRAMES * MAX_EFFECT_CHANNELS];
+
+        while (frames > 0) {
+            int n = frames < EFFECT_BLOCK_FRAMES ? frames : EFFECT_BLOCK_FRAMES;
+            int count = n * s->channels;
+            int i;
+
+            for (i=0; i<count; ++i)
+                buf[i] = samples[i] * (1.0f / 32768.0f);
+            effect_process(s, buf, n);
+            for (i=0; i<count; ++i) {
+                float v = buf[i] * 32768.0f;
+                samples[i] = (v > 32767.0f) ? 32767 : (v < -32768.0f) ? -32768 : (Sint16)v;
+            }
+            samples += count;
+            frames -= n;
+        }
+    }
+}
+
+/*
+ * Mix_UnregisterEffect identifies an effect by its callback, not by its
+ * argument, so each attached effect uses its own callback from this table.
+ */
+#define EFFECT_TRAMPOLINE(n)                                            \
+    static void SDLCALL effect_run_##n(int chan, void* stream, int len, void* udata) \
+    {                                                                   \
+        effect_run(n, stream, len, udata);                              \
+    }
+EFFECT_TRAMPOLINE(0)
+EFFECT_TRAMPOLINE(1)
+EFFECT_TRAMPOLINE(2)
+EFFECT_TRAMPOLINE(3)
+EFFECT_TRAMPOLINE(4)
+EFFECT_TRAMPOLINE(5)
+EFFECT_TRAMPOLINE(6)
+EFFECT_TRAMPOLINE(7)
+EFFECT_TRAMPOLINE(8)
+EFFECT_TRAMPOLINE(9)
+EFFECT_TRAMPOLINE(10)
+EFFECT_TRAMPOLINE(11)
+EFFECT_TRAMPOLINE(12)
+EFFECT_TRAMPOLINE(13)
+EFFECT_TRAMPOLINE(14)
+EFFECT_TRAMPOLINE(15)
+EFFECT_TRAMPOLINE(16)
+EFFECT_TRAMPOLINE(17)
+EFFECT_TRAMPOLINE(18)
+EFFECT_TRAMPOLINE(19)
+EFFECT_TRAMPOLINE(20)
+EFFECT_TRAMPOLINE(21)
+EFFECT_TRAMPOLINE(22)
+EFFECT_TRAMPOLINE(23)
+EFFECT_TRAMPOLINE(24)
+EFFECT_TRAMPOLINE(25)
+EFFECT_TRAMPOLINE(26)
+EFFECT_TRAMPOLINE(27)
+EFFECT_TRAMPOLINE(28)
+EFFECT_TRAMPOLINE(29)
+EFFECT_TRAMPOLINE(30)
+EFFECT_TRAMPOLINE(31)
+
+static const Mix_EffectFunc_t effect_trampolines[MAX_ATTACHED_EFFECTS] = {
+    effect_run_0, effect_run_1, effect_run_2, effect_run_3,
+    effect_run_4, effect_run_5, effect_run_6, effect_run_7,
+    effect_run_8, effect_run_9, effect_run_10, effect_run_11,
+    effect_run_12, effect_run_13, effect_run_14, effect_run_15,
+    effect_run_16, effect_run_17, effect_run_18, effect_run_19,
+    effect_run_20, effect_run_21, effect_run_22, effect_run_23,
+    effect_run_24, effect_run_25, effect_run_26, effect_run_27,
+    effect_run_28, effect_run_29, effect_run_30, effect_run_31
+};
+static SDL_atomic_t effect_slot_used[MAX_ATTACHED_EFFECTS];
+
+static void SDLCALL effect_done(int chan, void* udata)
+{
+    EffectState* s = udata;
+    SDL_AtomicSet(&effect_slot_used[s->slot], 0);
+    EffectState_release(s);
+}
+
+/* Compute the parameters of the audio thread from the settings */
+static void effect_compute(EffectState* s, EffectParams* p)
+{
+    const EffectSettings* st = &s->settings;
+    double fs = s->frequency;
+
+    p->gain = (float)st->gain;
+    p->gain_step = (st->ramp > 0) ? (float)(1.0 / (st->ramp * fs)) : 2.0f;
+
+    if (s->kind == EFFECT_LOWPASS || s->kind == EFFECT_HIGHPASS) {
+        /* RBJ Audio EQ Cookbook */
+        double cutoff = st->cutoff < fs * 0.49 ? st->cutoff : fs * 0.49;
+        double w0 = 2 * M_PI * cutoff / fs;
+        double alpha = sin(w0) / (2 * st->q);
+        double cosw0 = cos(w0);
+        double a0 = 1 + alpha;
+
+        if (s->kind == EFFECT_LOWPASS) {
+            p->b0 = (float)((1 - cosw0) / 2 / a0);
+            p->b1 = (float)((1 - cosw0) / a0);
+        } else {
+            p->b0 = (float)((1 + cosw0) / 2 / a0);
+            p->b1 = (float)(-(1 + cosw0) / a0);
+        }
+        p->b2 = p->b0;
+        p->a1 = (float)(-2 * cosw0 / a0);
+        p->a2 = (float)((1 - alpha) / a0);
+    }
+
+    p->threshold = (float)st->threshold;
+    p->slope = (float)(1.0 - 1.0 / st->ratio);
+    p->attack = (float)exp(-1.0 / (st->attack * fs + 1e-9));
+    p->release = (float)exp(-1.0 / (st->release * fs + 1e-9));
+    p->makeup = (float)pow(10.0, st->makeup / 20.0);
+
+    p->feedback = (float)(st->room_size * 0.28 + 0.7);
+    p->damping = (float)(st->damping * 0.4);
+    p->wet = (float)(st->wet * 3.0);
+    p->dry = (float)st->dry;
+}
+
+static void effect_check_settings(const EffectSettings* st)
+{
+    if (st->gain < 0 || st->ramp < 0)
+        rb_raise(rb_eArgError, "gain and ramp must be non-negative");
+    if (st->cutoff <= 0 || st->q <= 0)
+        rb_raise(rb_eArgError, "cutoff and q must be positive");
+    if (st->ratio < 1)
+        rb_raise(rb_eArgError, "ratio must be 1 or more");
+    if (st->attack < 0 || st->release < 0)
+        rb_raise(rb_eArgError, "attack and release must be non-negative");
+    if (st->room_size < 0 || st->room_size > 1 || st->damping < 0 || st->damping > 1)
+        rb_raise(rb_eArgError, "room_size and damping must be from 0 to 1");
+}
+
+static VALUE sym_gain, sym_ramp, sym_cutoff, sym_q, sym_threshold, sym_ratio,
+    sym_attack, sym_release, sym_makeup, sym_room_size, sym_damping, sym_wet, sym_dry;
+
+static int effect_set_setting(VALUE key, VALUE val, VALUE data)
+{
+    EffectSettings* st = (EffectSettings*)data;
+    double v = NUM2DBL(val);
+
+    if (key == sym_gain) st->gain = v;
+    else if (key == sym_ramp) st->ramp = v;
+    else if (key == sym_cutoff) st->cutoff = v;
+    else if (key == sym_q) st->q = v;
+    else if (key == sym_threshold) st->threshold = v;
+    else if (key == sym_ratio) st->ratio = v;
+    else if (key == sym_attack) st->attack = v;
+    else if (key == sym_release) st->release = v;
+    else if (key == sym_makeup) st->makeup = v;
+    else if (key == sym_room_size) st->room_size = v;
+    else if (key == sym_damping) st->damping = v;
+    else if (key == sym_wet) st->wet = v;
+    else if (key == sym_dry) st->dry = v;
+    else rb_raise(rb_eArgError, "unknown effect parameter: %"PRIsVALUE, rb_inspect(key));
+    return ST_CONTINUE;
+}
+
+/* Apply the options of a Hash (or nil) to settings */
+static void effect_apply_options(EffectSettings* st, VALUE opts)
+{
+    if (!NIL_P(opts)) {
+        Check_Type(opts, T_HASH);
+        rb_hash_foreach(opts, effect_set_setting, (VALUE)st);
+    }
+    effect_check_settings(st);
+}
+
+static const int reverb_comb_sizes[REVERB_COMBS] = { 1116, 1188, 1277, 1356 };
+static const int reverb_allpass_sizes[REVERB_ALLPASSES] = { 556, 441 };
+
+/* Allocate the delay lines of reverb, scaled to the frequency */
+static void effect_alloc_delay_lines(EffectState* s)
+{
+    double scale = s->frequency / 44100.0;
+    int total = 0, c, k;
+    float* p;
+
+    for (c=0; c<s->channels; ++c) {
+        /* a slightly different size for each channel gives stereo spread */
+        for (k=0; k<REVERB_COMBS; ++k)
+            total += s->combs[c][k].size = (int)((reverb_comb_sizes[k] + 23*c) * scale) + 1;
+        for (k=0; k<REVERB_ALLPASSES; ++k)
+            total += s->allpasses[c][k].size = (int)((reverb_allpass_sizes[k] + 23*c) * scale) + 1;
+    }
+    s->delay_buf = p = calloc(total, sizeof(float));
+    if (!p)
+        rb_raise(rb_eNoMemError, "Cannot allocate reverb buffer");
+    for (c=0; c<s->channels; ++c) {
+        for (k=0; k<REVERB_COMBS; ++k) {
+            s->combs[c][k].buf = p;
+            p += s->combs[c][k].size;
+        }
+        for (k=0; k<REVERB_ALLPASSES; ++k) {
+            s->allpasses[c][k].buf = p;
+            p += s->allpasses[c][k].size;
+        }
+    }
+}
+
+/* Clear the filter states; the effect must not be attached */
+static void effect_reset(EffectState* s)
+{
+    int c, k;
+
+    effect_sync_params(s);
+    s->cur_gain = s->local.gain;
+    memset(s->z1, 0, sizeof(s->z1));
+    memset(s->z2, 0, sizeof(s->z2));
+    s->env = 0.0f;
+    for (c=0; c<s->channels; ++c) {
+        for (k=0; k<REVERB_COMBS; ++k) {
+            DelayLine* d = &s->combs[c][k];
+            if (d->buf)
+                memset(d->buf, 0, sizeof(float) * d->size);
+            d->pos = 0;
+            d->store = 0.0f;
+        }
+        for (k=0; k<REVERB_ALLPASSES; ++k) {
+            DelayLine* d = &s->allpasses[c][k];
+            if (d->buf)
+                memset(d->buf, 0, sizeof(float) * d->size);
+            d->pos = 0;
+        }
+    }
+}
+
+static VALUE effect_create(int kind, const char* kind_name, EffectSettings* st, VALUE opts)
+{
+    int frequency, channels;
+    Uint16 format;
+    Effect* e;
+    EffectState* s;
+    EffectParams p;
+    VALUE obj;
+
+    if (!Mix_QuerySpec(&frequency, &format, &channels))
+        MIX_ERROR();
+    if (format != AUDIO_S16SYS && format != AUDIO_F32SYS)
+        rb_raise(eSDL2Error, "effects support AUDIO_S16SYS and AUDIO_F32SYS only");
+    if (channels > MAX_EFFECT_CHANNELS)
+        rb_raise(eSDL2Error, "effects support up to %d channels", MAX_EFFECT_CHANNELS);
+    effect_apply_options(st, opts);
+
+    obj = TypedData_Make_Struct(cEffect, Effect, &Effect_data_type, e);
+    s = e->state = calloc(1, sizeof(EffectState));
+    if (!s)
+        rb_raise(rb_eNoMemError, "Cannot allocate effect");
+    s->kind = kind;
+    s->frequency = frequency;
+    s->format = format;
+    s->channels = channels;
+    SDL_AtomicSet(&s->refcount, 1);
+    s->settings = *st;
+    if (kind == EFFECT_REVERB)
+        effect_alloc_delay_lines(s);
+
+    memset(&p, 0, sizeof(p));
+    p.enabled = 1;
+    effect_compute(s, &p);
+    effect_publish(s, &p);
+    effect_reset(s);
+    rb_iv_set(obj, "@kind", ID2SYM(rb_intern(kind_name)));
+    return obj;
+}
+
+static void effect_default_settings(EffectSettings* st)
+{
+    st->gain = 1.0;
+    st->ramp = 0.05;
+    st->cutoff = 1000.0;
+    st->q = M_SQRT1_2;
+    st->threshold = -18.0;
+    st->ratio = 4.0;
+    st->attack = 0.005;
+    st->release = 0.1;
+    st->makeup = 0.0;
+    st->room_size = 0.5;
+    st->damping = 0.5;
+    st->wet = 0.33;
+    st->dry = 1.0;
+}
+
+/*
+ * @overload gain(gain=1.0, opts={})
+ *   Create a gain effect with smooth ramps, useful for fading and ducking.
+ *
+ *   @param gain [Float] the gain (linear, 1.0 for no change)
+ *   @option opts [Float] :ramp (0.05) seconds to change the gain by 1.0;
+ *     0 for immediate change
+ *   @return [SDL2::Mixer::Effect]
+ */
+static VALUE Effect_s_gain(int argc, VALUE* argv, VALUE self)
+{
+    VALUE gain, opts;
+    EffectSettings st;
+
+    rb_scan_args(argc, argv, "02", &gain, &opts);
+    effect_default_settings(&st);
+    if (!NIL_P(gain))
+        st.gain = NUM2DBL(gain);
+    return effect_create(EFFECT_GAIN, "gain", &st, opts);
+}
+
+static VALUE effect_s_filter(int argc, VALUE* argv, int kind, const char* kind_name)
+{
+    VALUE cutoff, opts;
+    EffectSettings st;
+
+    rb_scan_args(argc, argv, "11", &cutoff, &opts);
+    effect_default_settings(&st);
+    st.cutoff = NUM2DBL(cutoff);
+    return effect_create(kind, kind_name, &st, opts);
+}
+
+/*
+ * @overload lowpass(cutoff, opts={})
+ *   Create a 2-pole low-pass filter (biquad).
+ *
+ *   @param cutoff [Float] the cutoff frequency in Hz
+ *   @option opts [Float] :q (0.7071) the quality factor (resonance)
+ *   @return [SDL2::Mixer::Effect]
+ */
+static VALUE Effect_s_lowpass(int argc, VALUE* argv, VALUE self)
+{
+    return effect_s_filter(argc, argv, EFFECT_LOWPASS, "lowpass");
+}
+
+/*
+ * @overload highpass(cutoff, opts={})
+ *   Create a 2-pole high-pass filter (biquad).
+ *
+ *   @param cutoff [Float] the cutoff frequency in Hz
+ *   @option opts [Float] :q (0.7071) the quality factor (resonance)
+ *   @return [SDL2::Mixer::Effect]
+ */
+static VALUE Effect_s_highpass(int argc, VALUE* argv, VALUE self)
+{
+    return effect_s_filter(argc, argv, EFFECT_HIGHPASS, "highpass");
+}
+
+/*
+ * @overload compressor(opts={})
+ *   Create a peak compressor.
+ *
+ *   @option opts [Float] :threshold (-18.0) the threshold in dBFS
+ *   @option opts [Float] :ratio (4.0) the compression ratio
+ *   @option opts [Float] :attack (0.005) the attack time in seconds
+ *   @option opts [Float] :release (0.1) the release time in seconds
+ *   @option opts [Float] :makeup (0.0) the makeup gain in dB
+ *   @return [SDL2::Mixer::Effect]
+ */
+static VALUE Effect_s_compressor(int argc, VALUE* argv, VALUE self)
+{
+    VALUE opts;
+    EffectSettings st;
+
+    rb_scan_args(argc, argv, "01", &opts);
+    effect_default_settings(&st);
+    return effect_create(EFFECT_COMPRESSOR, "compressor", &st, opts);
+}
+
+/*
+ * @overload reverb(opts={})
+ *   Create a simple reverb (Schroeder/Freeverb style).
+ *
+ *   @option opts [Float] :room_size (0.5) the size of the room, from 0 to 1
+ *   @option opts [Float] :damping (0.5) the damping of high frequencies, from 0 to 1
+ *   @option opts [Float] :wet (0.33) the level of the reverberation
+ *   @option opts [Float] :dry (1.0) the level of the original sound
+ *   @return [SDL2::Mixer::Effect]
+ */
+static VALUE Effect_s_reverb(int argc, VALUE* argv, VALUE self)
+{
+    VALUE opts;
+    EffectSettings st;
+
+    rb_scan_args(argc, argv, "01", &opts);
+    effect_default_settings(&st);
+    return effect_create(EFFECT_REVERB, "reverb", &st, opts);
+}
+
+/*
+ * @overload clear(channel)
+ *   Remove all effects from **channel**.
+ *
+ *   This also removes the effects of SDL_mixer itself, such as panning.
+ *
+ *   @param channel [Integer] the channel, or {POST}
+ *   @return [nil]
+ */
+static VALUE Effect_s_clear(VALUE self, VALUE channel)
+{
+    if (!Mix_UnregisterAllEffects(NUM2INT(channel)))
+        MIX_ERROR();
+    return Qnil;
+}
+
+/*
+ * @overload update(params)
+ *   Change the parameters of the effect.
+ *
+ *   This method never waits for the audio thread.
+ *
+ *   @param params [Hash{Symbol=>Numeric}] the parameters to change.
+ *     The keys are the options of the factory methods:
+ *     :gain, :ramp, :cutoff, :q, :threshold, :ratio, :attack, :release, :makeup,
+ *     :room_size, :damping, :wet, and :dry.
+ *   @return [self]
+ *
+ *   @raise [ArgumentError] raised when a parameter is unknown or out of range
+ */
+static VALUE Effect_update(VALUE self, VALUE params)
+{
+    EffectState* s = Get_Effect(self)->state;
+    EffectSettings st = s->settings;
+    EffectParams p = s->shared;
+
+    Check_Type(params, T_HASH);
+    effect_apply_options(&st, params);
+    s->settings = st;
+    effect_compute(s, &p);
+    effect_publish(s, &p);
+    return self;
+}
+
+/*
+ * @overload attach(channel)
+ *   Attach the effect to **channel**.
+ *
+ *   @param channel [Integer] the channel, or {POST} for the final mixed stream
+ *   @return [self]
+ *
+ *   @raise [SDL2::Error] raised when the effect is already attached,
+ *     too many effects are attached, or the device is reopened with another spec
+ *   @see #detach
+ */
+static VALUE Effect_attach(VALUE self, VALUE channel)
+{
+    EffectState* s = Get_Effect(self)->state;
+    int ch = NUM2INT(channel);
+    int frequency, channels, slot;
+    Uint16 format;
+
+    if (!Mix_QuerySpec(&frequency, &format, &channels))
+        MIX_ERROR();
+    if (frequency != s->frequency || format != s->format || channels != s->channels)
+        rb_raise(eSDL2Error, "the audio device is reopened with another spec");
+    if (SDL_AtomicGet(&s->refcount) > 1)
+        rb_raise(eSDL2Error, "the effect is already attached");
+    for (slot=0; slot<MAX_ATTACHED_EFFECTS; ++slot)
+        if (SDL_AtomicCAS(&effect_slot_used[slot], 0, 1))
+            break;
+    if (slot == MAX_ATTACHED_EFFECTS)
+        rb_raise(eSDL2Error, "too many attached effects (max %d)", MAX_ATTACHED_EFFECTS);
+    effect_reset(s);
+    s->slot = slot;
+    s->channel = ch;
+    SDL_AtomicAdd(&s->refcount, 1);
+    if (!Mix_RegisterEffect(ch, effect_trampolines[slot], effect_done, s)) {
+        SDL_AtomicSet(&effect_slot_used[slot], 0);
+        EffectState_release(s);
+        MIX_ERROR();
+    }
+    return self;
+}
+
+/*
+ * Detach the effect from the channel it is attached to.
+ *
+ * Other effects on the channel are kept. Nothing happens if the effect
+ * is not attached (for example, removed when the channel finished playing).
+ *
+ * @return [self]
+ */
+static VALUE Effect_detach(VALUE self)
+{
+    EffectState* s = Get_Effect(self)->state;
+
+    if (SDL_AtomicGet(&s->refcount) <= 1)
+        return self;
+    /* this fails if the channel finished playing just now; it is already removed then */
+    Mix_UnregisterEffect(s->channel, effect_trampolines[s->slot]);
+    return self;
+}
+
+/* Return true if the effect is attached to a channel. */
+static VALUE Effect_attached_p(VALUE self)
+{
+    return INT2BOOL(SDL_AtomicGet(&Get_Effect(self)->state->refcount) > 1);
+}
+
+/* Return true if the effect is enabled. */
+static VALUE Effect_enabled_p(VALUE self)
+{
+    return INT2BOOL(Get_Effect(self)->state->shared.enabled);
+}
+
+/*
+ * @overload enabled=(enabled)
+ *   Enable or bypass the effect without detaching it.
+ *
+ *   @param enabled [Boolean]
+ */
+static VALUE Effect_set_enabled(VALUE self, VALUE enabled)
+{
+    EffectState* s = Get_Effect(self)->state;
+    EffectParams p = s->shared;
+    p.enabled = RTEST(enabled);
+    effect_publish(s, &p);
+    return enabled;
+}
+
+void rubysdl2_init_mixer(void)
 {
     mMixer = rb_define_module_under(mSDL2, "Mixer");
 
@@ -1141,24 +3015,54 @@ void rubysdl2_init_mixer(void)
     cChunk = rb_define_class_under(mMixer, "Chunk", rb_cObject);
     rb_undef_alloc_func(cChunk);
     rb_define_singleton_method(cChunk, "load", Chunk_s_load, 1);
+    rb_define_singleton_method(cChunk, "from_string", Chunk_s_from_string, 1);
+    rb_define_singleton_method(cChunk, "from_io", Chunk_s_from_io, 1);
+    rb_define_singleton_method(cChunk, "from_raw", Chunk_s_from_raw, 1);
+    rb_define_singleton_method(cChunk, "load_async", Chunk_s_load_async, -1);
+    rb_define_singleton_method(cChunk, "load_all", Chunk_s_load_all, 1);
     rb_define_singleton_method(cChunk, "decoders", Chunk_s_decoders, 0);
     rb_define_method(cChunk, "destroy", Chunk_destroy, 0);
     rb_define_method(cChunk, "destroy?", Chunk_destroy_p, 0);
     rb_define_method(cChunk, "volume", Chunk_volume, 0);
     rb_define_method(cChunk, "volume=", Chunk_set_volume, 1);
     rb_define_method(cChunk, "inspect", Chunk_inspect, 0);
-    /* @return [String] The file name of the file from which the sound is loaded. */
+    /* @return [String] The file name of the file from which the sound is loaded (nil if loaded from memory). */
     rb_define_attr(cChunk, "filename", 1, 0);
 
+    cChunkFuture = rb_define_class_under(cChunk, "Future", rb_cObject);
+    rb_undef_alloc_func(cChunkFuture);
+    rb_define_method(cChunkFuture, "ready?", ChunkFuture_ready_p, 0);
+    rb_define_method(cChunkFuture, "value", ChunkFuture_value, 0);
+    rb_define_method(cChunkFuture, "id", ChunkFuture_id, 0);
+    rb_define_attr(cChunkFuture, "path", 1, 0);
+
     
     cMusic = rb_define_class_under(mMixer, "Music", rb_cObject);
     rb_undef_alloc_func(cMusic);
     rb_define_singleton_method(cMusic, "decoders", Music_s_decoders, 0);
     rb_define_singleton_method(cMusic, "load", Music_s_load, 1);
+    rb_define_singleton_method(cMusic, "from_string", Music_s_from_string, 1);
+    rb_define_singleton_method(cMusic, "from_io", Music_s_from_io, 1);
     rb_define_method(cMusic, "destroy", Music_destroy, 0);
     rb_define_method(cMusic, "destroy?", Music_destroy_p, 0);
     rb_define_method(cMusic, "inspect", Music_inspect, 0);
 
+    cSoundBank = rb_define_class_under(mMixer, "SoundBank", rb_cObject);
+    rb_define_alloc_func(cSoundBank, SoundBank_s_allocate);
+    rb_define_method(cSoundBank, "initialize", SoundBank_initialize, -1);
+    rb_define_method(cSoundBank, "load", SoundBank_load, 1);
+    rb_define_method(cSoundBank, "load_string", SoundBank_load_string, 1);
+    rb_define_method(cSoundBank, "play", SoundBank_play, -1);
+    rb_define_method(cSoundBank, "budget", SoundBank_budget, 0);
+    rb_define_method(cSoundBank, "budget=", SoundBank_set_budget, 1);
+    rb_define_method(cSoundBank, "bytes", SoundBank_bytes, 0);
+    rb_define_method(cSoundBank, "size", SoundBank_size, 0);
+    rb_define_method(cSoundBank, "include?", SoundBank_include_p, 1);
+    rb_define_method(cSoundBank, "clear", SoundBank_clear, 0);
+    rb_define_method(cSoundBank, "hits", SoundBank_hits, 0);
+    rb_define_method(cSoundBank, "misses", SoundBank_misses, 0);
+    rb_define_method(cSoundBank, "evictions", SoundBank_evictions, 0);
+
     
     mChannels = rb_define_module_under(mMixer, "Channels");
     rb_define_module_function(mChannels, "allocate", Channels_s_allocate, 1);
@@ -1212,6 +3116,43 @@ void rubysdl2_init_mixer(void)
     
     rb_gc_register_address(&playing_chunks);
     rb_gc_register_address(&playing_music);
+
+    id_read = rb_intern("read");
+    id_seek = rb_intern("seek");
+    id_pos = rb_intern("pos");
+    id_size = rb_intern("size");
+
+    cEffect = rb_define_class_under(mMixer, "Effect", rb_cObject);
+    rb_undef_alloc_func(cEffect);
+    rb_define_singleton_method(cEffect, "gain", Effect_s_gain, -1);
+    rb_define_singleton_method(cEffect, "lowpass", Effect_s_lowpass, -1);
+    rb_define_singleton_method(cEffect, "highpass", Effect_s_highpass, -1);
+    rb_define_singleton_method(cEffect, "compressor", Effect_s_compressor, -1);
+    rb_define_singleton_method(cEffect, "reverb", Effect_s_reverb, -1);
+    rb_define_singleton_method(cEffect, "clear", Effect_s_clear, 1);
+    rb_define_method(cEffect, "update", Effect_update, 1);
+    rb_define_method(cEffect, "attach", Effect_attach, 1);
+    rb_define_method(cEffect, "detach", Effect_detach, 0);
+    rb_define_method(cEffect, "attached?", Effect_attached_p, 0);
+    rb_define_method(cEffect, "enabled?", Effect_enabled_p, 0);
+    rb_define_method(cEffect, "enabled=", Effect_set_enabled, 1);
+    rb_define_attr(cEffect, "kind", 1, 0);
+    /* Channel number for the final mixed stream, for {SDL2::Mixer::Effect#attach} */
+    rb_define_const(cEffect, "POST", INT2NUM(MIX_CHANNEL_POST));
+
+    sym_gain = ID2SYM(rb_intern("gain"));
+    sym_ramp = ID2SYM(rb_intern("ramp"));
+    sym_cutoff = ID2SYM(rb_intern("cutoff"));
+    sym_q = ID2SYM(rb_intern("q"));
+    sym_threshold = ID2SYM(rb_intern("threshold"));
+    sym_ratio = ID2SYM(rb_intern("ratio"));
+    sym_attack = ID2SYM(rb_intern("attack"));
+    sym_release = ID2SYM(rb_intern("release"));
+    sym_makeup = ID2SYM(rb_intern("makeup"));
+    sym_room_size = ID2SYM(rb_intern("room_size"));
+    sym_damping = ID2SYM(rb_intern("damping"));
+    sym_wet = ID2SYM(rb_intern("wet"));
+    sym_dry = ID2SYM(rb_intern("dry"));
 }
 
 #else /* HAVE_SDL_MIXER_H */
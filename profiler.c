@@ -0,0 +1,405 @@
+#include "rubysdl2_internal.h"
+#include <SDL_timer.h>
+#include <SDL_events.h>
+
+static VALUE mProfiler;
+
+/* The number of buckets of the histogram of present time;
+ * the i-th bucket counts the calls which take [2^i, 2^(i+1)) microseconds */
+#define NUM_HISTOGRAM_BUCKETS 24
+
+typedef struct ProfileCounter {
+    Uint64 calls;
+    Uint64 ticks;
+} ProfileCounter;
+
+static const char* const slot_names[PROFILE_NUM_SLOTS] = {
+    "Renderer#copy",
+    "Renderer#copy_ex",
+    "Renderer#copy_batch",
+    "Renderer#geometry",
+    "Renderer#draw",
+    "Renderer#clear",
+    "Renderer#present",
+    "Renderer#read_pixels",
+    "Renderer::CommandList#replay",
+    "Texture.create",
+    "Texture#update",
+    "Event.poll",
+};
+
+int rubysdl2_profiler_enabled = 0;
+static ProfileCounter total[PROFILE_NUM_SLOTS];
+static ProfileCounter current_frame[PROFILE_NUM_SLOTS];
+static ProfileCounter last_frame[PROFILE_NUM_SLOTS];
+static Uint64 num_frames = 0;
+static Uint64 frame_start = 0;
+static Uint64 last_frame_ticks = 0;
+static Uint64 present_histogram[NUM_HISTOGRAM_BUCKETS];
+
+/* The maximum number of input events waiting for the next present */
+#define LATENCY_PENDING_SIZE 1024
+/* The number of latency samples kept in the ring buffers */
+#define LATENCY_RING_SIZE 4096
+
+int rubysdl2_latency_enabled = 0;
+/* Timestamps of input events delivered since the last present */
+static Uint32 pending_inputs[LATENCY_PENDING_SIZE];
+static int num_pending_inputs = 0;
+static Uint64 num_dropped_inputs = 0;
+/* Latencies in milliseconds: for each input event, and for each frame (the oldest input) */
+static Uint32 event_latencies[LATENCY_RING_SIZE];
+static Uint64 num_event_latencies = 0;
+static Uint32 frame_latencies[LATENCY_RING_SIZE];
+static Uint64 num_frame_latencies = 0;
+
+void rubysdl2_profiler_record(int slot, Uint64 start)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    Uint64 ticks = now - start;
+
+    total[slot].calls++;
+    total[slot].ticks += ticks;
+    current_frame[slot].calls++;
+    current_frame[slot].ticks += ticks;
+
+    if (slot == PROFILE_RENDERER_PRESENT) {
+        Uint64 us = ticks * 1000000 / SDL_GetPerformanceFrequency();
+        int bucket = 0;
+        while (us > 1 && bucket < NUM_HISTOGRAM_BUCKETS - 1) {
+            us >>= 1;
+            ++bucket;
+        }
+        present_histogram[bucket]++;
+
+        /* Renderer#present ends a frame */
+        memcpy(last_frame, current_frame, sizeof(current_frame));
+        memset(current_frame, 0, sizeof(current_frame));
+        if (frame_start)
+            last_frame_ticks = now - frame_start;
+        frame_start = now;
+        num_frames++;
+    }
+}
+
+void rubysdl2_latency_input(Uint32 type, Uint32 timestamp)
+{
+    /* keyboard, mouse, joystick, game controller and touch events */
+    if (type < SDL_KEYDOWN || type >= SDL_CLIPBOARDUPDATE)
+        return;
+    if (num_pending_inputs == LATENCY_PENDING_SIZE) {
+        ++num_dropped_inputs;
+        return;
+    }
+    pending_inputs[num_pending_inputs++] = timestamp;
+}
+
+void rubysdl2_latency_present(void)
+{
+    Uint32 now = SDL_GetTicks();
+    Uint32 oldest = 0;
+    int i;
+
+    if (num_pending_inputs == 0)
+        return;
+    for (i=0; i<num_pending_inputs; ++i) {
+        Uint32 latency = now - pending_inputs[i];
+        if (latency > oldest)
+            oldest = latency;
+        event_latencies[num_event_latencies++ % LATENCY_RING_SIZE] = latency;
+    }
+    frame_latencies[num_frame_latencies++ % LATENCY_RING_SIZE] = oldest;
+    num_pending_inputs = 0;
+}
+
+static int compare_uint32(const void* a, const void* b)
+{
+    Uint32 x = *(const Uint32*)a, y = *(const Uint32*)b;
+    return (x > y) - (x < y);
+}
+
+static VALUE counters_to_hash(const ProfileCounter* counters)
+{
+    VALUE hash = rb_hash_new();
+    double freq = (double)SDL_GetPerformanceFrequency();
+    int i;
+
+    for (i=0; i<PROFILE_NUM_SLOTS; ++i) {
+        VALUE entry;
+        if (counters[i].calls == 0)
+            continue;
+        entry = rb_hash_new();
+        rb_hash_aset(entry, rb_str_new2("calls"), ULL2NUM(counters[i].calls));
+        rb_hash_aset(entry, rb_str_new2("time"), DBL2NUM(counters[i].ticks / freq));
+        rb_hash_aset(hash, rb_str_new2(slot_names[i]), entry);
+    }
+    return hash;
+}
+
+/*
+ * Document-module: SDL2::Profiler
+ *
+ * This module counts calls and measures time spent in the hot methods
+ * of Ruby/SDL2 (rendering, texture creation/update, and event polling).
+ *
+ * Time is measured with {SDL2.get_performance_counter} inside
+ * the C functions, so the overhead of the measurement is small and
+ * it does not include the Ruby-side dispatch.
+ * The profiler is disabled by default and costs only one branch per call
+ * while disabled.
+ *
+ * {SDL2::Renderer#present} ends a frame; {.frame_stats} returns
+ * the statistics of the last completed frame.
+ *
+ * Input-to-present latency can be tracked separately with {.track_latency=}.
+ *
+ * Measured methods are grouped as follows:
+ *
+ * * "Renderer#copy" - {SDL2::Renderer#copy} and {SDL2::Renderer#copy_f}
+ * * "Renderer#copy_ex" - {SDL2::Renderer#copy_ex} and {SDL2::Renderer#copy_ex_f}
+ * * "Renderer#copy_batch" - {SDL2::Renderer#copy_batch} and {SDL2::Renderer#copy_batch_f}
+ * * "Renderer#geometry" - {SDL2::Renderer#geometry}
+ * * "Renderer#draw" - draw_* and fill_* methods of {SDL2::Renderer}
+ * * "Renderer#clear" - {SDL2::Renderer#clear}
+ * * "Renderer#present" - {SDL2::Renderer#present}
+ * * "Renderer#read_pixels" - {SDL2::Renderer#read_pixels}, {SDL2::Renderer#read_pixels_into}
+ *   and {SDL2::Renderer::Capture#capture}
+ * * "Renderer::CommandList#replay" - {SDL2::Renderer::CommandList#replay}
+ * * "Texture.create" - {SDL2::Renderer#create_texture},
+ *   {SDL2::Renderer#create_texture_from} and {SDL2::Renderer#load_texture}
+ * * "Texture#update" - {SDL2::Texture#update}
+ * * "Event.poll" - {SDL2::Event.poll}, {SDL2::Event.poll_all}, {SDL2::Event.drain},
+ *   {SDL2::Event.poll_into}, {SDL2::Event.poll_raw_into} and {SDL2::EventDispatcher#dispatch}
+ *
+ * @example
+ *   SDL2::Profiler.enable
+ *   # ... run some frames ...
+ *   p SDL2::Profiler.frame_stats
+ *   # => {"Renderer#copy"=>{"calls"=>300, "time"=>0.0021}, "Renderer#present"=>{...}}
+ */
+
+/*
+ * Start profiling.
+ *
+ * @return [nil]
+ */
+static VALUE Profiler_s_enable(VALUE self)
+{
+    rubysdl2_profiler_enabled = 1;
+    return Qnil;
+}
+
+/*
+ * Stop profiling. The statistics are kept until {.reset}.
+ *
+ * @return [nil]
+ */
+static VALUE Profiler_s_disable(VALUE self)
+{
+    rubysdl2_profiler_enabled = 0;
+    return Qnil;
+}
+
+/* Return true if the profiler is enabled. */
+static VALUE Profiler_s_enabled_p(VALUE self)
+{
+    return INT2BOOL(rubysdl2_profiler_enabled);
+}
+
+/*
+ * Clear all statistics.
+ *
+ * @return [nil]
+ */
+static VALUE Profiler_s_reset(VALUE self)
+{
+    memset(total, 0, sizeof(total));
+    memset(current_frame, 0, sizeof(current_frame));
+    memset(last_frame, 0, sizeof(last_frame));
+    memset(present_histogram, 0, sizeof(present_histogram));
+    num_frames = 0;
+    frame_start = 0;
+    last_frame_ticks = 0;
+    num_pending_inputs = 0;
+    num_dropped_inputs = 0;
+    num_event_latencies = num_frame_latencies = 0;
+    return Qnil;
+}
+
+/*
+ * Get the statistics since the profiler is {.reset}.
+ *
+ * @return [Hash{String => Hash{String => Numeric}}] the number of "calls" and
+ *   the total "time" (in seconds) for each group of measured methods
+ */
+static VALUE Profiler_s_stats(VALUE self)
+{
+    return counters_to_hash(total);
+}
+
+/*
+ * Get the statistics of the last completed frame.
+ *
+ * @return [Hash{String => Hash{String => Numeric}}] the same format as {.stats}
+ */
+static VALUE Profiler_s_frame_stats(VALUE self)
+{
+    return counters_to_hash(last_frame);
+}
+
+/* @return [Integer] the number of frames ({SDL2::Renderer#present} calls) */
+static VALUE Profiler_s_frames(VALUE self)
+{
+    return ULL2NUM(num_frames);
+}
+
+/*
+ * Get the time between the last two calls of {SDL2::Renderer#present}.
+ *
+ * @return [Float] the frame time in seconds (0.0 if less than two frames)
+ */
+static VALUE Profiler_s_frame_time(VALUE self)
+{
+    return DBL2NUM((double)last_frame_ticks / SDL_GetPerformanceFrequency());
+}
+
+/*
+ * Get the histogram of the time of {SDL2::Renderer#present}.
+ *
+ * The i-th element is the number of calls which took
+ * 2**i to 2**(i+1) microseconds (the first bucket also counts shorter calls,
+ * and the last also counts longer calls).
+ *
+ * @return [Array<Integer>]
+ */
+static VALUE Profiler_s_present_histogram(VALUE self)
+{
+    VALUE ary = rb_ary_new2(NUM_HISTOGRAM_BUCKETS);
+    int i;
+    for (i=0; i<NUM_HISTOGRAM_BUCKETS; ++i)
+        rb_ary_push(ary, ULL2NUM(present_histogram[i]));
+    return ary;
+}
+
+/* Return true if input-to-present latency is tracked. */
+static VALUE Profiler_s_track_latency_p(VALUE self)
+{
+    return INT2BOOL(rubysdl2_latency_enabled);
+}
+
+/*
+ * @overload track_latency=(enabled)
+ *   Enable or disable tracking of input-to-present latency.
+ *
+ *   When enabled, the timestamps of input events (keyboard, mouse, joystick,
+ *   game controller and touch events) delivered by {SDL2::Event.poll},
+ *   {SDL2::Event.poll_all}, {SDL2::Event.drain}, {SDL2::Event.wait},
+ *   {SDL2::Event.poll_into} and {SDL2::EventDispatcher#dispatch}
+ *   are kept until the next {SDL2::Renderer#present} or {SDL2::Window#gl_swap}.
+ *   Then the time from the event to the end of the present is recorded.
+ *
+ *   All data are kept in native ring buffers of the last 4096 samples,
+ *   and no Ruby object is created during tracking.
+ *   Timestamps of SDL events have millisecond resolution.
+ *
+ *   This is independent of {.enable}.
+ *
+ *   @param [Boolean] enabled true to enable tracking
+ *   @return [Boolean]
+ *   @see .latency_percentiles
+ */
+static VALUE Profiler_s_set_track_latency(VALUE self, VALUE enabled)
+{
+    rubysdl2_latency_enabled = RTEST(enabled);
+    num_pending_inputs = 0;
+    return enabled;
+}
+
+/*
+ * @overload latency_percentiles(percentiles=[50, 90, 99], per_frame=false)
+ *   Get the percentiles of input-to-present latency.
+ *
+ *   @param [Array<Numeric>] percentiles percentiles to compute (0 to 100)
+ *   @param [Boolean] per_frame if true, one sample per frame (the latency of
+ *     the oldest input in the frame) is used; otherwise one sample per input event
+ *   @return [Array<Float,nil>] the latencies in seconds for each percentile,
+ *     nil if no samples are recorded
+ *
+ *   @example
+ *     SDL2::Profiler.track_latency = true
+ *     # ... run some frames ...
+ *     p50, p99 = SDL2::Profiler.latency_percentiles([50, 99])
+ */
+static VALUE Profiler_s_latency_percentiles(int argc, VALUE* argv, VALUE self)
+{
+    VALUE percentiles, per_frame, result;
+    const Uint32* ring;
+    Uint64 total_samples;
+    Uint32 sorted[LATENCY_RING_SIZE];
+    long i, n;
+
+    rb_scan_args(argc, argv, "02", &percentiles, &per_frame);
+    if (percentiles == Qnil)
+        percentiles = rb_ary_new3(3, INT2FIX(50), INT2FIX(90), INT2FIX(99));
+    Check_Type(percentiles, T_ARRAY);
+
+    ring = RTEST(per_frame) ? frame_latencies : event_latencies;
+    total_samples = RTEST(per_frame) ? num_frame_latencies : num_event_latencies;
+    n = (total_samples < LATENCY_RING_SIZE) ? (long)total_samples : LATENCY_RING_SIZE;
+    memcpy(sorted, ring, sizeof(Uint32) * n);
+    qsort(sorted, n, sizeof(Uint32), compare_uint32);
+
+    result = rb_ary_new2(RARRAY_LEN(percentiles));
+    for (i=0; i<RARRAY_LEN(percentiles); ++i) {
+        double p = NUM2DBL(rb_ary_entry(percentiles, i));
+        long rank;
+        if (p < 0 || p > 100)
+            rb_raise(rb_eArgError, "percentile out of range (%f)", p);
+        if (n == 0) {
+            rb_ary_push(result, Qnil);
+            continue;
+        }
+        /* nearest-rank method */
+        rank = (long)(p / 100.0 * n + 0.999999) - 1;
+        if (rank < 0)
+            rank = 0;
+        if (rank >= n)
+            rank = n - 1;
+        rb_ary_push(result, DBL2NUM(sorted[rank] / 1000.0));
+    }
+    return result;
+}
+
+/*
+ * Get the statistics of input-to-present latency tracking.
+ *
+ * @return [Hash{String => Integer}] the number of recorded "events" and "frames",
+ *   and the number of "dropped" input events (more than 1024 inputs in one frame)
+ */
+static VALUE Profiler_s_latency_stats(VALUE self)
+{
+    VALUE hash = rb_hash_new();
+    rb_hash_aset(hash, rb_str_new2("events"), ULL2NUM(num_event_latencies));
+    rb_hash_aset(hash, rb_str_new2("frames"), ULL2NUM(num_frame_latencies));
+    rb_hash_aset(hash, rb_str_new2("dropped"), ULL2NUM(num_dropped_inputs));
+    return hash;
+}
+
+void rubysdl2_init_profiler(void)
+{
+    mProfiler = rb_define_module_under(mSDL2, "Profiler");
+
+    rb_define_module_function(mProfiler, "enable", Profiler_s_enable, 0);
+    rb_define_module_function(mProfiler, "disable", Profiler_s_disable, 0);
+    rb_define_module_function(mProfiler, "enabled?", Profiler_s_enabled_p, 0);
+    rb_define_module_function(mProfiler, "reset", Profiler_s_reset, 0);
+    rb_define_module_function(mProfiler, "stats", Profiler_s_stats, 0);
+    rb_define_module_function(mProfiler, "frame_stats", Profiler_s_frame_stats, 0);
+    rb_define_module_function(mProfiler, "frames", Profiler_s_frames, 0);
+    rb_define_module_function(mProfiler, "frame_time", Profiler_s_frame_time, 0);
+    rb_define_module_function(mProfiler, "present_histogram", Profiler_s_present_histogram, 0);
+    rb_define_module_function(mProfiler, "track_latency?", Profiler_s_track_latency_p, 0);
+    rb_define_module_function(mProfiler, "track_latency=", Profiler_s_set_track_latency, 1);
+    rb_define_module_function(mProfiler, "latency_percentiles", Profiler_s_latency_percentiles, -1);
+    rb_define_module_function(mProfiler, "latency_stats", Profiler_s_latency_stats, 0);
+}
@@ -27,6 +27,7 @@
 #include <SDL_surface.h>
 #include <SDL_version.h>
 #include <SDL_video.h>
+#include <SDL_timer.h>
 
 #ifndef SDL2_EXTERN
 #define SDL2_EXTERN extern
@@ -45,6 +46,8 @@ VALUE rubysdl2_find_window_by_id(Uint32 id);
 SDL_Rect* rubysdl2_Get_SDL_Rect(VALUE);
 SDL_Window* rubysdl2_Get_SDL_Window(VALUE);
 const char* rubysdl2_INT2BOOLCSTR(int);
+const void* rubysdl2_bytes_for_reading(VALUE obj, size_t* len);
+void* rubysdl2_bytes_for_writing(VALUE obj, size_t* len);
 
 /** initialize interfaces */
 void rubysdl2_init_hints(void);
@@ -58,10 +61,34 @@ void rubysdl2_init_joystick(void);
 void rubysdl2_init_timer(void);
 void rubysdl2_init_image(void);
 void rubysdl2_init_mixer(void);
+void rubysdl2_init_audio(void);
 void rubysdl2_init_ttf(void);
 void rubysdl2_init_filesystem(void);
 void rubysdl2_init_clipboard(void);
 void rubysdl2_init_gamecontorller(void);
+void rubysdl2_init_profiler(void);
+
+/** profiler */
+enum {
+    PROFILE_RENDERER_COPY,
+    PROFILE_RENDERER_COPY_EX,
+    PROFILE_RENDERER_COPY_BATCH,
+    PROFILE_RENDERER_GEOMETRY,
+    PROFILE_RENDERER_DRAW,
+    PROFILE_RENDERER_CLEAR,
+    PROFILE_RENDERER_PRESENT,
+    PROFILE_RENDERER_READ_PIXELS,
+    PROFILE_COMMAND_LIST_REPLAY,
+    PROFILE_TEXTURE_CREATE,
+    PROFILE_TEXTURE_UPDATE,
+    PROFILE_EVENT_POLL,
+    PROFILE_NUM_SLOTS
+};
+extern int rubysdl2_profiler_enabled;
+void rubysdl2_profiler_record(int slot, Uint64 start);
+extern int rubysdl2_latency_enabled;
+void rubysdl2_latency_input(Uint32 type, Uint32 timestamp);
+void rubysdl2_latency_present(void);
 
 /** macros */
 #define HANDLE_ERROR(c) (rubysdl2_handle_error((c), __func__))
@@ -71,6 +98,22 @@ void rubysdl2_init_gamecontorller(void);
 #define UCHAR2NUM UINT2NUM
 #define rb_str_export_to_utf8(str) rb_str_export_to_enc((str), rb_utf8_encoding())
 
+/* Measure the time between PROFILE_BEGIN and PROFILE_END when SDL2::Profiler is enabled.
+ * PROFILE_BEGIN is a declaration. */
+#define PROFILE_BEGIN(var)                                              \
+    Uint64 var = (rubysdl2_profiler_enabled ? SDL_GetPerformanceCounter() : 0)
+#define PROFILE_END(slot, var)                                          \
+    do { if (var) rubysdl2_profiler_record((slot), (var)); } while (0)
+
+/* Record delivered events and presents when SDL2::Profiler.track_latency is enabled. */
+#define LATENCY_INPUT(ev)                                               \
+    do {                                                                \
+        if (rubysdl2_latency_enabled)                                   \
+            rubysdl2_latency_input((ev)->type, (ev)->common.timestamp); \
+    } while (0)
+#define LATENCY_PRESENT()                                               \
+    do { if (rubysdl2_latency_enabled) rubysdl2_latency_present(); } while (0)
+
 /* Helper macro to define a rb_data_type_t for TypedData.
  * Usage: DEFINE_DATA_TYPE(struct_name, free_func)
  * Defines: static const rb_data_type_t struct_name##_data_type
@@ -132,5 +175,7 @@ SDL2_EXTERN VALUE rubysdl2_eSDL2Error;
 #define SDL_version_to_Array rubysdl2_SDL_version_to_Array
 #define INT2BOOLCSTR  rubysdl2_INT2BOOLCSTR 
 #define find_window_by_id rubysdl2_find_window_by_id
+#define bytes_for_reading rubysdl2_bytes_for_reading
+#define bytes_for_writing rubysdl2_bytes_for_writing
 
 #endif
@@ -0,0 +1,37 @@
+require 'sdl2'
+
+# usage: ruby audio_queue.rb [SAMPLES]
+# Play a sine sweep for 3 seconds with a raw audio device,
+# keeping about 20ms of audio in the queue.
+
+FREQ = 48000
+samples = (ARGV[0] || 256).to_i
+
+SDL2.init(SDL2::INIT_AUDIO)
+dev = SDL2::Audio::Device.open(FREQ, SDL2::Audio::FORMAT_F32SYS, 1, samples)
+p dev
+
+phase = 0.0
+t = 0
+render = lambda do |n|
+  buf = Array.new(n) do
+    pitch = 220.0 + 440.0 * t / (FREQ * 3)
+    phase += 2 * Math::PI * pitch / FREQ
+    t += 1
+    Math.sin(phase) * 0.2
+  end
+  buf.pack("e*")
+end
+
+dev.queue(render.(samples * 2))
+dev.resume
+while t < FREQ * 3
+  dev.queue(render.(samples)) while dev.queued_time < 0.02
+  sleep 0.002
+end
+sleep 0.05 while dev.queued_bytes > 0
+
+puts "underruns: #{dev.underruns}"
+puts "min queued: #{dev.min_queued_bytes} bytes"
+puts "total: #{dev.total_bytes} bytes"
+dev.close
@@ -0,0 +1,41 @@
+require 'sdl2'
+
+# usage:
+#   ruby event_record.rb record session.log   # record until the window is closed
+#   ruby event_record.rb replay session.log   # replay headlessly as fast as possible
+
+mode, path = ARGV
+abort "usage: #{$0} record|replay LOGFILE" unless %w(record replay).include?(mode) && path
+
+if mode == "record"
+  SDL2.init(SDL2::INIT_VIDEO|SDL2::INIT_EVENTS)
+  window = SDL2::Window.create("event_record", 0, 0, 640, 480, 0)
+  File.open(path, "wb") do |f|
+    recorder = SDL2::Event::Recorder.new(f)
+    recorder.start
+    loop do
+      SDL2::Event.drain do |ev|
+        case ev
+        when SDL2::Event::Quit
+          recorder.stop
+          puts "#{recorder.count} events recorded"
+          exit
+        end
+      end
+      recorder.flush
+      sleep 0.01
+    end
+  end
+else
+  ENV["SDL_VIDEODRIVER"] = "dummy"
+  SDL2.init(SDL2::INIT_VIDEO|SDL2::INIT_EVENTS)
+  player = SDL2::Event::Player.new(File.binread(path))
+  counts = Hash.new(0)
+  t = Time.now
+  until player.finished?
+    player.push(1024)
+    SDL2::Event.drain{|ev| counts[ev.class] += 1 }
+  end
+  printf("%d events replayed in %.3f sec\n", player.position, Time.now - t)
+  counts.each{|klass, n| puts "  #{klass}: #{n}" }
+end
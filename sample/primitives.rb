@@ -17,6 +17,12 @@ renderer.fill_rect(SDL2::Rect.new(20, 400, 60, 40))
 renderer.draw_blend_mode = SDL2::BlendMode::ADD
 renderer.draw_color = [255, 0, 0]
 renderer.draw_rect(SDL2::Rect.new(40, 420, 60, 40))
+renderer.draw_blend_mode = SDL2::BlendMode::NONE
+renderer.draw_color = [0, 255, 0]
+renderer.draw_points([300, 300, 310, 300, 320, 300])
+renderer.draw_lines([100, 100, 150, 50, 200, 100, 100, 100])
+renderer.draw_rects([300, 350, 20, 20, 330, 350, 20, 20])
+renderer.fill_rects([300, 400, 20, 20, 330, 400, 20, 20].pack("i*"))
 
 renderer.present
 
@@ -35,12 +35,13 @@ end
                    
 
 class WindowData
-  def initialize(sdl_window, renderer, cycle, blend_mode, use_color_key)
+  def initialize(sdl_window, renderer, cycle, blend_mode, use_color_key, batch)
     @sdl_window = sdl_window
     @renderer = renderer
     @cycle = cycle
     @blend_mode = blend_mode
     @use_color_key = use_color_key
+    @batch = batch
   end
 
   def setup(spritepath, num_sprites)
@@ -91,7 +92,12 @@ class WindowData
     @sprite.color_mod = [@cycle.color, 255, @cycle.color] if @cycle.cycle_color
     @sprite.alpha_mod = @cycle.alpha if @cycle.cycle_alpha
     
-    @sprites.each(&:draw)
+    if @batch
+      rects = @sprites.flat_map(&:rect_values).pack("i*")
+      @renderer.copy_batch(@sprite, nil, rects)
+    else
+      @sprites.each(&:draw)
+    end
     @renderer.present
   end
   
@@ -132,6 +138,10 @@ class WindowData
     def draw
       @renderer.copy(@sprite, nil, @position)
     end
+
+    def rect_values
+      [@position.x, @position.y, @position.w, @position.h]
+    end
   end
 end
 
@@ -150,6 +160,7 @@ class App
     @blend_mode = SDL2::BlendMode::BLEND
     @cycle = Cycle.new(false, false, rand(255), rand(255), [1,-1].sample, [1,-1].sample)
     @use_color_key = true
+    @batch = false
   end
 
   def options
@@ -222,6 +233,10 @@ class App
     }
 
     opts.on("--use-color-key (yes|no)", TrueClass){|bool| @use_color_key = bool }
+
+    opts.on("--sprites N", "Number of sprites", Integer){|n| @num_sprites = n }
+
+    opts.on("--batch", "Draw all sprites with one Renderer#copy_batch call"){ @batch = true }
     opts
   end
 
@@ -238,7 +253,7 @@ class App
       renderer = window.create_renderer(-1, @renderer_flags)
       window.icon = icon if icon
       
-      WindowData.new(window, renderer, @cycle, @blend_mode, @use_color_key)
+      WindowData.new(window, renderer, @cycle, @blend_mode, @use_color_key, @batch)
     end
 
     @windows.each{|win| win.setup(@spritepath, @num_sprites) }
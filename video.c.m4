@@ -5,7 +5,17 @@
 #include <SDL_render.h>
 #include <SDL_messagebox.h>
 #include <SDL_endian.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
 #include <ruby/encoding.h>
+#include <ruby/thread.h>
+#ifdef HAVE_RB_MEMORY_VIEW_REGISTER
+#include <ruby/memory_view.h>
+#endif
+#include <errno.h>
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES_FOR_READING
+#include <ruby/io/buffer.h>
+#endif
 
 static VALUE cWindow;
 static VALUE mWindowFlags;
@@ -17,8 +27,14 @@ static VALUE mBlendMode;
 static VALUE cTexture;
 static VALUE cRect;
 static VALUE cPoint;
+static VALUE cFRect;
+static VALUE cFPoint;
 static VALUE cSurface;
 static VALUE cRendererInfo;
+static VALUE cRendererCapture;
+static VALUE cRendererCommandList;
+static VALUE cTextureAtlas;
+static VALUE cTextureAtlasRegion;
 static VALUE cPixelFormat; /* NOTE: This is related to SDL_PixelFormatEnum, not SDL_PixelFormat */
 static VALUE mPixelType;
 static VALUE mBitmapOrder;
@@ -63,21 +79,35 @@ typedef struct Texture {
 typedef struct Surface {
     SDL_Surface* surface;
     int need_to_free_pixels;
+    /* The String holding the pixels of a surface created by Surface.wrap_string */
+    VALUE pixels_string;
+    /* The number of exported views (MemoryView or IO::Buffer) of the pixels */
+    int num_views;
 } Surface;
 
 static void Window_free(Window*);
 static void Renderer_free(Renderer*);
 static void Texture_free(Texture*);
 static void Surface_free(Surface*);
+static void Surface_mark(Surface*);
 
 /* Forward-declare TypedData types (need free function declarations above) */
 DEFINE_DATA_TYPE(Window, Window_free);
 DEFINE_DATA_TYPE(SDL_DisplayMode, free);
 DEFINE_DATA_TYPE(Renderer, Renderer_free);
 DEFINE_DATA_TYPE(Texture, Texture_free);
-DEFINE_DATA_TYPE(Surface, Surface_free);
+/* Surface pins the String of Surface.wrap_string, so it needs a mark function */
+static const rb_data_type_t Surface_data_type = {
+    "ruby-sdl2/Surface",
+    { (void (*)(void*))Surface_mark, (void (*)(void*))Surface_free, NULL },
+    NULL, NULL, RUBY_TYPED_FREE_IMMEDIATELY
+};
 DEFINE_DATA_TYPE(SDL_Rect, free);
 DEFINE_DATA_TYPE(SDL_Point, free);
+#if SDL_VERSION_ATLEAST(2,0,10)
+DEFINE_DATA_TYPE(SDL_FRect, free);
+DEFINE_DATA_TYPE(SDL_FPoint, free);
+#endif
 
 static void Window_destroy_internal(Window* w)
 {
@@ -239,18 +269,26 @@ static void Surface_free(Surface* s)
 {
     GC_LOG((stderr, "Surface free: %p\n", s));
     if (s->need_to_free_pixels)
-        free(s->surface->pixels);
+        ruby_xfree(s->surface->pixels);
     if (s->surface && rubysdl2_is_active())
         SDL_FreeSurface(s->surface);
     free(s);
 }
 
+static void Surface_mark(Surface* s)
+{
+    /* rb_gc_mark (not rb_gc_mark_movable) also prevents compaction from moving it */
+    rb_gc_mark(s->pixels_string);
+}
+
 VALUE Surface_new(SDL_Surface* surface)
 {
     Surface* s;
     VALUE obj = TypedData_Make_Struct(cSurface, Surface, &Surface_data_type, s);
     s->surface = surface;
     s->need_to_free_pixels = 0;
+    s->pixels_string = Qnil;
+    s->num_views = 0;
     return obj;
 }
 
@@ -260,6 +298,12 @@ DEFINE_GETTER(, SDL_Rect, cRect, "SDL2::Rect");
 
 DEFINE_GETTER(static, SDL_Point, cPoint, "SDL2::Point");
 
+#if SDL_VERSION_ATLEAST(2,0,10)
+DEFINE_GETTER(static, SDL_FRect, cFRect, "SDL2::FRect");
+
+DEFINE_GETTER(static, SDL_FPoint, cFPoint, "SDL2::FPoint");
+#endif
+
 static VALUE PixelFormat_new(Uint32 format)
 {
     VALUE fmt = UINT2NUM(format);
@@ -921,6 +965,7 @@ static VALUE Window_gl_drawable_size(VALUE self)
 static VALUE Window_gl_swap(VALUE self)
 {
     SDL_GL_SwapWindow(Get_SDL_Window(self));
+    LATENCY_PRESENT();
     return Qnil;
 }
 
@@ -1229,11 +1274,13 @@ static VALUE Renderer_destroy(VALUE self)
 static VALUE Renderer_create_texture(VALUE self, VALUE format, VALUE access,
                                      VALUE w, VALUE h)
 {
+    PROFILE_BEGIN(start);
     SDL_Texture* texture = SDL_CreateTexture(Get_SDL_Renderer(self),
                                              uint32_for_format(format),
                                              NUM2INT(access), NUM2INT(w), NUM2INT(h));
     if (!texture)
         SDL_ERROR();
+    PROFILE_END(PROFILE_TEXTURE_CREATE, start);
     return Texture_new(texture, Get_Renderer(self));
 }
 
@@ -1250,11 +1297,13 @@ static VALUE Renderer_create_texture(VALUE self, VALUE format, VALUE access,
  */
 static VALUE Renderer_create_texture_from(VALUE self, VALUE surface)
 {
+    PROFILE_BEGIN(start);
     SDL_Texture* texture = SDL_CreateTextureFromSurface(Get_SDL_Renderer(self),
                                                         Get_SDL_Surface(surface));
     if (texture == NULL)
         SDL_ERROR();
 
+    PROFILE_END(PROFILE_TEXTURE_CREATE, start);
     return Texture_new(texture, Get_Renderer(self));
 }
 
@@ -1268,6 +1317,99 @@ static SDL_Point* Get_SDL_Point_or_NULL(VALUE point)
     return point == Qnil ? NULL : Get_SDL_Point(point);
 }
 
+/*
+ * Get the array of ints from a binary string packed by Array#pack("i*")
+ * or a flat Array of Integers. Each element consists of **unit** ints
+ * (2 for SDL_Point, 4 for SDL_Rect) and the number of elements is stored
+ * to *num. An Array is converted into a temporary buffer held by *tmp,
+ * which should be released by ALLOCV_END.
+ */
+static const int* packed_ints(VALUE obj, long unit, long* num, VALUE* tmp)
+{
+    *tmp = 0;
+    if (RB_TYPE_P(obj, T_ARRAY)) {
+        long len = RARRAY_LEN(obj);
+        long i;
+        int* buf;
+        if (len % unit != 0)
+            rb_raise(rb_eArgError, "array length (%ld) is not a multiple of %ld", len, unit);
+        buf = ALLOCV_N(int, *tmp, len);
+        for (i=0; i<len; ++i)
+            buf[i] = NUM2INT(RARRAY_AREF(obj, i));
+        *num = len / unit;
+        return buf;
+    } else {
+        long size = unit * sizeof(int);
+        StringValue(obj);
+        if (RSTRING_LEN(obj) % size != 0)
+            rb_raise(rb_eArgError, "packed string length (%ld) is not a multiple of %ld",
+                     RSTRING_LEN(obj), size);
+        *num = RSTRING_LEN(obj) / size;
+        return (const int*)RSTRING_PTR(obj);
+    }
+}
+
+static const SDL_Rect* packed_rects(VALUE obj, long* num, VALUE* tmp)
+{
+    return (const SDL_Rect*)packed_ints(obj, 4, num, tmp);
+}
+
+static const SDL_Point* packed_points(VALUE obj, long* num, VALUE* tmp)
+{
+    return (const SDL_Point*)packed_ints(obj, 2, num, tmp);
+}
+
+#if SDL_VERSION_ATLEAST(2,0,10)
+static SDL_FRect* Get_SDL_FRect_or_NULL(VALUE rect)
+{
+    return rect == Qnil ? NULL : Get_SDL_FRect(rect);
+}
+
+static SDL_FPoint* Get_SDL_FPoint_or_NULL(VALUE point)
+{
+    return point == Qnil ? NULL : Get_SDL_FPoint(point);
+}
+
+/*
+ * Same as packed_ints, but for floats packed by Array#pack("f*")
+ * or a flat Array of Numerics.
+ */
+static const float* packed_floats(VALUE obj, long unit, long* num, VALUE* tmp)
+{
+    *tmp = 0;
+    if (RB_TYPE_P(obj, T_ARRAY)) {
+        long len = RARRAY_LEN(obj);
+        long i;
+        float* buf;
+        if (len % unit != 0)
+            rb_raise(rb_eArgError, "array length (%ld) is not a multiple of %ld", len, unit);
+        buf = ALLOCV_N(float, *tmp, len);
+        for (i=0; i<len; ++i)
+            buf[i] = NUM2DBL(RARRAY_AREF(obj, i));
+        *num = len / unit;
+        return buf;
+    } else {
+        long size = unit * sizeof(float);
+        StringValue(obj);
+        if (RSTRING_LEN(obj) % size != 0)
+            rb_raise(rb_eArgError, "packed string length (%ld) is not a multiple of %ld",
+                     RSTRING_LEN(obj), size);
+        *num = RSTRING_LEN(obj) / size;
+        return (const float*)RSTRING_PTR(obj);
+    }
+}
+
+static const SDL_FRect* packed_frects(VALUE obj, long* num, VALUE* tmp)
+{
+    return (const SDL_FRect*)packed_floats(obj, 4, num, tmp);
+}
+
+static const SDL_FPoint* packed_fpoints(VALUE obj, long* num, VALUE* tmp)
+{
+    return (const SDL_FPoint*)packed_floats(obj, 2, num, tmp);
+}
+#endif
+
 /*
  * @overload copy(texture, srcrect, dstrect)
  *   Copy a portion of the texture to the current rendering target.
@@ -1283,10 +1425,81 @@ static SDL_Point* Get_SDL_Point_or_NULL(VALUE point)
  */
 static VALUE Renderer_copy(VALUE self, VALUE texture, VALUE srcrect, VALUE dstrect)
 {
+    PROFILE_BEGIN(start);
     HANDLE_ERROR(SDL_RenderCopy(Get_SDL_Renderer(self),
                                 Get_SDL_Texture(texture),
                                 Get_SDL_Rect_or_NULL(srcrect),
                                 Get_SDL_Rect_or_NULL(dstrect)));
+    PROFILE_END(PROFILE_RENDERER_COPY, start);
+    return Qnil;
+}
+
+/*
+ * @overload copy_batch(texture, rects)
+ *   Copy many portions of the texture to the current rendering target
+ *   at once.
+ *
+ *   **rects** is a binary string of packed rectangles; each rectangle
+ *   is four native ints (x, y, w, h), so you can make it with
+ *   Array#pack("i*"). A flat Array of Integers is also accepted.
+ *   Rectangles are given in pairs of a source rectangle
+ *   and a destination rectangle.
+ *
+ *   @param [SDL2::Texture] texture the source texture
+ *   @param [String,Array<Integer>] rects packed pairs of source and destination rectangles
+ *
+ * @overload copy_batch(texture, srcrect, dstrects)
+ *   Copy the same portion of the texture to many places of the current
+ *   rendering target at once.
+ *
+ *   @param [SDL2::Texture] texture the source texture
+ *   @param [SDL2::Rect,nil] srcrect the source rectangle, or nil for the entire texture
+ *   @param [String,Array<Integer>] dstrects packed destination rectangles
+ *
+ * This method is equivalent to calling {#copy} for each rectangle,
+ * but it is much faster when you draw many sprites.
+ *
+ * @example
+ *   dst = sprites.flat_map{|s| [s.x, s.y, s.w, s.h] }.pack("i*")
+ *   renderer.copy_batch(texture, nil, dst)
+ *
+ * @return [nil]
+ * @raise [ArgumentError] raised when the length of the packed string is wrong
+ *
+ * @see #copy
+ */
+static VALUE Renderer_copy_batch(int argc, VALUE* argv, VALUE self)
+{
+    VALUE texture, arg1, arg2, tmp;
+    SDL_Renderer* renderer;
+    SDL_Texture* sdl_texture;
+    const SDL_Rect* rects;
+    long num, i;
+    PROFILE_BEGIN(start);
+
+    rb_scan_args(argc, argv, "21", &texture, &arg1, &arg2);
+    renderer = Get_SDL_Renderer(self);
+    sdl_texture = Get_SDL_Texture(texture);
+
+    if (argc == 2) {
+        rects = packed_rects(arg1, &num, &tmp);
+        if (num % 2 != 0) {
+            ALLOCV_END(tmp);
+            rb_raise(rb_eArgError, "odd number of packed rects (%ld)", num);
+        }
+        for (i=0; i<num; i+=2)
+            HANDLE_ERROR(SDL_RenderCopy(renderer, sdl_texture, &rects[i], &rects[i+1]));
+    } else {
+        const SDL_Rect* srcrect = Get_SDL_Rect_or_NULL(arg1);
+        rects = packed_rects(arg2, &num, &tmp);
+        for (i=0; i<num; ++i)
+            HANDLE_ERROR(SDL_RenderCopy(renderer, sdl_texture, srcrect, &rects[i]));
+    }
+
+    ALLOCV_END(tmp);
+    RB_GC_GUARD(arg1);
+    RB_GC_GUARD(arg2);
+    PROFILE_END(PROFILE_RENDERER_COPY_BATCH, start);
     return Qnil;
 }
 
@@ -1320,6 +1533,7 @@ static VALUE Renderer_copy(VALUE self, VALUE texture, VALUE srcrect, VALUE dstre
 static VALUE Renderer_copy_ex(VALUE self, VALUE texture, VALUE srcrect, VALUE dstrect,
                               VALUE angle, VALUE center, VALUE flip)
 {
+    PROFILE_BEGIN(start);
     HANDLE_ERROR(SDL_RenderCopyEx(Get_SDL_Renderer(self),
                                   Get_SDL_Texture(texture),
                                   Get_SDL_Rect_or_NULL(srcrect),
@@ -1327,8 +1541,69 @@ static VALUE Renderer_copy_ex(VALUE self, VALUE texture, VALUE srcrect, VALUE ds
                                   NUM2DBL(angle),
                                   Get_SDL_Point_or_NULL(center),
                                   NUM2INT(flip)));
+    PROFILE_END(PROFILE_RENDERER_COPY_EX, start);
+    return Qnil;
+}
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+/*
+ * @overload geometry(texture, vertices, indices=nil)
+ *   Render a list of triangles, optionally using a texture and
+ *   indices into the vertex array.
+ *
+ *   **vertices** is a binary string of packed vertices. Each vertex consists of
+ *   the position (two floats), the color (four unsigned bytes: r, g, b, and a),
+ *   and the texture coordinate (two floats, normalized to 0.0-1.0),
+ *   i.e. Array#pack("ffCCCCff") for each vertex.
+ *
+ *   **indices** is a binary string packed by Array#pack("i*") or an Array of
+ *   Integers. If indices is nil, vertices are drawn sequentially, three vertices
+ *   for each triangle.
+ *
+ *   @param texture [SDL2::Texture,nil] the texture, or nil for colored triangles
+ *   @param vertices [String,IO::Buffer] packed vertices
+ *   @param indices [String,Array<Integer>,nil] indices into the vertex array
+ *   @return [nil]
+ *
+ *   @example draw a textured quad
+ *     vertices = [[0, 0, 0, 0], [100, 0, 1, 0], [100, 100, 1, 1], [0, 100, 0, 1]].map{|x, y, u, v|
+ *       [x, y, 255, 255, 255, 255, u, v].pack("ffCCCCff")
+ *     }.join
+ *     renderer.geometry(texture, vertices, [0, 1, 2, 0, 2, 3])
+ *
+ *   @note This method is available since SDL 2.0.18.
+ *   @see #copy_batch
+ */
+static VALUE Renderer_geometry(int argc, VALUE* argv, VALUE self)
+{
+    VALUE texture, vertices, indices, tmp = 0;
+    const SDL_Vertex* vertex_ptr;
+    const int* index_ptr = NULL;
+    size_t len;
+    long num_indices = 0;
+    PROFILE_BEGIN(start);
+
+    rb_scan_args(argc, argv, "21", &texture, &vertices, &indices);
+    if (indices != Qnil)
+        index_ptr = packed_ints(indices, 1, &num_indices, &tmp);
+    vertex_ptr = bytes_for_reading(vertices, &len);
+    if (len % sizeof(SDL_Vertex) != 0)
+        rb_raise(rb_eArgError, "packed vertices length (%ld) is not a multiple of %d",
+                 (long)len, (int)sizeof(SDL_Vertex));
+    if (len / sizeof(SDL_Vertex) > INT_MAX || num_indices > INT_MAX)
+        rb_raise(rb_eArgError, "too many vertices or indices");
+
+    HANDLE_ERROR(SDL_RenderGeometry(Get_SDL_Renderer(self),
+                                    (texture == Qnil) ? NULL : Get_SDL_Texture(texture),
+                                    vertex_ptr, (int)(len / sizeof(SDL_Vertex)),
+                                    index_ptr, (int)num_indices));
+    ALLOCV_END(tmp);
+    RB_GC_GUARD(vertices);
+    RB_GC_GUARD(indices);
+    PROFILE_END(PROFILE_RENDERER_GEOMETRY, start);
     return Qnil;
 }
+#endif
 
 /*
  * Update the screen with rendering performed
@@ -1336,10 +1611,41 @@ static VALUE Renderer_copy_ex(VALUE self, VALUE texture, VALUE srcrect, VALUE ds
  */
 static VALUE Renderer_present(VALUE self)
 {
+    PROFILE_BEGIN(start);
     SDL_RenderPresent(Get_SDL_Renderer(self));
+    PROFILE_END(PROFILE_RENDERER_PRESENT, start);
+    LATENCY_PRESENT();
     return Qnil;
 }
 
+/*
+ * Compute the area, format, and pitch used by SDL_RenderReadPixels.
+ * rect_ptr is set to NULL when rect is nil (the entire target).
+ */
+static void read_pixels_layout(SDL_Renderer* renderer, VALUE rect, VALUE format,
+                               SDL_Rect* sdl_rect, SDL_Rect** rect_ptr,
+                               Uint32* fmt, int* w, int* h, int* pitch)
+{
+    *fmt = uint32_for_format(format);
+    if (rect != Qnil) {
+        *sdl_rect = *Get_SDL_Rect(rect);
+        *rect_ptr = sdl_rect;
+        *w = sdl_rect->w;
+        *h = sdl_rect->h;
+    } else {
+        *rect_ptr = NULL;
+        HANDLE_ERROR(SDL_GetRendererOutputSize(renderer, w, h));
+    }
+
+    if (*fmt == 0) {
+        SDL_RendererInfo info;
+        HANDLE_ERROR(SDL_GetRendererInfo(renderer, &info));
+        *pitch = *w * SDL_BYTESPERPIXEL(info.texture_formats[0]);
+    } else {
+        *pitch = *w * SDL_BYTESPERPIXEL(*fmt);
+    }
+}
+
 /*
  * @overload read_pixels(rect, format)
  *   Read pixels from the current rendering target.
@@ -1354,38 +1660,75 @@ static VALUE Renderer_present(VALUE self)
  *   @param [SDL2::PixelFormat,Integer] format the desired pixel format
  *     (0 to use the format of the rendering target)
  *   @return [String] raw pixel data as a binary string
+ *
+ *   @see #read_pixels_into
  */
 static VALUE Renderer_read_pixels(VALUE self, VALUE rect, VALUE format)
 {
     SDL_Renderer* renderer = Get_SDL_Renderer(self);
     SDL_Rect sdl_rect;
-    SDL_Rect* rect_ptr = NULL;
-    Uint32 fmt = uint32_for_format(format);
+    SDL_Rect* rect_ptr;
+    Uint32 fmt;
     int w, h, pitch;
-    void* pixels;
+    VALUE pixels;
+    PROFILE_BEGIN(start);
 
-    if (rect != Qnil) {
-        sdl_rect = *Get_SDL_Rect(rect);
-        rect_ptr = &sdl_rect;
-        w = sdl_rect.w;
-        h = sdl_rect.h;
-    } else {
-        HANDLE_ERROR(SDL_GetRendererOutputSize(renderer, &w, &h));
-    }
+    read_pixels_layout(renderer, rect, format, &sdl_rect, &rect_ptr, &fmt, &w, &h, &pitch);
+    pixels = rb_str_new(NULL, (long)pitch * h);
+    HANDLE_ERROR(SDL_RenderReadPixels(renderer, rect_ptr, fmt, RSTRING_PTR(pixels), pitch));
 
-    if (fmt == 0) {
-        SDL_RendererInfo info;
-        HANDLE_ERROR(SDL_GetRendererInfo(renderer, &info));
-        pitch = w * SDL_BYTESPERPIXEL(info.texture_formats[0]);
-    } else {
-        pitch = w * SDL_BYTESPERPIXEL(fmt);
-    }
+    PROFILE_END(PROFILE_RENDERER_READ_PIXELS, start);
+    return pixels;
+}
+
+/*
+ * @overload read_pixels_into(buffer, rect=nil, format=0)
+ *   Read pixels from the current rendering target into a buffer.
+ *
+ *   Unlike {#read_pixels}, this method does not allocate any memory when
+ *   the buffer is large enough, so the same buffer can be reused for
+ *   every frame.
+ *
+ *   If **buffer** is a String, it is resized to the size of the pixel data.
+ *   If **buffer** is an IO::Buffer, it must be large enough.
+ *
+ *   @param [String,IO::Buffer] buffer the destination buffer
+ *   @param [SDL2::Rect,nil] rect the area to read, or nil for the entire target
+ *   @param [SDL2::PixelFormat,Integer] format the desired pixel format
+ *     (0 to use the format of the rendering target)
+ *   @return [Integer] the pitch (bytes per row) of the pixel data
+ *
+ *   @see #read_pixels
+ *   @see SDL2::Renderer::Capture
+ */
+static VALUE Renderer_read_pixels_into(int argc, VALUE* argv, VALUE self)
+{
+    SDL_Renderer* renderer = Get_SDL_Renderer(self);
+    VALUE buffer, rect, format;
+    SDL_Rect sdl_rect;
+    SDL_Rect* rect_ptr;
+    Uint32 fmt;
+    int w, h, pitch;
+    size_t size, len;
+    void* pixels;
+    PROFILE_BEGIN(start);
+
+    rb_scan_args(argc, argv, "12", &buffer, &rect, &format);
+    if (format == Qnil)
+        format = INT2FIX(0);
+    read_pixels_layout(renderer, rect, format, &sdl_rect, &rect_ptr, &fmt, &w, &h, &pitch);
+    size = (size_t)pitch * h;
 
-    pixels = ALLOCA_N(char, pitch * h);
+    if (RB_TYPE_P(buffer, T_STRING))
+        rb_str_resize(buffer, size);
+    pixels = bytes_for_writing(buffer, &len);
+    if (len < size)
+        rb_raise(rb_eArgError, "buffer too small (%ld for %ld)", (long)len, (long)size);
 
     HANDLE_ERROR(SDL_RenderReadPixels(renderer, rect_ptr, fmt, pixels, pitch));
-    
-    return rb_str_new(pixels, pitch * h);
+    RB_GC_GUARD(buffer);
+    PROFILE_END(PROFILE_RENDERER_READ_PIXELS, start);
+    return INT2NUM(pitch);
 }
 
 /*
@@ -1396,7 +1739,9 @@ static VALUE Renderer_read_pixels(VALUE self, VALUE rect, VALUE format)
  */
 static VALUE Renderer_clear(VALUE self)
 {
+    PROFILE_BEGIN(start);
     HANDLE_ERROR(SDL_RenderClear(Get_SDL_Renderer(self)));
+    PROFILE_END(PROFILE_RENDERER_CLEAR, start);
     return Qnil;
 }
 
@@ -1428,6 +1773,10 @@ static VALUE Renderer_draw_color(VALUE self)
  *   * {#draw_point}
  *   * {#draw_rect}
  *   * {#fill_rect}
+ *   * {#draw_lines}
+ *   * {#draw_points}
+ *   * {#draw_rects}
+ *   * {#fill_rects}
  *   * {#clear}
  *
  *   @param [Array<Integer>] color
@@ -1460,8 +1809,10 @@ static VALUE Renderer_set_draw_color(VALUE self, VALUE rgba)
  */
 static VALUE Renderer_draw_line(VALUE self, VALUE x1, VALUE y1, VALUE x2, VALUE y2)
 {
+    PROFILE_BEGIN(start);
     HANDLE_ERROR(SDL_RenderDrawLine(Get_SDL_Renderer(self),
                                     NUM2INT(x1), NUM2INT(y1), NUM2INT(x2), NUM2INT(y2)));
+    PROFILE_END(PROFILE_RENDERER_DRAW, start);
     return Qnil;
 }
 
@@ -1476,7 +1827,9 @@ static VALUE Renderer_draw_line(VALUE self, VALUE x1, VALUE y1, VALUE x2, VALUE
  */
 static VALUE Renderer_draw_point(VALUE self, VALUE x, VALUE y)
 {
+    PROFILE_BEGIN(start);
     HANDLE_ERROR(SDL_RenderDrawPoint(Get_SDL_Renderer(self), NUM2INT(x), NUM2INT(y)));
+    PROFILE_END(PROFILE_RENDERER_DRAW, start);
     return Qnil;
 }
 
@@ -1490,7 +1843,9 @@ static VALUE Renderer_draw_point(VALUE self, VALUE x, VALUE y)
  */
 static VALUE Renderer_draw_rect(VALUE self, VALUE rect)
 {
+    PROFILE_BEGIN(start);
     HANDLE_ERROR(SDL_RenderDrawRect(Get_SDL_Renderer(self), Get_SDL_Rect(rect)));
+    PROFILE_END(PROFILE_RENDERER_DRAW, start);
     return Qnil;
 }
 
@@ -1504,164 +1859,566 @@ static VALUE Renderer_draw_rect(VALUE self, VALUE rect)
  */
 static VALUE Renderer_fill_rect(VALUE self, VALUE rect)
 {
+    PROFILE_BEGIN(start);
     HANDLE_ERROR(SDL_RenderFillRect(Get_SDL_Renderer(self), Get_SDL_Rect(rect)));
+    PROFILE_END(PROFILE_RENDERER_DRAW, start);
+    return Qnil;
+}
+
+static VALUE Renderer_draw_packed_points(int (*func)(SDL_Renderer*, const SDL_Point*, int),
+                                         VALUE renderer, VALUE points)
+{
+    VALUE tmp;
+    long num;
+    const SDL_Point* ptr = packed_points(points, &num, &tmp);
+    PROFILE_BEGIN(start);
+    if (num > INT_MAX)
+        rb_raise(rb_eArgError, "too many points (%ld)", num);
+    HANDLE_ERROR(func(Get_SDL_Renderer(renderer), ptr, (int)num));
+    ALLOCV_END(tmp);
+    RB_GC_GUARD(points);
+    PROFILE_END(PROFILE_RENDERER_DRAW, start);
+    return Qnil;
+}
+
+static VALUE Renderer_draw_packed_rects(int (*func)(SDL_Renderer*, const SDL_Rect*, int),
+                                        VALUE renderer, VALUE rects)
+{
+    VALUE tmp;
+    long num;
+    const SDL_Rect* ptr = packed_rects(rects, &num, &tmp);
+    PROFILE_BEGIN(start);
+    if (num > INT_MAX)
+        rb_raise(rb_eArgError, "too many rects (%ld)", num);
+    HANDLE_ERROR(func(Get_SDL_Renderer(renderer), ptr, (int)num));
+    ALLOCV_END(tmp);
+    RB_GC_GUARD(rects);
+    PROFILE_END(PROFILE_RENDERER_DRAW, start);
     return Qnil;
 }
 
 /*
- * Get information about _self_ rendering context .
+ * @overload draw_points(points)
+ *   Draw multiple points using drawing color given by {#draw_color=}.
  *
- * @return [SDL2::Renderer::Info] rendering information
+ *   **points** is a binary string of packed (x, y) pairs of native ints
+ *   (made by Array#pack("i*")) or a flat Array of Integers
+ *   such as [x1, y1, x2, y2, ...].
+ *
+ *   @param [String,Array<Integer>] points the points to draw
+ *   @return [nil]
+ *
+ *   @see #draw_point
  */
-static VALUE Renderer_info(VALUE self)
+static VALUE Renderer_draw_points(VALUE self, VALUE points)
 {
-    SDL_RendererInfo info;
-    HANDLE_ERROR(SDL_GetRendererInfo(Get_SDL_Renderer(self), &info));
-    return RendererInfo_new(&info);
+    return Renderer_draw_packed_points(SDL_RenderDrawPoints, self, points);
 }
 
 /*
- * Get the blend mode used for drawing operations like
- * {#fill_rect} and {#draw_line}.
+ * @overload draw_lines(points)
+ *   Draw a series of connected lines using drawing color given by
+ *   {#draw_color=}.
  *
- * @return [Integer]
+ *   The format of **points** is the same as {#draw_points}.
  *
- * @see #draw_blend_mode=
- * @see SDL2::BlendMode
+ *   @param [String,Array<Integer>] points the points along the lines
+ *   @return [nil]
+ *
+ *   @see #draw_line
  */
-static VALUE Renderer_draw_blend_mode(VALUE self)
+static VALUE Renderer_draw_lines(VALUE self, VALUE points)
 {
-    SDL_BlendMode mode;
-    HANDLE_ERROR(SDL_GetRenderDrawBlendMode(Get_SDL_Renderer(self), &mode));
-    return INT2FIX(mode);
+    return Renderer_draw_packed_points(SDL_RenderDrawLines, self, points);
 }
 
 /*
- * @overload draw_blend_mode=(mode)
- *   Set the blend mode used for drawing operations.
- *
- *   This method effects the following methods.
+ * @overload draw_rects(rects)
+ *   Draw multiple rectangles using drawing color given by {#draw_color=}.
  *
- *   * {#draw_line}
- *   * {#draw_point}
- *   * {#draw_rect}
- *   * {#fill_rect}
- *   * {#clear}
+ *   **rects** is a binary string of packed (x, y, w, h) of native ints
+ *   (made by Array#pack("i*")) or a flat Array of Integers.
  *
- *   @param mode [Integer] the blending mode
- *   @return mode
+ *   @param [String,Array<Integer>] rects the rectangles to draw
+ *   @return [nil]
  *
- *   @see #draw_blend_mode
- *   @see SDL2::BlendMode
+ *   @see #draw_rect
  */
-static VALUE Renderer_set_draw_blend_mode(VALUE self, VALUE mode)
+static VALUE Renderer_draw_rects(VALUE self, VALUE rects)
 {
-    HANDLE_ERROR(SDL_SetRenderDrawBlendMode(Get_SDL_Renderer(self), NUM2INT(mode)));
-    return mode;
+    return Renderer_draw_packed_rects(SDL_RenderDrawRects, self, rects);
 }
 
 /*
- * Get the clip rectangle for the current target.
+ * @overload fill_rects(rects)
+ *   Draw multiple filled rectangles using drawing color given by {#draw_color=}.
  *
- * @return [SDL2::Rect] the current clip rectangle
- * @see #clip_rect=
+ *   The format of **rects** is the same as {#draw_rects}.
+ *
+ *   @param [String,Array<Integer>] rects the rectangles to fill
+ *   @return [nil]
+ *
+ *   @see #fill_rect
  */
-static VALUE Renderer_clip_rect(VALUE self)
+static VALUE Renderer_fill_rects(VALUE self, VALUE rects)
 {
-    VALUE rect = rb_obj_alloc(cRect);
-    SDL_RenderGetClipRect(Get_SDL_Renderer(self), Get_SDL_Rect(rect));
-    return rect;
+    return Renderer_draw_packed_rects(SDL_RenderFillRects, self, rects);
 }
 
+#if SDL_VERSION_ATLEAST(2,0,10)
 /*
- * @overload clip_rect=(rect)
+ * @overload copy_f(texture, srcrect, dstrect)
+ *   Copy a portion of the texture to the current rendering target
+ *   at subpixel precision.
  *
- *   Set the clip rectangle for the current target.
+ *   @param [SDL2::Texture] texture the source texture
+ *   @param [SDL2::Rect,nil] srcrect the source rectangle, or nil for the entire texture
+ *   @param [SDL2::FRect,nil] dstrect the destination rectangle, or nil for the entire
+ *     rendering target
+ *   @return [nil]
  *
- *   @param rect [SDL2::Rect]
- *   @return [void]
- *   @see #clip_rect
+ *   @note This method is available since SDL 2.0.10.
+ *   @see #copy
  */
-static VALUE Renderer_set_clip_rect(VALUE self, VALUE rect)
+static VALUE Renderer_copy_f(VALUE self, VALUE texture, VALUE srcrect, VALUE dstrect)
 {
-    HANDLE_ERROR(SDL_RenderSetClipRect(Get_SDL_Renderer(self), Get_SDL_Rect(rect)));
-    return rect;
+    PROFILE_BEGIN(start);
+    HANDLE_ERROR(SDL_RenderCopyF(Get_SDL_Renderer(self),
+                                 Get_SDL_Texture(texture),
+                                 Get_SDL_Rect_or_NULL(srcrect),
+                                 Get_SDL_FRect_or_NULL(dstrect)));
+    PROFILE_END(PROFILE_RENDERER_COPY, start);
+    return Qnil;
 }
 
-#if SDL_VERSION_ATLEAST(2,0,4)
 /*
- * Get whether clipping is enabled on the renderer.
+ * @overload copy_ex_f(texture, srcrect, dstrect, angle, center, flip)
+ *   Same as {#copy_ex}, but the destination rectangle and the center
+ *   are given at subpixel precision.
  *
- * @note This method is available since SDL 2.0.4.
+ *   @param [SDL2::Texture] texture the source texture
+ *   @param [SDL2::Rect,nil] srcrect the source rectangle, or nil for the entire texture
+ *   @param [SDL2::FRect,nil] dstrect the destination rectangle, or nil for the entire
+ *     rendering target
+ *   @param [Float] angle an angle in degree indicating the rotation
+ *   @param [SDL2::FPoint,nil] center the point around which dstrect will be rotated,
+ *     (if nil, rotation will be done around the center of dstrect)
+ *   @param [Integer] flip bits OR'd of the flip consntants
+ *   @return [nil]
+ *
+ *   @note This method is available since SDL 2.0.10.
+ *   @see #copy_ex
  */
-static VALUE Render_clip_enabled_p(VALUE self)
-{
-    return INT2BOOL(SDL_RenderIsClipEnabled(Get_SDL_Renderer(self)));
+static VALUE Renderer_copy_ex_f(VALUE self, VALUE texture, VALUE srcrect, VALUE dstrect,
+                                VALUE angle, VALUE center, VALUE flip)
+{
+    PROFILE_BEGIN(start);
+    HANDLE_ERROR(SDL_RenderCopyExF(Get_SDL_Renderer(self),
+                                   Get_SDL_Texture(texture),
+                                   Get_SDL_Rect_or_NULL(srcrect),
+                                   Get_SDL_FRect_or_NULL(dstrect),
+                                   NUM2DBL(angle),
+                                   Get_SDL_FPoint_or_NULL(center),
+                                   NUM2INT(flip)));
+    PROFILE_END(PROFILE_RENDERER_COPY_EX, start);
+    return Qnil;
 }
-#endif
 
 /*
- * Get device indepndent resolution for rendering.
+ * @overload copy_batch_f(texture, srcrects, dstrects)
+ *   Copy many portions of the texture to the current rendering target
+ *   at subpixel precision at once.
  *
- * @return [Array(Integer, Integer)] the logical width and height
- * @see #logical_size=
+ *   **dstrects** is a binary string of rectangles packed by Array#pack("f*")
+ *   (x, y, w, h for each rectangle) or a flat Array of Numerics.
+ *
+ *   **srcrects** is one of the followings:
+ *
+ *   * nil - the entire texture is used for all copies
+ *   * {SDL2::Rect} - the same source rectangle is used for all copies
+ *   * packed ints (String or Array, see {#copy_batch}) - one source rectangle
+ *     for each destination rectangle
+ *
+ *   @param [SDL2::Texture] texture the source texture
+ *   @param [nil,SDL2::Rect,String,Array<Integer>] srcrects the source rectangles
+ *   @param [String,Array<Numeric>] dstrects the destination rectangles
+ *   @return [nil]
+ *
+ *   @note This method is available since SDL 2.0.10.
+ *   @see #copy_batch
+ *   @see #copy_f
  */
-static VALUE Renderer_logical_size(VALUE self)
+static VALUE Renderer_copy_batch_f(VALUE self, VALUE texture, VALUE srcrects, VALUE dstrects)
 {
-    int w, h;
-    SDL_RenderGetLogicalSize(Get_SDL_Renderer(self), &w, &h);
-    return rb_ary_new3(2, INT2FIX(w), INT2FIX(h));
+    SDL_Renderer* renderer = Get_SDL_Renderer(self);
+    SDL_Texture* sdl_texture = Get_SDL_Texture(texture);
+    VALUE src_tmp = 0, dst_tmp;
+    const SDL_Rect* src = NULL;
+    const SDL_FRect* dst;
+    long num_src = 0, num_dst, i;
+    int per_copy_src = 0;
+    PROFILE_BEGIN(start);
+
+    if (rb_obj_is_kind_of(srcrects, cRect)) {
+        src = Get_SDL_Rect(srcrects);
+    } else if (srcrects != Qnil) {
+        src = packed_rects(srcrects, &num_src, &src_tmp);
+        per_copy_src = 1;
+    }
+    dst = packed_frects(dstrects, &num_dst, &dst_tmp);
+    if (per_copy_src && num_src != num_dst) {
+        ALLOCV_END(src_tmp);
+        ALLOCV_END(dst_tmp);
+        rb_raise(rb_eArgError, "number of source rects (%ld) differs from destination rects (%ld)",
+                 num_src, num_dst);
+    }
+
+    for (i=0; i<num_dst; ++i)
+        HANDLE_ERROR(SDL_RenderCopyF(renderer, sdl_texture,
+                                     per_copy_src ? &src[i] : src, &dst[i]));
+
+    ALLOCV_END(src_tmp);
+    ALLOCV_END(dst_tmp);
+    RB_GC_GUARD(srcrects);
+    RB_GC_GUARD(dstrects);
+    PROFILE_END(PROFILE_RENDERER_COPY_BATCH, start);
+    return Qnil;
 }
 
 /*
- * @overload logical_size=(w_and_h)
+ * @overload draw_point_f(x, y)
+ *   Draw a point at (x, y) at subpixel precision.
  *
- *   Set a device indepndent resolution for rendering.
+ *   @param [Float] x the x coordinate of the point
+ *   @param [Float] y the y coordinate of the point
+ *   @return [nil]
  *
- *   @param w_and_h [Array(Integer, Integer)] the width and height of the logical resolution
- *   @return [void]
- *   @see #logical_size
+ *   @note This method is available since SDL 2.0.10.
+ *   @see #draw_point
  */
-static VALUE Renderer_set_logical_size(VALUE self, VALUE wh)
+static VALUE Renderer_draw_point_f(VALUE self, VALUE x, VALUE y)
 {
-    HANDLE_ERROR(SDL_RenderSetLogicalSize(Get_SDL_Renderer(self),
-                                          NUM2DBL(rb_ary_entry(wh, 0)),
-                                          NUM2DBL(rb_ary_entry(wh, 1))));
-    return wh;
+    PROFILE_BEGIN(start);
+    HANDLE_ERROR(SDL_RenderDrawPointF(Get_SDL_Renderer(self), NUM2DBL(x), NUM2DBL(y)));
+    PROFILE_END(PROFILE_RENDERER_DRAW, start);
+    return Qnil;
 }
 
 /*
- * Get the drawing scale for the current target.
+ * @overload draw_line_f(x1, y1, x2, y2)
+ *   Draw a line from (x1, y1) to (x2, y2) at subpixel precision.
  *
- * @return [Array(Integer, Integer)] horizontal and vertical scale factor
- * @see #scale=
+ *   @param [Float] x1 the x coordinate of the start point
+ *   @param [Float] y1 the y coordinate of the start point
+ *   @param [Float] x2 the x coordinate of the end point
+ *   @param [Float] y2 the y coordinate of the end point
+ *   @return [nil]
+ *
+ *   @note This method is available since SDL 2.0.10.
+ *   @see #draw_line
  */
-static VALUE Renderer_scale(VALUE self)
+static VALUE Renderer_draw_line_f(VALUE self, VALUE x1, VALUE y1, VALUE x2, VALUE y2)
 {
-    float scaleX, scaleY;
-    SDL_RenderGetScale(Get_SDL_Renderer(self), &scaleX, &scaleY);
-    return rb_ary_new3(2, DBL2NUM(scaleX), DBL2NUM(scaleY));
+    PROFILE_BEGIN(start);
+    HANDLE_ERROR(SDL_RenderDrawLineF(Get_SDL_Renderer(self),
+                                     NUM2DBL(x1), NUM2DBL(y1), NUM2DBL(x2), NUM2DBL(y2)));
+    PROFILE_END(PROFILE_RENDERER_DRAW, start);
+    return Qnil;
 }
 
 /*
- * @overload scale=(scaleX_and_scaleY)
- *
- *   Set the drawing scale for rendering.
+ * @overload draw_rect_f(rect)
+ *   Draw a rectangle at subpixel precision.
  *
- *   The drawing coordinates are scaled by the x/y scaling factors before they are used by the renderer.
- *   This allows resolution independent drawing with a single coordinate system.
- *
- *   If this results in scaling or subpixel drawing by the rendering backend,
- *   it will be handled using the appropriate
- *   quality hints. For best results use integer scaling factors.
+ *   @param [SDL2::FRect] rect the drawing rectangle
+ *   @return [nil]
  *
- *   @param scaleX_and_scaleY [Array(Float, Float)] the horizontal and vertical scaling factors
- *   @return [void]
- *   @see #scale
+ *   @note This method is available since SDL 2.0.10.
+ *   @see #draw_rect
  */
-static VALUE Renderer_set_scale(VALUE self, VALUE xy)
+static VALUE Renderer_draw_rect_f(VALUE self, VALUE rect)
 {
-    float scaleX, scaleY;
+    PROFILE_BEGIN(start);
+    HANDLE_ERROR(SDL_RenderDrawRectF(Get_SDL_Renderer(self), Get_SDL_FRect(rect)));
+    PROFILE_END(PROFILE_RENDERER_DRAW, start);
+    return Qnil;
+}
+
+/*
+ * @overload fill_rect_f(rect)
+ *   Draw a filled rectangle at subpixel precision.
+ *
+ *   @param [SDL2::FRect] rect the drawing rectangle
+ *   @return [nil]
+ *
+ *   @note This method is available since SDL 2.0.10.
+ *   @see #fill_rect
+ */
+static VALUE Renderer_fill_rect_f(VALUE self, VALUE rect)
+{
+    PROFILE_BEGIN(start);
+    HANDLE_ERROR(SDL_RenderFillRectF(Get_SDL_Renderer(self), Get_SDL_FRect(rect)));
+    PROFILE_END(PROFILE_RENDERER_DRAW, start);
+    return Qnil;
+}
+
+static VALUE Renderer_draw_packed_fpoints(int (*func)(SDL_Renderer*, const SDL_FPoint*, int),
+                                          VALUE renderer, VALUE points)
+{
+    VALUE tmp;
+    long num;
+    const SDL_FPoint* ptr = packed_fpoints(points, &num, &tmp);
+    PROFILE_BEGIN(start);
+    if (num > INT_MAX)
+        rb_raise(rb_eArgError, "too many points (%ld)", num);
+    HANDLE_ERROR(func(Get_SDL_Renderer(renderer), ptr, (int)num));
+    ALLOCV_END(tmp);
+    RB_GC_GUARD(points);
+    PROFILE_END(PROFILE_RENDERER_DRAW, start);
+    return Qnil;
+}
+
+static VALUE Renderer_draw_packed_frects(int (*func)(SDL_Renderer*, const SDL_FRect*, int),
+                                         VALUE renderer, VALUE rects)
+{
+    VALUE tmp;
+    long num;
+    const SDL_FRect* ptr = packed_frects(rects, &num, &tmp);
+    PROFILE_BEGIN(start);
+    if (num > INT_MAX)
+        rb_raise(rb_eArgError, "too many rects (%ld)", num);
+    HANDLE_ERROR(func(Get_SDL_Renderer(renderer), ptr, (int)num));
+    ALLOCV_END(tmp);
+    RB_GC_GUARD(rects);
+    PROFILE_END(PROFILE_RENDERER_DRAW, start);
+    return Qnil;
+}
+
+/*
+ * @overload draw_points_f(points)
+ *   Draw multiple points at subpixel precision.
+ *
+ *   **points** is a binary string of (x, y) packed by Array#pack("f*")
+ *   or a flat Array of Numerics.
+ *
+ *   @param [String,Array<Numeric>] points the points to draw
+ *   @return [nil]
+ *
+ *   @note This method is available since SDL 2.0.10.
+ *   @see #draw_points
+ */
+static VALUE Renderer_draw_points_f(VALUE self, VALUE points)
+{
+    return Renderer_draw_packed_fpoints(SDL_RenderDrawPointsF, self, points);
+}
+
+/*
+ * @overload draw_lines_f(points)
+ *   Draw a series of connected lines at subpixel precision.
+ *
+ *   The format of **points** is the same as {#draw_points_f}.
+ *
+ *   @param [String,Array<Numeric>] points the points along the lines
+ *   @return [nil]
+ *
+ *   @note This method is available since SDL 2.0.10.
+ *   @see #draw_lines
+ */
+static VALUE Renderer_draw_lines_f(VALUE self, VALUE points)
+{
+    return Renderer_draw_packed_fpoints(SDL_RenderDrawLinesF, self, points);
+}
+
+/*
+ * @overload draw_rects_f(rects)
+ *   Draw multiple rectangles at subpixel precision.
+ *
+ *   **rects** is a binary string of (x, y, w, h) packed by Array#pack("f*")
+ *   or a flat Array of Numerics.
+ *
+ *   @param [String,Array<Numeric>] rects the rectangles to draw
+ *   @return [nil]
+ *
+ *   @note This method is available since SDL 2.0.10.
+ *   @see #draw_rects
+ */
+static VALUE Renderer_draw_rects_f(VALUE self, VALUE rects)
+{
+    return Renderer_draw_packed_frects(SDL_RenderDrawRectsF, self, rects);
+}
+
+/*
+ * @overload fill_rects_f(rects)
+ *   Draw multiple filled rectangles at subpixel precision.
+ *
+ *   The format of **rects** is the same as {#draw_rects_f}.
+ *
+ *   @param [String,Array<Numeric>] rects the rectangles to fill
+ *   @return [nil]
+ *
+ *   @note This method is available since SDL 2.0.10.
+ *   @see #fill_rects
+ */
+static VALUE Renderer_fill_rects_f(VALUE self, VALUE rects)
+{
+    return Renderer_draw_packed_frects(SDL_RenderFillRectsF, self, rects);
+}
+#endif
+
+/*
+ * Get information about _self_ rendering context .
+ *
+ * @return [SDL2::Renderer::Info] rendering information
+ */
+static VALUE Renderer_info(VALUE self)
+{
+    SDL_RendererInfo info;
+    HANDLE_ERROR(SDL_GetRendererInfo(Get_SDL_Renderer(self), &info));
+    return RendererInfo_new(&info);
+}
+
+/*
+ * Get the blend mode used for drawing operations like
+ * {#fill_rect} and {#draw_line}.
+ *
+ * @return [Integer]
+ *
+ * @see #draw_blend_mode=
+ * @see SDL2::BlendMode
+ */
+static VALUE Renderer_draw_blend_mode(VALUE self)
+{
+    SDL_BlendMode mode;
+    HANDLE_ERROR(SDL_GetRenderDrawBlendMode(Get_SDL_Renderer(self), &mode));
+    return INT2FIX(mode);
+}
+
+/*
+ * @overload draw_blend_mode=(mode)
+ *   Set the blend mode used for drawing operations.
+ *
+ *   This method effects the following methods.
+ *
+ *   * {#draw_line}
+ *   * {#draw_point}
+ *   * {#draw_rect}
+ *   * {#fill_rect}
+ *   * {#clear}
+ *
+ *   @param mode [Integer] the blending mode
+ *   @return mode
+ *
+ *   @see #draw_blend_mode
+ *   @see SDL2::BlendMode
+ */
+static VALUE Renderer_set_draw_blend_mode(VALUE self, VALUE mode)
+{
+    HANDLE_ERROR(SDL_SetRenderDrawBlendMode(Get_SDL_Renderer(self), NUM2INT(mode)));
+    return mode;
+}
+
+/*
+ * Get the clip rectangle for the current target.
+ *
+ * @return [SDL2::Rect] the current clip rectangle
+ * @see #clip_rect=
+ */
+static VALUE Renderer_clip_rect(VALUE self)
+{
+    VALUE rect = rb_obj_alloc(cRect);
+    SDL_RenderGetClipRect(Get_SDL_Renderer(self), Get_SDL_Rect(rect));
+    return rect;
+}
+
+/*
+ * @overload clip_rect=(rect)
+ *
+ *   Set the clip rectangle for the current target.
+ *
+ *   @param rect [SDL2::Rect]
+ *   @return [void]
+ *   @see #clip_rect
+ */
+static VALUE Renderer_set_clip_rect(VALUE self, VALUE rect)
+{
+    HANDLE_ERROR(SDL_RenderSetClipRect(Get_SDL_Renderer(self), Get_SDL_Rect(rect)));
+    return rect;
+}
+
+#if SDL_VERSION_ATLEAST(2,0,4)
+/*
+ * Get whether clipping is enabled on the renderer.
+ *
+ * @note This method is available since SDL 2.0.4.
+ */
+static VALUE Render_clip_enabled_p(VALUE self)
+{
+    return INT2BOOL(SDL_RenderIsClipEnabled(Get_SDL_Renderer(self)));
+}
+#endif
+
+/*
+ * Get device indepndent resolution for rendering.
+ *
+ * @return [Array(Integer, Integer)] the logical width and height
+ * @see #logical_size=
+ */
+static VALUE Renderer_logical_size(VALUE self)
+{
+    int w, h;
+    SDL_RenderGetLogicalSize(Get_SDL_Renderer(self), &w, &h);
+    return rb_ary_new3(2, INT2FIX(w), INT2FIX(h));
+}
+
+/*
+ * @overload logical_size=(w_and_h)
+ *
+ *   Set a device indepndent resolution for rendering.
+ *
+ *   @param w_and_h [Array(Integer, Integer)] the width and height of the logical resolution
+ *   @return [void]
+ *   @see #logical_size
+ */
+static VALUE Renderer_set_logical_size(VALUE self, VALUE wh)
+{
+    HANDLE_ERROR(SDL_RenderSetLogicalSize(Get_SDL_Renderer(self),
+                                          NUM2DBL(rb_ary_entry(wh, 0)),
+                                          NUM2DBL(rb_ary_entry(wh, 1))));
+    return wh;
+}
+
+/*
+ * Get the drawing scale for the current target.
+ *
+ * @return [Array(Integer, Integer)] horizontal and vertical scale factor
+ * @see #scale=
+ */
+static VALUE Renderer_scale(VALUE self)
+{
+    float scaleX, scaleY;
+    SDL_RenderGetScale(Get_SDL_Renderer(self), &scaleX, &scaleY);
+    return rb_ary_new3(2, DBL2NUM(scaleX), DBL2NUM(scaleY));
+}
+
+/*
+ * @overload scale=(scaleX_and_scaleY)
+ *
+ *   Set the drawing scale for rendering.
+ *
+ *   The drawing coordinates are scaled by the x/y scaling factors before they are used by the renderer.
+ *   This allows resolution independent drawing with a single coordinate system.
+ *
+ *   If this results in scaling or subpixel drawing by the rendering backend,
+ *   it will be handled using the appropriate
+ *   quality hints. For best results use integer scaling factors.
+ *
+ *   @param scaleX_and_scaleY [Array(Float, Float)] the horizontal and vertical scaling factors
+ *   @return [void]
+ *   @see #scale
+ */
+static VALUE Renderer_set_scale(VALUE self, VALUE xy)
+{
+    float scaleX, scaleY;
     scaleX = NUM2DBL(rb_ary_entry(xy, 0));
     scaleY = NUM2DBL(rb_ary_entry(xy, 1));
     HANDLE_ERROR(SDL_RenderSetScale(Get_SDL_Renderer(self), scaleX, scaleY));
@@ -1669,121 +2426,1004 @@ static VALUE Renderer_set_scale(VALUE self, VALUE xy)
 }
 
 /*
- * Get the drawing area for the current target.
- *
- * @return [SDL2::Rect] the current drawing area
- * @see #viewport=
+ * Get the drawing area for the current target.
+ *
+ * @return [SDL2::Rect] the current drawing area
+ * @see #viewport=
+ */
+static VALUE Renderer_viewport(VALUE self)
+{
+    VALUE rect = rb_obj_alloc(cRect);
+    SDL_RenderGetViewport(Get_SDL_Renderer(self), Get_SDL_Rect(rect));
+    return rect;
+}
+
+/*
+ * @overload viewport=(area)
+ *   Set the drawing area for rendering on the current target.
+ *
+ *   @param area [SDL2::Rect,nil] the drawing area, or nil to set the viewport to the entire target
+ *   @return [void]
+ *   @see #viewport
+ */
+static VALUE Renderer_set_viewport(VALUE self, VALUE rect)
+{
+    HANDLE_ERROR(SDL_RenderSetViewport(Get_SDL_Renderer(self), Get_SDL_Rect_or_NULL(rect)));
+    return rect;
+}
+
+/*
+ * Return true if the renderer supports render target.
+ *
+ * @see #render_target=
+ */
+static VALUE Renderer_support_render_target_p(VALUE self)
+{
+    return INT2BOOL(SDL_RenderTargetSupported(Get_SDL_Renderer(self)));
+}
+
+/*
+ * Get the output size of a rendering context.
+ *
+ * @return [Array(Integer, Integer)] the width and the height
+ */
+static VALUE Renderer_output_size(VALUE self)
+{
+    int w, h;
+    HANDLE_ERROR(SDL_GetRendererOutputSize(Get_SDL_Renderer(self), &w, &h));
+    return rb_ary_new3(2, INT2FIX(w), INT2FIX(h));
+}
+
+/*
+ * @overload render_target=(target)
+ *  Set a texture as the current render target.
+ *
+ *  Some renderers have ability to render to a texture instead of a screen.
+ *  You can judge whether your renderer has this ability using
+ *  {#support_render_target?}.
+ *
+ *  The target texture musbe be {#create_texture created} with the
+ *  {SDL2::Texture::ACCESS_TARGET} flag.
+ *
+ *  @param [SDL2::Texture,nil] target the targeted texture, or nil
+ *    for the default render target(i.e. screen)
+ *
+ *  @return [void]
+ *
+ *  @see #render_target
+ */
+static VALUE Renderer_set_render_target(VALUE self, VALUE target)
+{
+    HANDLE_ERROR(SDL_SetRenderTarget(Get_SDL_Renderer(self),
+                                     (target == Qnil) ? NULL : Get_SDL_Texture(target)));
+    rb_iv_set(self, "render_target", target);
+    return target;
+}
+
+/*
+ * Get the current render target.
+ *
+ * @return [SDL2::Texture] the current rendering target
+ * @return [nil] for the default render target (i.e. screen)
+ *
+ * @see #render_target=
+ * @see #support_render_target?
+ */
+static VALUE Renderer_render_target(VALUE self)
+{
+    return rb_iv_get(self, "render_target");
+}
+
+/*
+ * Reset the render target to the screen.
+ *
+ * @return [nil]
+ */
+static VALUE Renderer_reset_render_target(VALUE self)
+{
+    return Renderer_set_render_target(self, Qnil);
+}
+
+/* @return [Hash<String=>Object>] (GC) debug information */
+static VALUE Renderer_debug_info(VALUE self)
+{
+    Renderer* r = Get_Renderer(self);
+    VALUE info = rb_hash_new();
+    int num_active_textures = 0;
+    int i;
+    rb_hash_aset(info, rb_str_new2("destroy?"), INT2BOOL(r->renderer == NULL));
+    rb_hash_aset(info, rb_str_new2("max_textures"), INT2NUM(r->max_textures));
+    rb_hash_aset(info, rb_str_new2("num_textures"), INT2NUM(r->num_textures));
+    for (i=0; i<r->num_textures; ++i)
+        if (r->textures[i]->texture)
+            ++num_active_textures;
+    rb_hash_aset(info, rb_str_new2("num_active_textures"), INT2NUM(num_active_textures));
+    rb_hash_aset(info, rb_str_new2("refcount"), INT2NUM(r->refcount));
+
+    return info;
+}
+
+/*
+ * Document-class: SDL2::Renderer::Capture
+ *
+ * This class captures frames from a rendering target into a ring
+ * of preallocated buffers.
+ *
+ * {#capture} reads the pixels of the current frame into the next buffer
+ * of the ring without any allocation. When a writer is {#start_writer started},
+ * captured frames are written to a file by a native thread which runs
+ * without the GVL, so encoding and disk I/O do not stall the rendering loop.
+ * {#capture} only blocks when all buffers of the ring are waiting for the writer.
+ *
+ * The written file is the raw pixel data of captured frames concatenated
+ * in order; each frame is {#frame_size} bytes long and each row is
+ * {#pitch} bytes long.
+ *
+ * Call {#stop_writer} to finish writing. If the object is garbage collected
+ * while the writer is running, the writer thread stops without waiting for
+ * the disk, and the frames which are not written yet are discarded.
+ *
+ * @example
+ *   capture = SDL2::Renderer::Capture.new(renderer, nil, SDL2::PixelFormat::RGBA8888, 4)
+ *   capture.start_writer("frames.raw")
+ *   loop do
+ *     # draw the frame ...
+ *     capture.capture
+ *     renderer.present
+ *   end
+ *   capture.stop_writer
+ *
+ * @!attribute [r] w
+ *   @return [Integer] the width of captured frames
+ * @!attribute [r] h
+ *   @return [Integer] the height of captured frames
+ * @!attribute [r] pitch
+ *   @return [Integer] the number of bytes of a row of captured frames
+ * @!attribute [r] frame_size
+ *   @return [Integer] the number of bytes of a captured frame
+ * @!attribute [r] num_buffers
+ *   @return [Integer] the number of buffers in the ring
+ */
+typedef struct Capture {
+    Uint32 format;
+    SDL_Rect rect;
+    int use_rect;
+    int w;
+    int h;
+    int pitch;
+    size_t frame_size;
+    int num_buffers;
+    char** buffers;
+    /* The followings are shared with the writer thread, protected by mutex */
+    SDL_mutex* mutex;
+    SDL_cond* cond;
+    Uint64 captured;
+    Uint64 written;
+    int stopping;
+    int abandoned; /* garbage collected while writing; the writer frees the struct */
+    int interrupted;
+    int write_error;
+    FILE* fp;
+    SDL_Thread* writer;
+} Capture;
+
+static void Capture_destroy(Capture* c)
+{
+    int i;
+    if (c->fp)
+        fclose(c->fp);
+    for (i=0; i<c->num_buffers; ++i)
+        free(c->buffers[i]);
+    free(c->buffers);
+    if (c->cond)
+        SDL_DestroyCond(c->cond);
+    if (c->mutex)
+        SDL_DestroyMutex(c->mutex);
+    free(c);
+}
+
+/*
+ * Never wait for the writer here; pending writes may take long.
+ * The writer is told to stop and takes over freeing the struct.
+ */
+static void Capture_free(Capture* c)
+{
+    if (c->writer) {
+        SDL_LockMutex(c->mutex);
+        c->stopping = c->abandoned = 1;
+        SDL_CondBroadcast(c->cond);
+        SDL_UnlockMutex(c->mutex);
+        SDL_DetachThread(c->writer);
+        return;
+    }
+    Capture_destroy(c);
+}
+
+DEFINE_DATA_TYPE(Capture, Capture_free);
+DEFINE_GETTER(static, Capture, cRendererCapture, "SDL2::Renderer::Capture");
+
+static VALUE Capture_s_allocate(VALUE klass)
+{
+    Capture* c;
+    VALUE obj = TypedData_Make_Struct(klass, Capture, &Capture_data_type, c);
+    c->num_buffers = 0;
+    c->buffers = NULL;
+    c->mutex = NULL;
+    c->cond = NULL;
+    c->captured = c->written = 0;
+    c->stopping = c->abandoned = c->interrupted = c->write_error = 0;
+    c->fp = NULL;
+    c->writer = NULL;
+    return obj;
+}
+
+/*
+ * @overload initialize(renderer, rect=nil, format=0, num_buffers=3)
+ *   Create a new capture object and allocate the ring of buffers.
+ *
+ *   The size of the captured area is fixed at this point.
+ *
+ *   @param [SDL2::Renderer] renderer the renderer to capture
+ *   @param [SDL2::Rect,nil] rect the area to read, or nil for the entire target
+ *   @param [SDL2::PixelFormat,Integer] format the desired pixel format
+ *     (0 to use the format of the rendering target)
+ *   @param [Integer] num_buffers the number of buffers in the ring
+ */
+static VALUE Capture_initialize(int argc, VALUE* argv, VALUE self)
+{
+    Capture* c = Get_Capture(self);
+    VALUE renderer, rect, format, num_buffers;
+    SDL_Rect* rect_ptr;
+    int i, n;
+
+    rb_scan_args(argc, argv, "13", &renderer, &rect, &format, &num_buffers);
+    if (format == Qnil)
+        format = INT2FIX(0);
+    n = (num_buffers == Qnil) ? 3 : NUM2INT(num_buffers);
+    if (n < 1)
+        rb_raise(rb_eArgError, "num_buffers must be positive");
+    if (c->buffers)
+        rb_raise(rb_eRuntimeError, "already initialized");
+
+    read_pixels_layout(Get_SDL_Renderer(renderer), rect, format,
+                       &c->rect, &rect_ptr, &c->format, &c->w, &c->h, &c->pitch);
+    c->use_rect = (rect_ptr != NULL);
+    c->frame_size = (size_t)c->pitch * c->h;
+
+    c->mutex = SDL_CreateMutex();
+    c->cond = SDL_CreateCond();
+    if (!c->mutex || !c->cond)
+        SDL_ERROR();
+
+    c->buffers = ALLOC_N(char*, n);
+    for (i=0; i<n; ++i)
+        c->buffers[i] = NULL;
+    c->num_buffers = n;
+    for (i=0; i<n; ++i)
+        c->buffers[i] = ALLOC_N(char, c->frame_size);
+
+    rb_iv_set(self, "@renderer", renderer);
+    return Qnil;
+}
+
+static int Capture_writer_thread(void* data)
+{
+    Capture* c = data;
+    int abandoned;
+
+    SDL_LockMutex(c->mutex);
+    for (;;) {
+        const char* frame;
+        while (c->written == c->captured && !c->stopping)
+            SDL_CondWait(c->cond, c->mutex);
+        if (c->written == c->captured || c->abandoned)
+            break;
+        frame = c->buffers[c->written % c->num_buffers];
+        SDL_UnlockMutex(c->mutex);
+
+        if (!c->write_error && fwrite(frame, 1, c->frame_size, c->fp) != c->frame_size)
+            c->write_error = errno ? errno : EIO;
+
+        SDL_LockMutex(c->mutex);
+        c->written++;
+        SDL_CondBroadcast(c->cond);
+    }
+    abandoned = c->abandoned;
+    SDL_UnlockMutex(c->mutex);
+    if (abandoned)
+        Capture_destroy(c);
+    return 0;
+}
+
+/* Wait until a buffer of the ring is free; called without the GVL */
+static void* Capture_wait_for_buffer(void* data)
+{
+    Capture* c = data;
+    SDL_LockMutex(c->mutex);
+    while (c->captured - c->written >= (Uint64)c->num_buffers && !c->interrupted)
+        SDL_CondWait(c->cond, c->mutex);
+    c->interrupted = 0;
+    SDL_UnlockMutex(c->mutex);
+    return NULL;
+}
+
+static void Capture_unblock(void* data)
+{
+    Capture* c = data;
+    SDL_LockMutex(c->mutex);
+    c->interrupted = 1;
+    SDL_CondBroadcast(c->cond);
+    SDL_UnlockMutex(c->mutex);
+}
+
+static int Capture_ring_full(Capture* c)
+{
+    int full;
+    SDL_LockMutex(c->mutex);
+    full = c->fp && c->captured - c->written >= (Uint64)c->num_buffers;
+    SDL_UnlockMutex(c->mutex);
+    return full;
+}
+
+static Capture* Get_initialized_Capture(VALUE self)
+{
+    Capture* c = Get_Capture(self);
+    if (!c->buffers)
+        rb_raise(rb_eRuntimeError, "SDL2::Renderer::Capture is not initialized");
+    return c;
+}
+
+/*
+ * Read the pixels of the current rendering target into the next buffer
+ * of the ring.
+ *
+ * If the writer is running and all buffers are waiting for it, this method
+ * waits (without the GVL) until a buffer is written.
+ *
+ * @return [Integer] the sequence number of the captured frame (starting at 0)
+ * @see #frame
+ */
+static VALUE Capture_capture(VALUE self)
+{
+    Capture* c = Get_initialized_Capture(self);
+    SDL_Renderer* renderer = Get_SDL_Renderer(rb_iv_get(self, "@renderer"));
+    Uint64 seq;
+    PROFILE_BEGIN(start);
+
+    while (Capture_ring_full(c)) {
+        rb_thread_call_without_gvl(Capture_wait_for_buffer, c, Capture_unblock, c);
+        rb_thread_check_ints();
+    }
+
+    seq = c->captured;
+    HANDLE_ERROR(SDL_RenderReadPixels(renderer, c->use_rect ? &c->rect : NULL, c->format,
+                                      c->buffers[seq % c->num_buffers], c->pitch));
+
+    SDL_LockMutex(c->mutex);
+    c->captured++;
+    SDL_CondBroadcast(c->cond);
+    SDL_UnlockMutex(c->mutex);
+
+    PROFILE_END(PROFILE_RENDERER_READ_PIXELS, start);
+    return ULL2NUM(seq);
+}
+
+/*
+ * @overload frame(seq=nil, buffer=nil)
+ *   Get a captured frame which is still in the ring.
+ *
+ *   @param [Integer,nil] seq the sequence number returned by {#capture},
+ *     or nil for the latest frame
+ *   @param [String,IO::Buffer,nil] buffer the buffer to copy the frame into,
+ *     or nil to return a new String
+ *   @return [String,IO::Buffer] the pixel data
+ *   @return [nil] if the frame is not captured yet or is already overwritten
+ */
+static VALUE Capture_frame(int argc, VALUE* argv, VALUE self)
+{
+    Capture* c = Get_initialized_Capture(self);
+    VALUE seq, buffer;
+    Uint64 n;
+    const char* frame;
+
+    rb_scan_args(argc, argv, "02", &seq, &buffer);
+    if (c->captured == 0)
+        return Qnil;
+    n = (seq == Qnil) ? c->captured - 1 : NUM2ULL(seq);
+    if (n >= c->captured || c->captured - n > (Uint64)c->num_buffers)
+        return Qnil;
+    frame = c->buffers[n % c->num_buffers];
+
+    if (buffer == Qnil) {
+        return rb_str_new(frame, c->frame_size);
+    } else {
+        size_t len;
+        void* dst;
+        if (RB_TYPE_P(buffer, T_STRING))
+            rb_str_resize(buffer, c->frame_size);
+        dst = bytes_for_writing(buffer, &len);
+        if (len < c->frame_size)
+            rb_raise(rb_eArgError, "buffer too small (%ld for %ld)",
+                     (long)len, (long)c->frame_size);
+        memcpy(dst, frame, c->frame_size);
+        return buffer;
+    }
+}
+
+/*
+ * @overload start_writer(path)
+ *   Start a native thread writing frames captured after this call to the file.
+ *
+ *   @param [String] path the path of the output file (truncated if exists)
+ *   @return [nil]
+ *
+ *   @see #stop_writer
+ */
+static VALUE Capture_start_writer(VALUE self, VALUE path)
+{
+    Capture* c = Get_initialized_Capture(self);
+    FILE* fp;
+
+    if (c->writer || c->fp)
+        rb_raise(rb_eRuntimeError, "writer is already running");
+    fp = fopen(StringValueCStr(path), "wb");
+    if (!fp)
+        rb_sys_fail_str(path);
+
+    SDL_LockMutex(c->mutex);
+    c->written = c->captured;
+    c->stopping = 0;
+    c->write_error = 0;
+    SDL_UnlockMutex(c->mutex);
+
+    c->fp = fp;
+    c->writer = SDL_CreateThread(Capture_writer_thread, "rubysdl2-capture", c);
+    if (!c->writer) {
+        fclose(fp);
+        c->fp = NULL;
+        SDL_ERROR();
+    }
+    return Qnil;
+}
+
+static void* Capture_wait_writer(void* writer)
+{
+    SDL_WaitThread(writer, NULL);
+    return NULL;
+}
+
+/*
+ * Write all pending frames, stop the writer thread, and close the file.
+ *
+ * This method waits for the pending frames without the GVL, and
+ * cannot be interrupted (e.g. by Thread#raise) while waiting.
+ *
+ * @raise [SystemCallError] raised if writing to the file failed
+ * @return [nil]
+ */
+static VALUE Capture_stop_writer(VALUE self)
+{
+    Capture* c = Get_initialized_Capture(self);
+    SDL_Thread* writer = c->writer;
+    FILE* fp;
+
+    if (!writer)
+        return Qnil;
+    /*
+     * Clear the handle before releasing the GVL so that only this call joins
+     * the thread. c->fp stays set until the file is closed, which keeps
+     * #start_writer from reusing the struct and #capture waiting for the writer.
+     */
+    c->writer = NULL;
+    SDL_LockMutex(c->mutex);
+    c->stopping = 1;
+    SDL_CondBroadcast(c->cond);
+    SDL_UnlockMutex(c->mutex);
+    rb_thread_call_without_gvl(Capture_wait_writer, writer, NULL, NULL);
+
+    fp = c->fp;
+    c->fp = NULL;
+    if (fclose(fp) != 0 && !c->write_error)
+        c->write_error = errno;
+    if (c->write_error)
+        rb_syserr_fail(c->write_error, "SDL2::Renderer::Capture#stop_writer");
+    return Qnil;
+}
+
+/* @return [Boolean] true if the writer thread is running */
+static VALUE Capture_writer_p(VALUE self)
+{
+    return INT2BOOL(Get_Capture(self)->writer != NULL);
+}
+
+/* @return [Integer] the number of captured frames */
+static VALUE Capture_captured(VALUE self)
+{
+    return ULL2NUM(Get_Capture(self)->captured);
+}
+
+/* @return [Integer] the number of frames which are captured but not written yet */
+static VALUE Capture_pending(VALUE self)
+{
+    Capture* c = Get_Capture(self);
+    Uint64 pending;
+    if (!c->fp)
+        return INT2FIX(0);
+    SDL_LockMutex(c->mutex);
+    pending = c->captured - c->written;
+    SDL_UnlockMutex(c->mutex);
+    return ULL2NUM(pending);
+}
+
+static VALUE Capture_w(VALUE self)
+{
+    return INT2NUM(Get_initialized_Capture(self)->w);
+}
+
+static VALUE Capture_h(VALUE self)
+{
+    return INT2NUM(Get_initialized_Capture(self)->h);
+}
+
+static VALUE Capture_pitch(VALUE self)
+{
+    return INT2NUM(Get_initialized_Capture(self)->pitch);
+}
+
+static VALUE Capture_frame_size(VALUE self)
+{
+    return SIZET2NUM(Get_initialized_Capture(self)->frame_size);
+}
+
+static VALUE Capture_num_buffers(VALUE self)
+{
+    return INT2NUM(Get_Capture(self)->num_buffers);
+}
+
+/*
+ * Document-class: SDL2::Renderer::CommandList
+ *
+ * This class records rendering commands into a native buffer and
+ * replays them with one method call.
+ *
+ * The recording methods have the same names and arguments as
+ * the methods of {SDL2::Renderer}. Each of them returns the index of
+ * the recorded command, which can be used to patch the command later
+ * (e.g. {#move}) without recording the whole list again.
+ * Setters like {#draw_color=} return their argument as usual in Ruby;
+ * use {#size} to know their index.
+ *
+ * Textures are referenced by the list; replaying a list which refers
+ * to a destroyed texture raises {SDL2::Error}.
+ *
+ * @example
+ *   hud = SDL2::Renderer::CommandList.new
+ *   hud.draw_color = [0, 0, 0, 128]
+ *   hud.fill_rect(SDL2::Rect.new(0, 0, 640, 32))
+ *   icon = hud.copy(icon_texture, nil, SDL2::Rect.new(4, 4, 24, 24))
+ *
+ *   loop do
+ *     hud.move(icon, icon_x, 4)
+ *     hud.replay(renderer)
+ *     renderer.present
+ *   end
+ */
+enum {
+    CMD_COPY,
+    CMD_COPY_EX,
+    CMD_DRAW_POINT,
+    CMD_DRAW_LINE,
+    CMD_DRAW_RECT,
+    CMD_FILL_RECT,
+    CMD_DRAW_COLOR,
+    CMD_DRAW_BLEND_MODE,
+    CMD_CLIP_RECT,
+};
+
+#define CMD_HAS_SRC    1
+#define CMD_HAS_DST    2
+#define CMD_HAS_CENTER 4
+
+typedef struct RenderCommand {
+    Uint8 type;
+    Uint8 flags;
+    Uint8 flip;
+    SDL_Color color;
+    int blend_mode;
+    Texture* texture;
+    SDL_Rect src;
+    /* dst is also used for points (x, y) and lines (x, y)-(w, h) */
+    SDL_Rect dst;
+    SDL_Point center;
+    double angle;
+} RenderCommand;
+
+typedef struct CommandList {
+    long num_commands;
+    long max_commands;
+    RenderCommand* commands;
+} CommandList;
+
+static void CommandList_free(CommandList* l)
+{
+    free(l->commands);
+    free(l);
+}
+
+DEFINE_DATA_TYPE(CommandList, CommandList_free);
+DEFINE_GETTER(static, CommandList, cRendererCommandList, "SDL2::Renderer::CommandList");
+
+static VALUE CommandList_s_allocate(VALUE klass)
+{
+    CommandList* l;
+    VALUE obj = TypedData_Make_Struct(klass, CommandList, &CommandList_data_type, l);
+    l->num_commands = 0;
+    l->max_commands = 0;
+    l->commands = NULL;
+    /* the set of referenced textures, as a Hash with texture keys */
+    rb_iv_set(obj, "textures", rb_hash_new());
+    return obj;
+}
+
+static void init_command(RenderCommand* cmd, int type)
+{
+    memset(cmd, 0, sizeof(RenderCommand));
+    cmd->type = type;
+}
+
+/* Append a command and return its index */
+static VALUE CommandList_push(VALUE self, const RenderCommand* cmd)
+{
+    CommandList* l = Get_CommandList(self);
+
+    if (l->num_commands == l->max_commands) {
+        l->max_commands = l->max_commands ? l->max_commands * 2 : 16;
+        REALLOC_N(l->commands, RenderCommand, l->max_commands);
+    }
+    l->commands[l->num_commands] = *cmd;
+    return LONG2NUM(l->num_commands++);
+}
+
+static RenderCommand* CommandList_get_command(VALUE self, VALUE index)
+{
+    CommandList* l = Get_CommandList(self);
+    long i = NUM2LONG(index);
+    if (i < 0)
+        i += l->num_commands;
+    if (i < 0 || i >= l->num_commands)
+        rb_raise(rb_eIndexError, "index %ld out of command list", NUM2LONG(index));
+    return &l->commands[i];
+}
+
+static void set_optional_rect(RenderCommand* cmd, SDL_Rect* dst, int flag, VALUE rect)
+{
+    if (rect == Qnil) {
+        cmd->flags &= ~flag;
+    } else {
+        *dst = *Get_SDL_Rect(rect);
+        cmd->flags |= flag;
+    }
+}
+
+static void set_texture(VALUE self, RenderCommand* cmd, VALUE texture)
+{
+    Get_SDL_Texture(texture);
+    cmd->texture = Get_Texture(texture);
+    /* keep the texture alive while the list refers to it */
+    rb_hash_aset(rb_iv_get(self, "textures"), texture, Qtrue);
+}
+
+/*
+ * @overload copy(texture, srcrect, dstrect)
+ *   Record {SDL2::Renderer#copy}.
+ *   @return [Integer] the index of the command
+ */
+static VALUE CommandList_copy(VALUE self, VALUE texture, VALUE srcrect, VALUE dstrect)
+{
+    RenderCommand cmd;
+    init_command(&cmd, CMD_COPY);
+    set_optional_rect(&cmd, &cmd.src, CMD_HAS_SRC, srcrect);
+    set_optional_rect(&cmd, &cmd.dst, CMD_HAS_DST, dstrect);
+    set_texture(self, &cmd, texture);
+    return CommandList_push(self, &cmd);
+}
+
+/*
+ * @overload copy_ex(texture, srcrect, dstrect, angle, center, flip)
+ *   Record {SDL2::Renderer#copy_ex}.
+ *   @return [Integer] the index of the command
+ */
+static VALUE CommandList_copy_ex(VALUE self, VALUE texture, VALUE srcrect, VALUE dstrect,
+                                 VALUE angle, VALUE center, VALUE flip)
+{
+    RenderCommand cmd;
+    init_command(&cmd, CMD_COPY_EX);
+    set_optional_rect(&cmd, &cmd.src, CMD_HAS_SRC, srcrect);
+    set_optional_rect(&cmd, &cmd.dst, CMD_HAS_DST, dstrect);
+    cmd.angle = NUM2DBL(angle);
+    if (center != Qnil) {
+        cmd.center = *Get_SDL_Point(center);
+        cmd.flags |= CMD_HAS_CENTER;
+    }
+    cmd.flip = NUM2INT(flip);
+    set_texture(self, &cmd, texture);
+    return CommandList_push(self, &cmd);
+}
+
+/*
+ * @overload draw_point(x, y)
+ *   Record {SDL2::Renderer#draw_point}.
+ *   @return [Integer] the index of the command
  */
-static VALUE Renderer_viewport(VALUE self)
+static VALUE CommandList_draw_point(VALUE self, VALUE x, VALUE y)
 {
-    VALUE rect = rb_obj_alloc(cRect);
-    SDL_RenderGetViewport(Get_SDL_Renderer(self), Get_SDL_Rect(rect));
-    return rect;
+    RenderCommand cmd;
+    init_command(&cmd, CMD_DRAW_POINT);
+    cmd.dst.x = NUM2INT(x);
+    cmd.dst.y = NUM2INT(y);
+    return CommandList_push(self, &cmd);
 }
 
 /*
- * @overload viewport=(area)
- *   Set the drawing area for rendering on the current target.
- *
- *   @param area [SDL2::Rect,nil] the drawing area, or nil to set the viewport to the entire target
- *   @return [void]
- *   @see #viewport
+ * @overload draw_line(x1, y1, x2, y2)
+ *   Record {SDL2::Renderer#draw_line}.
+ *   @return [Integer] the index of the command
  */
-static VALUE Renderer_set_viewport(VALUE self, VALUE rect)
+static VALUE CommandList_draw_line(VALUE self, VALUE x1, VALUE y1, VALUE x2, VALUE y2)
 {
-    HANDLE_ERROR(SDL_RenderSetViewport(Get_SDL_Renderer(self), Get_SDL_Rect_or_NULL(rect)));
+    RenderCommand cmd;
+    init_command(&cmd, CMD_DRAW_LINE);
+    cmd.dst.x = NUM2INT(x1);
+    cmd.dst.y = NUM2INT(y1);
+    cmd.dst.w = NUM2INT(x2);
+    cmd.dst.h = NUM2INT(y2);
+    return CommandList_push(self, &cmd);
+}
+
+/*
+ * @overload draw_rect(rect)
+ *   Record {SDL2::Renderer#draw_rect}.
+ *   @return [Integer] the index of the command
+ */
+static VALUE CommandList_draw_rect(VALUE self, VALUE rect)
+{
+    RenderCommand cmd;
+    init_command(&cmd, CMD_DRAW_RECT);
+    cmd.dst = *Get_SDL_Rect(rect);
+    cmd.flags |= CMD_HAS_DST;
+    return CommandList_push(self, &cmd);
+}
+
+/*
+ * @overload fill_rect(rect)
+ *   Record {SDL2::Renderer#fill_rect}.
+ *   @return [Integer] the index of the command
+ */
+static VALUE CommandList_fill_rect(VALUE self, VALUE rect)
+{
+    RenderCommand cmd;
+    init_command(&cmd, CMD_FILL_RECT);
+    cmd.dst = *Get_SDL_Rect(rect);
+    cmd.flags |= CMD_HAS_DST;
+    return CommandList_push(self, &cmd);
+}
+
+/*
+ * @overload draw_color=(color)
+ *   Record {SDL2::Renderer#draw_color=}.
+ *   @return [color]
+ */
+static VALUE CommandList_set_draw_color(VALUE self, VALUE rgba)
+{
+    RenderCommand cmd;
+    init_command(&cmd, CMD_DRAW_COLOR);
+    cmd.color = Array_to_SDL_Color(rgba);
+    CommandList_push(self, &cmd);
+    return rgba;
+}
+
+/*
+ * @overload draw_blend_mode=(mode)
+ *   Record {SDL2::Renderer#draw_blend_mode=}.
+ *   @return [mode]
+ */
+static VALUE CommandList_set_draw_blend_mode(VALUE self, VALUE mode)
+{
+    RenderCommand cmd;
+    init_command(&cmd, CMD_DRAW_BLEND_MODE);
+    cmd.blend_mode = NUM2INT(mode);
+    CommandList_push(self, &cmd);
+    return mode;
+}
+
+/*
+ * @overload clip_rect=(rect)
+ *   Record {SDL2::Renderer#clip_rect=}. nil disables clipping.
+ *   @return [rect]
+ */
+static VALUE CommandList_set_clip_rect(VALUE self, VALUE rect)
+{
+    RenderCommand cmd;
+    init_command(&cmd, CMD_CLIP_RECT);
+    set_optional_rect(&cmd, &cmd.dst, CMD_HAS_DST, rect);
+    CommandList_push(self, &cmd);
     return rect;
 }
 
 /*
- * Return true if the renderer supports render target.
+ * @overload move(index, x, y)
+ *   Change the position of a recorded command: the left-top point of
+ *   the destination rectangle for copy, copy_ex, draw_rect, fill_rect and clip_rect=,
+ *   or the point for draw_point.
  *
- * @see #render_target=
+ *   @param index [Integer] the index of the command
+ *   @param x [Integer] the new x coordinate
+ *   @param y [Integer] the new y coordinate
+ *   @return [nil]
+ *   @raise [ArgumentError] raised if the command has no destination rectangle
  */
-static VALUE Renderer_support_render_target_p(VALUE self)
+static VALUE CommandList_move(VALUE self, VALUE index, VALUE x, VALUE y)
 {
-    return INT2BOOL(SDL_RenderTargetSupported(Get_SDL_Renderer(self)));
+    RenderCommand* cmd = CommandList_get_command(self, index);
+    if (cmd->type != CMD_DRAW_POINT && !(cmd->flags & CMD_HAS_DST))
+        rb_raise(rb_eArgError, "the command has no destination to move");
+    cmd->dst.x = NUM2INT(x);
+    cmd->dst.y = NUM2INT(y);
+    return Qnil;
 }
 
 /*
- * Get the output size of a rendering context.
+ * @overload set_dstrect(index, rect)
+ *   Change the destination rectangle (or the rectangle of draw_rect,
+ *   fill_rect and clip_rect=) of a recorded command.
  *
- * @return [Array(Integer, Integer)] the width and the height
+ *   @param index [Integer] the index of the command
+ *   @param rect [SDL2::Rect,nil] the new rectangle (nil is not allowed
+ *     for draw_rect and fill_rect)
+ *   @return [nil]
  */
-static VALUE Renderer_output_size(VALUE self)
+static VALUE CommandList_set_dstrect(VALUE self, VALUE index, VALUE rect)
 {
-    int w, h;
-    HANDLE_ERROR(SDL_GetRendererOutputSize(Get_SDL_Renderer(self), &w, &h));
-    return rb_ary_new3(2, INT2FIX(w), INT2FIX(h));
+    RenderCommand* cmd = CommandList_get_command(self, index);
+    switch (cmd->type) {
+    case CMD_DRAW_RECT: case CMD_FILL_RECT:
+        cmd->dst = *Get_SDL_Rect(rect);
+        return Qnil;
+    case CMD_COPY: case CMD_COPY_EX: case CMD_CLIP_RECT:
+        set_optional_rect(cmd, &cmd->dst, CMD_HAS_DST, rect);
+        return Qnil;
+    default:
+        rb_raise(rb_eArgError, "the command has no rectangle");
+    }
 }
 
 /*
- * @overload render_target=(target)
- *  Set a texture as the current render target.
- *
- *  Some renderers have ability to render to a texture instead of a screen.
- *  You can judge whether your renderer has this ability using
- *  {#support_render_target?}.
- *
- *  The target texture musbe be {#create_texture created} with the
- *  {SDL2::Texture::ACCESS_TARGET} flag.
- *
- *  @param [SDL2::Texture,nil] target the targeted texture, or nil
- *    for the default render target(i.e. screen)
- *
- *  @return [void]
+ * @overload set_srcrect(index, rect)
+ *   Change the source rectangle of a recorded copy or copy_ex command.
  *
- *  @see #render_target
+ *   @param index [Integer] the index of the command
+ *   @param rect [SDL2::Rect,nil] the new source rectangle
+ *   @return [nil]
  */
-static VALUE Renderer_set_render_target(VALUE self, VALUE target)
+static VALUE CommandList_set_srcrect(VALUE self, VALUE index, VALUE rect)
 {
-    HANDLE_ERROR(SDL_SetRenderTarget(Get_SDL_Renderer(self),
-                                     (target == Qnil) ? NULL : Get_SDL_Texture(target)));
-    rb_iv_set(self, "render_target", target);
-    return target;
+    RenderCommand* cmd = CommandList_get_command(self, index);
+    if (cmd->type != CMD_COPY && cmd->type != CMD_COPY_EX)
+        rb_raise(rb_eArgError, "the command is not copy or copy_ex");
+    set_optional_rect(cmd, &cmd->src, CMD_HAS_SRC, rect);
+    return Qnil;
 }
 
 /*
- * Get the current render target.
+ * @overload set_angle(index, angle)
+ *   Change the angle of a recorded copy_ex command.
  *
- * @return [SDL2::Texture] the current rendering target
- * @return [nil] for the default render target (i.e. screen)
+ *   @param index [Integer] the index of the command
+ *   @param angle [Float] the new angle in degree
+ *   @return [nil]
+ */
+static VALUE CommandList_set_angle(VALUE self, VALUE index, VALUE angle)
+{
+    RenderCommand* cmd = CommandList_get_command(self, index);
+    if (cmd->type != CMD_COPY_EX)
+        rb_raise(rb_eArgError, "the command is not copy_ex");
+    cmd->angle = NUM2DBL(angle);
+    return Qnil;
+}
+
+/*
+ * @overload set_color(index, color)
+ *   Change the color of a recorded draw_color= command.
  *
- * @see #render_target=
- * @see #support_render_target?
+ *   @param index [Integer] the index of the command
+ *   @param color [[Integer, Integer, Integer],[Integer, Integer, Integer, Integer]]
+ *     red, green, blue, and optionally alpha components
+ *   @return [nil]
  */
-static VALUE Renderer_render_target(VALUE self)
+static VALUE CommandList_set_color(VALUE self, VALUE index, VALUE rgba)
 {
-    return rb_iv_get(self, "render_target");
+    RenderCommand* cmd = CommandList_get_command(self, index);
+    if (cmd->type != CMD_DRAW_COLOR)
+        rb_raise(rb_eArgError, "the command is not draw_color=");
+    cmd->color = Array_to_SDL_Color(rgba);
+    return Qnil;
 }
 
 /*
- * Reset the render target to the screen.
+ * Replay all recorded commands on a renderer.
  *
+ * @param renderer [SDL2::Renderer] the renderer to draw on
  * @return [nil]
  */
-static VALUE Renderer_reset_render_target(VALUE self)
-{
-    return Renderer_set_render_target(self, Qnil);
+static VALUE CommandList_replay(VALUE self, VALUE renderer)
+{
+    CommandList* l = Get_CommandList(self);
+    SDL_Renderer* r = Get_SDL_Renderer(renderer);
+    long i;
+    PROFILE_BEGIN(start);
+
+    for (i=0; i<l->num_commands; ++i) {
+        const RenderCommand* cmd = &l->commands[i];
+        const SDL_Rect* src = (cmd->flags & CMD_HAS_SRC) ? &cmd->src : NULL;
+        const SDL_Rect* dst = (cmd->flags & CMD_HAS_DST) ? &cmd->dst : NULL;
+
+        switch (cmd->type) {
+        case CMD_COPY:
+            if (!cmd->texture->texture)
+                HANDLE_ERROR(SDL_SetError("SDL2::Texture is already destroyed"));
+            HANDLE_ERROR(SDL_RenderCopy(r, cmd->texture->texture, src, dst));
+            break;
+        case CMD_COPY_EX:
+            if (!cmd->texture->texture)
+                HANDLE_ERROR(SDL_SetError("SDL2::Texture is already destroyed"));
+            HANDLE_ERROR(SDL_RenderCopyEx(r, cmd->texture->texture, src, dst, cmd->angle,
+                                          (cmd->flags & CMD_HAS_CENTER) ? &cmd->center : NULL,
+                                          cmd->flip));
+            break;
+        case CMD_DRAW_POINT:
+            HANDLE_ERROR(SDL_RenderDrawPoint(r, cmd->dst.x, cmd->dst.y));
+            break;
+        case CMD_DRAW_LINE:
+            HANDLE_ERROR(SDL_RenderDrawLine(r, cmd->dst.x, cmd->dst.y, cmd->dst.w, cmd->dst.h));
+            break;
+        case CMD_DRAW_RECT:
+            HANDLE_ERROR(SDL_RenderDrawRect(r, dst));
+            break;
+        case CMD_FILL_RECT:
+            HANDLE_ERROR(SDL_RenderFillRect(r, dst));
+            break;
+        case CMD_DRAW_COLOR:
+            HANDLE_ERROR(SDL_SetRenderDrawColor(r, cmd->color.r, cmd->color.g,
+                                                cmd->color.b, cmd->color.a));
+            break;
+        case CMD_DRAW_BLEND_MODE:
+            HANDLE_ERROR(SDL_SetRenderDrawBlendMode(r, cmd->blend_mode));
+            break;
+        case CMD_CLIP_RECT:
+            HANDLE_ERROR(SDL_RenderSetClipRect(r, dst));
+            break;
+        }
+    }
+    PROFILE_END(PROFILE_COMMAND_LIST_REPLAY, start);
+    return Qnil;
 }
 
-/* @return [Hash<String=>Object>] (GC) debug information */
-static VALUE Renderer_debug_info(VALUE self)
+/* @return [Integer] the number of recorded commands */
+static VALUE CommandList_size(VALUE self)
 {
-    Renderer* r = Get_Renderer(self);
-    VALUE info = rb_hash_new();
-    int num_active_textures = 0;
-    int i;
-    rb_hash_aset(info, rb_str_new2("destroy?"), INT2BOOL(r->renderer == NULL));
-    rb_hash_aset(info, rb_str_new2("max_textures"), INT2NUM(r->max_textures));
-    rb_hash_aset(info, rb_str_new2("num_textures"), INT2NUM(r->num_textures));
-    for (i=0; i<r->num_textures; ++i)
-        if (r->textures[i]->texture)
-            ++num_active_textures;
-    rb_hash_aset(info, rb_str_new2("num_active_textures"), INT2NUM(num_active_textures));
-    rb_hash_aset(info, rb_str_new2("refcount"), INT2NUM(r->refcount));
+    return LONG2NUM(Get_CommandList(self)->num_commands);
+}
 
-    return info;
+/*
+ * Remove all recorded commands.
+ *
+ * @return [self]
+ */
+static VALUE CommandList_clear(VALUE self)
+{
+    Get_CommandList(self)->num_commands = 0;
+    rb_hash_clear(rb_iv_get(self, "textures"));
+    return self;
 }
 
 /*
@@ -1999,6 +3639,170 @@ static VALUE Texture_h(VALUE self)
     return INT2FIX(h);
 }
 
+/*
+ * Return the number of bytes of h rows of pixel data in the format;
+ * planar YUV formats have chroma planes after the Y plane.
+ */
+static size_t texture_data_size(Uint32 format, int pitch, int h)
+{
+    size_t y_size = (size_t)pitch * h;
+    switch (format) {
+    case SDL_PIXELFORMAT_YV12: case SDL_PIXELFORMAT_IYUV:
+        return y_size + 2 * (size_t)((pitch + 1) / 2) * ((h + 1) / 2);
+#if SDL_VERSION_ATLEAST(2,0,4)
+    case SDL_PIXELFORMAT_NV12: case SDL_PIXELFORMAT_NV21:
+        return y_size + (size_t)((pitch + 1) / 2) * 2 * ((h + 1) / 2);
+#endif
+    default:
+        return y_size;
+    }
+}
+
+/*
+ * @overload update(rect, pixels, pitch=nil)
+ *   Update the given texture rectangle with new pixel data.
+ *
+ *   The pixel data must be in the format of the texture.
+ *   This is a fairly slow function, intended for use with static textures
+ *   that do not change often. If the texture is intended to be updated often,
+ *   it is preferred to create the texture as streaming and use {#lock}.
+ *
+ *   @param rect [SDL2::Rect,nil] the area to update, or nil for the entire texture
+ *   @param pixels [String,IO::Buffer] the raw pixel data
+ *   @param pitch [Integer,nil] the number of bytes in a row of pixel data;
+ *     if nil, the width of the area multiplied by bytes per pixel is used.
+ *     For YUV formats (such as YV12), this is the pitch of the Y plane and
+ *     must be given
+ *   @return [nil]
+ *
+ *   @raise [ArgumentError] raised when **pixels** is too short, or
+ *     **pitch** is nil for a YUV format
+ *   @see #lock
+ */
+static VALUE Texture_update(int argc, VALUE* argv, VALUE self)
+{
+    VALUE rect, pixels, pitch;
+    SDL_Texture* texture = Get_SDL_Texture(self);
+    const SDL_Rect* sdl_rect;
+    const void* ptr;
+    size_t len;
+    Uint32 format;
+    int w, h, p;
+    PROFILE_BEGIN(start);
+
+    rb_scan_args(argc, argv, "21", &rect, &pixels, &pitch);
+    sdl_rect = Get_SDL_Rect_or_NULL(rect);
+    HANDLE_ERROR(SDL_QueryTexture(texture, &format, NULL, &w, &h));
+    if (sdl_rect) {
+        w = sdl_rect->w; h = sdl_rect->h;
+    }
+    if (pitch != Qnil)
+        p = NUM2INT(pitch);
+    else if (SDL_ISPIXELFORMAT_FOURCC(format))
+        rb_raise(rb_eArgError, "pitch must be given for YUV textures");
+    else
+        p = w * SDL_BYTESPERPIXEL(format);
+
+    ptr = bytes_for_reading(pixels, &len);
+    if (len < texture_data_size(format, p, h))
+        rb_raise(rb_eArgError, "pixel data too short (%ld for %ld)",
+                 (long)len, (long)texture_data_size(format, p, h));
+
+    HANDLE_ERROR(SDL_UpdateTexture(texture, sdl_rect, ptr, p));
+    RB_GC_GUARD(pixels);
+    PROFILE_END(PROFILE_TEXTURE_UPDATE, start);
+    return Qnil;
+}
+
+struct texture_lock_args {
+    VALUE texture;
+    void* pixels;
+    size_t size;
+    int pitch;
+    VALUE buffer;
+};
+
+static VALUE Texture_lock_yield(VALUE args)
+{
+    struct texture_lock_args* a = (struct texture_lock_args*)args;
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES_FOR_READING
+    a->buffer = rb_io_buffer_new(a->pixels, a->size, RB_IO_BUFFER_EXTERNAL);
+#else
+    a->buffer = rb_str_new(a->pixels, a->size);
+#endif
+    return rb_yield_values(2, a->buffer, INT2NUM(a->pitch));
+}
+
+static VALUE Texture_lock_ensure(VALUE args)
+{
+    struct texture_lock_args* a = (struct texture_lock_args*)args;
+    Texture* t = Get_Texture(a->texture);
+
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES_FOR_READING
+    if (a->buffer != Qnil)
+        rb_io_buffer_free(a->buffer);
+#else
+    if (a->buffer != Qnil && t->texture && RB_TYPE_P(a->buffer, T_STRING))
+        memcpy(a->pixels, RSTRING_PTR(a->buffer),
+               RSTRING_LEN(a->buffer) < a->size ? RSTRING_LEN(a->buffer) : a->size);
+#endif
+    if (t->texture)
+        SDL_UnlockTexture(t->texture);
+    return Qnil;
+}
+
+/*
+ * @overload lock(rect=nil){|pixels, pitch| ... }
+ *   Lock a portion of the texture for write-only pixel access
+ *   and yield the locked memory.
+ *
+ *   The texture must be created with {SDL2::Texture::ACCESS_STREAMING}.
+ *   The texture is unlocked when the block returns, and the changes
+ *   are uploaded to the texture.
+ *
+ *   On Ruby with IO::Buffer, **pixels** is an IO::Buffer which directly
+ *   maps the locked memory, so you can write the pixels without copying.
+ *   The buffer is invalidated after the block.
+ *   Otherwise, **pixels** is a String and its content is copied to
+ *   the texture after the block.
+ *
+ *   Note that the locked memory is write-only; its initial content is undefined.
+ *
+ *   @param rect [SDL2::Rect,nil] the area to lock, or nil for the entire texture
+ *   @yieldparam pixels [IO::Buffer,String] the locked pixel memory
+ *   @yieldparam pitch [Integer] the number of bytes in a row of the locked memory
+ *   @return [Object] the value of the block
+ *
+ *   @example stream a frame
+ *     texture = renderer.create_texture(SDL2::PixelFormat::ARGB8888,
+ *                                       SDL2::Texture::ACCESS_STREAMING, 1920, 1080)
+ *     texture.lock{|pixels, pitch| pixels.set_string(frame) }
+ *
+ *   @see #update
+ */
+static VALUE Texture_lock(int argc, VALUE* argv, VALUE self)
+{
+    VALUE rect;
+    struct texture_lock_args args;
+    SDL_Texture* texture = Get_SDL_Texture(self);
+    const SDL_Rect* sdl_rect;
+    int h;
+
+    rb_scan_args(argc, argv, "01", &rect);
+    rb_need_block();
+    sdl_rect = Get_SDL_Rect_or_NULL(rect);
+    if (sdl_rect)
+        h = sdl_rect->h;
+    else
+        HANDLE_ERROR(SDL_QueryTexture(texture, NULL, NULL, NULL, &h));
+
+    HANDLE_ERROR(SDL_LockTexture(texture, sdl_rect, &args.pixels, &args.pitch));
+    args.texture = self;
+    args.size = (size_t)args.pitch * h;
+    args.buffer = Qnil;
+    return rb_ensure(Texture_lock_yield, (VALUE)&args, Texture_lock_ensure, (VALUE)&args);
+}
+
 /* @return [String] inspection string */
 static VALUE Texture_inspect(VALUE self)
 {
@@ -2084,36 +3888,12 @@ static VALUE Surface_s_save_bmp(VALUE self, VALUE src, VALUE fname)
     return INT2NUM(SDL_SaveBMP(surface, StringValueCStr(fname)));
 }
 
-/*
- * @overload from_string(string, width, height, depth, pitch=nil, rmask=nil, gmask=nil, bmask=nil, amask=nil)
- *
- *   Create a RGB surface from pixel data as String object.
- *
- *   If rmask, gmask, bmask are omitted, the default masks are used.
- *   If amask is omitted, alpha mask is considered to be zero.
- *
- *   @param string [String] the pixel data
- *   @param width [Integer] the width of the creating surface
- *   @param height [Integer] the height of the creating surface
- *   @param depth [Integer] the color depth (in bits) of the creating surface
- *   @param pitch [Integer] the number of bytes of one scanline
- *     if this argument is omitted, width*depth/8 is used.
- *   @param rmask [Integer] the red mask of a pixel
- *   @param gmask [Integer] the green mask of a pixel
- *   @param bmask [Integer] the blue mask of a pixel
- *   @param amask [Integer] the alpha mask of a pixel
- *   @return [SDL2::Surface] a new surface
- *   @raise [SDL2::Error] raised when an error occurs in C SDL library
- *
- */
-static VALUE Surface_s_from_string(int argc, VALUE* argv, VALUE self)
+static SDL_Surface* Surface_create_from_string(int argc, VALUE* argv, int copy, VALUE* pinned)
 {
     VALUE string, width, height, depth, pitch, Rmask, Gmask, Bmask, Amask;
     int w, h, d, p, r, g, b, a;
     SDL_Surface* surface;
     void* pixels;
-    Surface* s;
-    VALUE obj;
 
     rb_scan_args(argc, argv, "45", &string, &width, &height, &depth,
                  &pitch, &Rmask, &Gmask, &Bmask, &Amask);
@@ -2132,17 +3912,109 @@ static VALUE Surface_s_from_string(int argc, VALUE* argv, VALUE self)
     if (p < d*w/8 )
         rb_raise(rb_eArgError, "pitch too small");
 
-    pixels = ruby_xmalloc(RSTRING_LEN(string));
-    memcpy(pixels, RSTRING_PTR(string), RSTRING_LEN(string));
+    if (copy) {
+        pixels = ruby_xmalloc(RSTRING_LEN(string));
+        memcpy(pixels, RSTRING_PTR(string), RSTRING_LEN(string));
+        *pinned = Qnil;
+    } else {
+        /* SDL writes to the pixels, so the string must be writable and
+         * must own its buffer (not shared with other strings or literals).
+         * The lock forbids resizing, which would free the buffer; it is
+         * released by Surface_destroy */
+        rb_check_frozen(string);
+        rb_str_modify(string);
+        rb_str_locktmp(string);
+        *pinned = string;
+        pixels = RSTRING_PTR(string);
+    }
     surface = SDL_CreateRGBSurfaceFrom(pixels, w, h, d, p, r, g, b, a);
-    if (!surface)
+    if (!surface) {
+        if (copy)
+            ruby_xfree(pixels);
+        else
+            rb_str_unlocktmp(string);
         SDL_ERROR();
+    }
 
     RB_GC_GUARD(string);
+    return surface;
+}
 
-    obj = TypedData_Make_Struct(cSurface, Surface, &Surface_data_type, s);
-    s->surface = surface;
-    s->need_to_free_pixels = 1;
+/*
+ * @overload from_string(string, width, height, depth, pitch=nil, rmask=nil, gmask=nil, bmask=nil, amask=nil)
+ *
+ *   Create a RGB surface from pixel data as String object.
+ *
+ *   If rmask, gmask, bmask are omitted, the default masks are used.
+ *   If amask is omitted, alpha mask is considered to be zero.
+ *
+ *   The pixel data is copied. Use {.wrap_string} to avoid the copy.
+ *
+ *   @param string [String] the pixel data
+ *   @param width [Integer] the width of the creating surface
+ *   @param height [Integer] the height of the creating surface
+ *   @param depth [Integer] the color depth (in bits) of the creating surface
+ *   @param pitch [Integer] the number of bytes of one scanline
+ *     if this argument is omitted, width*depth/8 is used.
+ *   @param rmask [Integer] the red mask of a pixel
+ *   @param gmask [Integer] the green mask of a pixel
+ *   @param bmask [Integer] the blue mask of a pixel
+ *   @param amask [Integer] the alpha mask of a pixel
+ *   @return [SDL2::Surface] a new surface
+ *   @raise [SDL2::Error] raised when an error occurs in C SDL library
+ *
+ */
+static VALUE Surface_s_from_string(int argc, VALUE* argv, VALUE self)
+{
+    VALUE pinned;
+    VALUE obj = Surface_new(Surface_create_from_string(argc, argv, 1, &pinned));
+    Get_Surface(obj)->need_to_free_pixels = 1;
+    return obj;
+}
+
+static VALUE Surface_destroy(VALUE self);
+
+/*
+ * @overload wrap_string(string, width, height, depth, pitch=nil, rmask=nil, gmask=nil, bmask=nil, amask=nil)
+ *   Create a RGB surface which uses the memory of a String as its pixels.
+ *
+ *   Unlike {.from_string}, the pixel data is not copied, so drawing to the
+ *   surface changes the content of **string** and vice versa.
+ *   **string** is temporarily locked until the surface is {#destroy destroyed};
+ *   while it is locked, any method which changes the length of **string**
+ *   (such as String#<< and String#replace) raises RuntimeError.
+ *   A surface garbage collected without {#destroy} leaves the lock.
+ *
+ *   The arguments are the same as {.from_string}.
+ *
+ *   @return [SDL2::Surface] a new surface
+ *
+ * @overload wrap_string(string, width, height, depth, pitch=nil, rmask=nil, gmask=nil, bmask=nil, amask=nil){|surface| ... }
+ *   Create a surface as above, yield it, and destroy it after the block,
+ *   which unlocks **string**.
+ *
+ *   @yieldparam surface [SDL2::Surface] the surface using the memory of **string**
+ *   @return [Object] the value of the block
+ *
+ * @raise [SDL2::Error] raised when an error occurs in C SDL library
+ * @raise [FrozenError] raised when **string** is frozen
+ * @raise [RuntimeError] raised when **string** is already locked
+ *   (for example, wrapped by another surface)
+ *
+ * @example
+ *   SDL2::Surface.wrap_string(buf, 320, 240, 32) do |surface|
+ *     SDL2::Surface.blit(sprite, nil, surface, SDL2::Rect.new(16, 16, 32, 32))
+ *   end
+ *
+ * @see .from_string
+ */
+static VALUE Surface_s_wrap_string(int argc, VALUE* argv, VALUE self)
+{
+    VALUE pinned;
+    VALUE obj = Surface_new(Surface_create_from_string(argc, argv, 0, &pinned));
+    Get_Surface(obj)->pixels_string = pinned;
+    if (rb_block_given_p())
+        return rb_ensure(rb_yield, obj, Surface_destroy, obj);
     return obj;
 }
 
@@ -2155,9 +4027,14 @@ static VALUE Surface_s_from_string(int argc, VALUE* argv, VALUE self)
 static VALUE Surface_destroy(VALUE self)
 {
     Surface* s = Get_Surface(self);
+    if (s->num_views > 0)
+        rb_raise(rb_eRuntimeError, "cannot destroy a surface whose pixels are exported");
     if (s->need_to_free_pixels)
-        free(s->surface->pixels);
+        ruby_xfree(s->surface->pixels);
     s->need_to_free_pixels = 0;
+    if (s->pixels_string != Qnil)
+        rb_str_unlocktmp(s->pixels_string);
+    s->pixels_string = Qnil;
     if (s->surface)
         SDL_FreeSurface(s->surface);
     s->surface = NULL;
@@ -2263,6 +4140,9 @@ static VALUE Surface_pixel(VALUE self, VALUE x_coord, VALUE y_coord)
 /*
  * Get all pixel data of the surface as a string.
  *
+ * The pixel data is copied. To access the pixels without copying,
+ * use {#pixels_buffer} or the MemoryView of the surface (e.g. with Fiddle::MemoryView).
+ *
  * @return [String]
  *
  */
@@ -2273,6 +4153,117 @@ static VALUE Surface_pixels(VALUE self)
     return rb_str_new(surface->pixels, size);
 }
 
+/* Lock the surface (if needed) and count an exported view of the pixels */
+static SDL_Surface* Surface_export_pixels(Surface* s)
+{
+    if (!s->surface)
+        HANDLE_ERROR(SDL_SetError("SDL2::Surface is already destroyed"));
+    if (SDL_MUSTLOCK(s->surface))
+        HANDLE_ERROR(SDL_LockSurface(s->surface));
+    s->num_views++;
+    return s->surface;
+}
+
+static void Surface_release_pixels(Surface* s)
+{
+    s->num_views--;
+    if (s->surface && SDL_MUSTLOCK(s->surface))
+        SDL_UnlockSurface(s->surface);
+}
+
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES_FOR_READING
+struct surface_buffer_args {
+    VALUE surface;
+    VALUE buffer;
+};
+
+static VALUE Surface_pixels_buffer_yield(VALUE args)
+{
+    struct surface_buffer_args* a = (struct surface_buffer_args*)args;
+    SDL_Surface* surface = Get_Surface(a->surface)->surface;
+    a->buffer = rb_io_buffer_new(surface->pixels, (size_t)surface->h * surface->pitch,
+                                 RB_IO_BUFFER_EXTERNAL);
+    return rb_yield(a->buffer);
+}
+
+static VALUE Surface_pixels_buffer_ensure(VALUE args)
+{
+    struct surface_buffer_args* a = (struct surface_buffer_args*)args;
+    if (a->buffer != Qnil)
+        rb_io_buffer_free(a->buffer);
+    Surface_release_pixels(Get_Surface(a->surface));
+    return Qnil;
+}
+#endif
+
+/*
+ * @overload pixels_buffer{|buffer| ... }
+ *   Yield an IO::Buffer which directly maps the pixels of the surface.
+ *
+ *   The pixels are not copied; writes to the buffer change the surface.
+ *   The surface is locked during the block if {#must_lock? needed}, and
+ *   the buffer is invalidated after the block. The surface cannot be
+ *   {#destroy destroyed} during the block.
+ *
+ *   @yieldparam buffer [IO::Buffer] the pixels ({#h} * {#pitch} bytes)
+ *   @return [Object] the value of the block
+ *   @raise [NotImplementedError] raised if IO::Buffer is not available
+ *
+ *   @example
+ *     surface.pixels_buffer{|buf| buf.get_values([:U32], 0) }
+ *
+ *   @see #pixels
+ */
+static VALUE Surface_pixels_buffer(VALUE self)
+{
+#ifdef HAVE_RB_IO_BUFFER_GET_BYTES_FOR_READING
+    struct surface_buffer_args args;
+    rb_need_block();
+    Surface_export_pixels(Get_Surface(self));
+    args.surface = self;
+    args.buffer = Qnil;
+    return rb_ensure(Surface_pixels_buffer_yield, (VALUE)&args,
+                     Surface_pixels_buffer_ensure, (VALUE)&args);
+#else
+    rb_raise(rb_eNotImpError, "IO::Buffer is not available");
+#endif
+}
+
+#ifdef HAVE_RB_MEMORY_VIEW_REGISTER
+static bool Surface_memory_view_get(VALUE self, rb_memory_view_t* view, int flags)
+{
+    Surface* s = Get_Surface(self);
+    SDL_Surface* surface;
+
+    if (!s->surface)
+        return false;
+    surface = Surface_export_pixels(s);
+    if (!rb_memory_view_init_as_byte_array(view, self, surface->pixels,
+                                           (ssize_t)surface->h * surface->pitch, false)) {
+        Surface_release_pixels(s);
+        return false;
+    }
+    return true;
+}
+
+static bool Surface_memory_view_release(VALUE self, rb_memory_view_t* view)
+{
+    Surface_release_pixels(Get_Surface(self));
+    return true;
+}
+
+static bool Surface_memory_view_available_p(VALUE self)
+{
+    return Get_Surface(self)->surface != NULL;
+}
+
+static const rb_memory_view_entry_t Surface_memory_view_entry = {
+    Surface_memory_view_get,
+    Surface_memory_view_release,
+    Surface_memory_view_available_p,
+};
+#endif
+
 /*
  * Get the pitch (bytes per horizontal line) of the surface.
  *
@@ -2509,6 +4500,384 @@ static VALUE Surface_s_new(int argc, VALUE* argv, VALUE self)
     }
 
 
+/*
+ * Document-class: SDL2::TextureAtlas
+ *
+ * This class packs many surfaces into a few large textures.
+ *
+ * Drawing sprites from the same texture avoids texture switches
+ * in the rendering backend. Each {#add added} surface is copied
+ * into a page texture, and a {SDL2::TextureAtlas::Region} pointing to the
+ * sub-rectangle is returned. Pages are packed by the skyline bottom-left
+ * algorithm, and a new page is created when no page has room.
+ *
+ * Surfaces can be added at any time; regions added before stay valid.
+ *
+ * @example
+ *   atlas = SDL2::TextureAtlas.new(renderer, 1024, 1024)
+ *   regions = paths.map{|path| atlas.add(SDL2::Surface.load(path)) }
+ *   region = regions[0]
+ *   renderer.copy(region.texture, region.rect, SDL2::Rect.new(x, y, region.w, region.h))
+ *
+ * @!attribute [r] textures
+ *   @return [Array<SDL2::Texture>] the page textures
+ *
+ * @!attribute [r] renderer
+ *   @return [SDL2::Renderer] the renderer owning the page textures
+ */
+
+/*
+ * Document-class: SDL2::TextureAtlas::Region
+ *
+ * This class represents a sub-rectangle of a page of {SDL2::TextureAtlas}.
+ *
+ * @!attribute [r] texture
+ *   @return [SDL2::Texture] the page texture containing the region
+ *
+ * @!attribute [r] rect
+ *   @return [SDL2::Rect] the rectangle of the region in the texture,
+ *     usable as srcrect of {SDL2::Renderer#copy}
+ *
+ * @!attribute [r] page
+ *   @return [Integer] the index of the page
+ */
+
+typedef struct SkylineNode {
+    int x, y, w;
+} SkylineNode;
+
+typedef struct AtlasPage {
+    int num_nodes;
+    int max_nodes;
+    SkylineNode* nodes;
+} AtlasPage;
+
+typedef struct TextureAtlas {
+    int w, h;
+    int padding;
+    Uint32 format;
+    int num_pages;
+    int max_pages;
+    AtlasPage* pages;
+    Uint64 used_area;
+    int num_regions;
+} TextureAtlas;
+
+static void TextureAtlas_free(TextureAtlas* a)
+{
+    int i;
+    for (i=0; i<a->num_pages; ++i)
+        free(a->pages[i].nodes);
+    free(a->pages);
+    free(a);
+}
+
+DEFINE_DATA_TYPE(TextureAtlas, TextureAtlas_free);
+DEFINE_GETTER(static, TextureAtlas, cTextureAtlas, "SDL2::TextureAtlas");
+
+static VALUE TextureAtlas_s_allocate(VALUE klass)
+{
+    TextureAtlas* a;
+    VALUE obj = TypedData_Make_Struct(klass, TextureAtlas, &TextureAtlas_data_type, a);
+    a->w = a->h = 0;
+    a->padding = 0;
+    a->format = 0;
+    a->num_pages = a->max_pages = 0;
+    a->pages = NULL;
+    a->used_area = 0;
+    a->num_regions = 0;
+    return obj;
+}
+
+/*
+ * @overload initialize(renderer, w=1024, h=1024, format=SDL2::PixelFormat::ARGB8888, padding=1)
+ *   Create an empty atlas.
+ *
+ *   @param renderer [SDL2::Renderer] the renderer which creates the page textures
+ *   @param w [Integer] the width of a page texture
+ *   @param h [Integer] the height of a page texture
+ *   @param format [SDL2::PixelFormat,Integer] the pixel format of the page textures
+ *   @param padding [Integer] the number of transparent pixels between regions,
+ *     which prevents bleeding with linear filtering
+ */
+static VALUE TextureAtlas_initialize(int argc, VALUE* argv, VALUE self)
+{
+    TextureAtlas* a = Get_TextureAtlas(self);
+    VALUE renderer, w, h, format, padding;
+
+    rb_scan_args(argc, argv, "14", &renderer, &w, &h, &format, &padding);
+    Get_SDL_Renderer(renderer);
+    a->w = (w == Qnil) ? 1024 : NUM2INT(w);
+    a->h = (h == Qnil) ? 1024 : NUM2INT(h);
+    a->format = (format == Qnil) ? SDL_PIXELFORMAT_ARGB8888 : uint32_for_format(format);
+    a->padding = (padding == Qnil) ? 1 : NUM2INT(padding);
+    if (a->w <= 0 || a->h <= 0)
+        rb_raise(rb_eArgError, "page size must be positive");
+    if (a->padding < 0)
+        rb_raise(rb_eArgError, "padding must not be negative");
+
+    rb_iv_set(self, "@renderer", renderer);
+    rb_iv_set(self, "@textures", rb_ary_new());
+    return Qnil;
+}
+
+/*
+ * Return the y coordinate where a w-wide rectangle is placed at the i-th node,
+ * or -1 if it does not fit. w and h include the padding, which may be cut off
+ * at the right and bottom edges of the page.
+ */
+static int skyline_fit(const TextureAtlas* a, const AtlasPage* p, int i, int w, int h)
+{
+    int x = p->nodes[i].x;
+    int y = 0;
+    int rest;
+
+    if (x + w - a->padding > a->w)
+        return -1;
+    rest = (x + w > a->w) ? a->w - x : w;
+    for (; rest > 0; ++i) {
+        if (p->nodes[i].y > y)
+            y = p->nodes[i].y;
+        if (y + h - a->padding > a->h)
+            return -1;
+        rest -= p->nodes[i].w;
+    }
+    return y;
+}
+
+/* Find the bottom-left position in the page; return the node index or -1 */
+static int skyline_find(const TextureAtlas* a, const AtlasPage* p, int w, int h,
+                        int* best_x, int* best_y)
+{
+    int i, best = -1, best_top = INT_MAX, best_width = INT_MAX;
+
+    for (i=0; i<p->num_nodes; ++i) {
+        int y = skyline_fit(a, p, i, w, h);
+        if (y < 0)
+            continue;
+        if (y + h < best_top || (y + h == best_top && p->nodes[i].w < best_width)) {
+            best = i;
+            best_top = y + h;
+            best_width = p->nodes[i].w;
+            *best_x = p->nodes[i].x;
+            *best_y = y;
+        }
+    }
+    return best;
+}
+
+static void skyline_insert(AtlasPage* p, int index, int x, int y, int w)
+{
+    int i;
+
+    if (p->num_nodes == p->max_nodes) {
+        p->max_nodes *= 2;
+        REALLOC_N(p->nodes, SkylineNode, p->max_nodes);
+    }
+    memmove(&p->nodes[index + 1], &p->nodes[index],
+            sizeof(SkylineNode) * (p->num_nodes - index));
+    p->nodes[index].x = x;
+    p->nodes[index].y = y;
+    p->nodes[index].w = w;
+    p->num_nodes++;
+
+    /* shrink or remove the nodes covered by the new node */
+    for (i = index + 1; i < p->num_nodes; ) {
+        int right = p->nodes[i-1].x + p->nodes[i-1].w;
+        int shrink = right - p->nodes[i].x;
+        if (shrink <= 0)
+            break;
+        if (p->nodes[i].w > shrink) {
+            p->nodes[i].x += shrink;
+            p->nodes[i].w -= shrink;
+            break;
+        }
+        memmove(&p->nodes[i], &p->nodes[i+1], sizeof(SkylineNode) * (p->num_nodes - i - 1));
+        p->num_nodes--;
+    }
+
+    /* merge neighbors at the same height */
+    for (i = 0; i < p->num_nodes - 1; ) {
+        if (p->nodes[i].y == p->nodes[i+1].y) {
+            p->nodes[i].w += p->nodes[i+1].w;
+            memmove(&p->nodes[i+1], &p->nodes[i+2],
+                    sizeof(SkylineNode) * (p->num_nodes - i - 2));
+            p->num_nodes--;
+        } else {
+            ++i;
+        }
+    }
+}
+
+static void TextureAtlas_add_page(VALUE self, TextureAtlas* a)
+{
+    VALUE renderer = rb_iv_get(self, "@renderer");
+    SDL_Texture* texture;
+    VALUE obj;
+    AtlasPage* p;
+
+    texture = SDL_CreateTexture(Get_SDL_Renderer(renderer), a->format,
+                                SDL_TEXTUREACCESS_STATIC, a->w, a->h);
+    if (!texture)
+        SDL_ERROR();
+    obj = Texture_new(texture, Get_Renderer(renderer));
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    /* allocate everything before pushing the texture to keep pages and @textures in sync */
+    if (a->num_pages == a->max_pages) {
+        int max_pages = a->max_pages ? a->max_pages * 2 : 4;
+        REALLOC_N(a->pages, AtlasPage, max_pages);
+        a->max_pages = max_pages;
+    }
+    p = &a->pages[a->num_pages];
+    p->num_nodes = 1;
+    p->max_nodes = 16;
+    p->nodes = ALLOC_N(SkylineNode, p->max_nodes);
+    p->nodes[0].x = p->nodes[0].y = 0;
+    p->nodes[0].w = a->w;
+    rb_ary_push(rb_iv_get(self, "@textures"), obj);
+    a->num_pages++;
+}
+
+/* Clear the page so that the padding and unused areas are transparent */
+static void TextureAtlas_clear_page(TextureAtlas* a, SDL_Texture* texture)
+{
+    VALUE tmp;
+    int pitch = a->w * SDL_BYTESPERPIXEL(a->format);
+    void* zeros = ALLOCV(tmp, (size_t)pitch * a->h);
+    memset(zeros, 0, (size_t)pitch * a->h);
+    HANDLE_ERROR(SDL_UpdateTexture(texture, NULL, zeros, pitch));
+    ALLOCV_END(tmp);
+}
+
+/*
+ * @overload add(surface)
+ *   Copy a surface into the atlas.
+ *
+ *   The surface is converted to the pixel format of the atlas.
+ *   A new page is created if no existing page has room.
+ *
+ *   @param surface [SDL2::Surface] the surface to add
+ *   @return [SDL2::TextureAtlas::Region] the region of the added surface
+ *   @raise [ArgumentError] raised if the surface is larger than a page
+ */
+static VALUE TextureAtlas_add(VALUE self, VALUE surface)
+{
+    TextureAtlas* a = Get_TextureAtlas(self);
+    SDL_Surface* src = Get_SDL_Surface(surface);
+    SDL_Surface* converted;
+    VALUE textures = rb_iv_get(self, "@textures");
+    VALUE texture, region, rect;
+    SDL_Rect* r;
+    int w = src->w + a->padding, h = src->h + a->padding;
+    int page, node = -1, x = 0, y = 0;
+
+    if (a->w == 0)
+        rb_raise(rb_eRuntimeError, "SDL2::TextureAtlas is not initialized");
+    if (src->w > a->w || src->h > a->h)
+        rb_raise(rb_eArgError, "surface (%dx%d) is larger than the atlas page (%dx%d)",
+                 src->w, src->h, a->w, a->h);
+
+    for (page=0; page<a->num_pages; ++page) {
+        node = skyline_find(a, &a->pages[page], w, h, &x, &y);
+        if (node >= 0)
+            break;
+    }
+    if (node < 0) {
+        TextureAtlas_add_page(self, a);
+        page = a->num_pages - 1;
+        TextureAtlas_clear_page(a, Get_SDL_Texture(rb_ary_entry(textures, page)));
+        node = skyline_find(a, &a->pages[page], w, h, &x, &y);
+    }
+    texture = rb_ary_entry(textures, page);
+
+    rect = rb_obj_alloc(cRect);
+    r = Get_SDL_Rect(rect);
+    r->x = x; r->y = y; r->w = src->w; r->h = src->h;
+
+    converted = SDL_ConvertSurfaceFormat(src, a->format, 0);
+    if (!converted)
+        SDL_ERROR();
+    if (SDL_MUSTLOCK(converted))
+        SDL_LockSurface(converted);
+    if (SDL_UpdateTexture(Get_SDL_Texture(texture), r, converted->pixels, converted->pitch) < 0) {
+        SDL_FreeSurface(converted);
+        SDL_ERROR();
+    }
+    if (SDL_MUSTLOCK(converted))
+        SDL_UnlockSurface(converted);
+    SDL_FreeSurface(converted);
+
+    /* the padding is not needed beyond the edges of the page */
+    skyline_insert(&a->pages[page], node, x, (y + h > a->h) ? a->h : y + h,
+                   (x + w > a->w) ? a->w - x : w);
+    a->used_area += (Uint64)src->w * src->h;
+    a->num_regions++;
+
+    region = rb_obj_alloc(cTextureAtlasRegion);
+    rb_iv_set(region, "@texture", texture);
+    rb_iv_set(region, "@rect", rect);
+    rb_iv_set(region, "@page", INT2NUM(page));
+    return region;
+}
+
+/*
+ * Get the packing density, the ratio of the area of added surfaces
+ * to the total area of all pages.
+ *
+ * @return [Float] the density between 0.0 and 1.0 (0.0 if no page exists)
+ */
+static VALUE TextureAtlas_density(VALUE self)
+{
+    TextureAtlas* a = Get_TextureAtlas(self);
+    if (a->num_pages == 0)
+        return DBL2NUM(0.0);
+    return DBL2NUM((double)a->used_area / ((double)a->w * a->h * a->num_pages));
+}
+
+/*
+ * Get the statistics of the atlas.
+ *
+ * @return [Hash<String=>Object>] the number of "pages", "regions",
+ *   "used_area" (in pixels), "total_area" (in pixels) and "density"
+ */
+static VALUE TextureAtlas_stats(VALUE self)
+{
+    TextureAtlas* a = Get_TextureAtlas(self);
+    VALUE stats = rb_hash_new();
+    rb_hash_aset(stats, rb_str_new2("pages"), INT2NUM(a->num_pages));
+    rb_hash_aset(stats, rb_str_new2("regions"), INT2NUM(a->num_regions));
+    rb_hash_aset(stats, rb_str_new2("used_area"), ULL2NUM(a->used_area));
+    rb_hash_aset(stats, rb_str_new2("total_area"),
+                 ULL2NUM((Uint64)a->w * a->h * a->num_pages));
+    rb_hash_aset(stats, rb_str_new2("density"), TextureAtlas_density(self));
+    return stats;
+}
+
+/* @return [Integer] the width of a page texture */
+static VALUE TextureAtlas_w(VALUE self)
+{
+    return INT2NUM(Get_TextureAtlas(self)->w);
+}
+
+/* @return [Integer] the height of a page texture */
+static VALUE TextureAtlas_h(VALUE self)
+{
+    return INT2NUM(Get_TextureAtlas(self)->h);
+}
+
+/* @return [Integer] the width of the region */
+static VALUE TextureAtlasRegion_w(VALUE self)
+{
+    return INT2NUM(Get_SDL_Rect(rb_iv_get(self, "@rect"))->w);
+}
+
+/* @return [Integer] the height of the region */
+static VALUE TextureAtlasRegion_h(VALUE self)
+{
+    return INT2NUM(Get_SDL_Rect(rb_iv_get(self, "@rect"))->h);
+}
+
 /* Document-class: SDL2::Rect
  *
  * This class represents a rectangle in SDL2.
@@ -2688,6 +5057,161 @@ static VALUE Point_inspect(VALUE self)
 FIELD_ACCESSOR(Point, SDL_Point, x);
 FIELD_ACCESSOR(Point, SDL_Point, y);
 
+#if SDL_VERSION_ATLEAST(2,0,10)
+#define FLOAT_FIELD_ACCESSOR(classname, typename, field)        \
+    static VALUE classname##_##field(VALUE self)                \
+    {                                                           \
+        typename* r;                                            \
+        TypedData_Get_Struct(self, typename, &typename##_data_type, r); \
+        return DBL2NUM(r->field);                               \
+    }                                                           \
+    static VALUE classname##_set_##field(VALUE self, VALUE val) \
+    {                                                           \
+        typename* r;                                            \
+        TypedData_Get_Struct(self, typename, &typename##_data_type, r); \
+        r->field = NUM2DBL(val); return val;                    \
+    }
+
+/*
+ * Document-class: SDL2::FRect
+ *
+ * This class represents a rectangle with float coordinates,
+ * which is used for subpixel rendering such as {SDL2::Renderer#copy_f}.
+ *
+ * @!attribute [rw] x
+ *   X coordiante of the left-top point of the rectangle
+ *   @return [Float]
+ *
+ * @!attribute [rw] y
+ *   Y coordiante of the left-top point of the rectangle
+ *   @return [Float]
+ *
+ * @!attribute [rw] w
+ *   Width of the rectangle
+ *   @return [Float]
+ *
+ * @!attribute [rw] h
+ *   Height of the rectangle
+ *   @return [Float]
+ *
+ * @!method self.[](x, y, w, h)
+ *   Alias of new. See {#initialize}.
+ *   @return [SDL2::FRect]
+ *
+ * @note This class is available since SDL 2.0.10.
+ */
+static VALUE FRect_s_allocate(VALUE klass)
+{
+    SDL_FRect* rect;
+    VALUE obj = TypedData_Make_Struct(klass, SDL_FRect, &SDL_FRect_data_type, rect);
+    rect->x = rect->y = rect->w = rect->h = 0.0f;
+    return obj;
+}
+
+/*
+ * Create a new SDL2::FRect object
+ *
+ * @overload initialze(x, y, w, h)
+ *   @param x [Float] X coordiante of the left-top point of the rectangle
+ *   @param y [Float] Y coordiante of the left-top point of the rectangle
+ *   @param w [Float] Width of the rectangle
+ *   @param h [Float] Height of the rectangle
+ *
+ * @overload initialize
+ *   Create a new SDL2::FRect object whose x, w, w, and h are all
+ *   zero.
+ */
+static VALUE FRect_initialize(int argc, VALUE* argv, VALUE self)
+{
+    VALUE x, y, w, h;
+    rb_scan_args(argc, argv, "04", &x, &y, &w, &h);
+    if (argc == 0) {
+        /* do nothing*/
+    } else if (argc == 4) {
+        SDL_FRect* rect = Get_SDL_FRect(self);
+        rect->x = NUM2DBL(x); rect->y = NUM2DBL(y);
+        rect->w = NUM2DBL(w); rect->h = NUM2DBL(h);
+    } else {
+        rb_raise(rb_eArgError, "wrong number of arguments (%d for 0 or 4)", argc);
+    }
+    return Qnil;
+}
+
+/*
+ * Inspection string for debug
+ * @return [String]
+ */
+static VALUE FRect_inspect(VALUE self)
+{
+    SDL_FRect* rect = Get_SDL_FRect(self);
+    return rb_sprintf("<SDL2::FRect: x=%f y=%f w=%f h=%f>",
+                      rect->x, rect->y, rect->w, rect->h);
+}
+
+FLOAT_FIELD_ACCESSOR(FRect, SDL_FRect, x);
+FLOAT_FIELD_ACCESSOR(FRect, SDL_FRect, y);
+FLOAT_FIELD_ACCESSOR(FRect, SDL_FRect, w);
+FLOAT_FIELD_ACCESSOR(FRect, SDL_FRect, h);
+
+/*
+ * Document-class: SDL2::FPoint
+ *
+ * This class represents a point with float coordinates.
+ *
+ * @!attribute [rw] x
+ *   X coordiante of the point.
+ *   @return [Float]
+ *
+ * @!attribute [rw] y
+ *   Y coordiante of the point.
+ *   @return [Float]
+ *
+ * @note This class is available since SDL 2.0.10.
+ */
+static VALUE FPoint_s_allocate(VALUE klass)
+{
+    SDL_FPoint* point;
+    VALUE obj = TypedData_Make_Struct(klass, SDL_FPoint, &SDL_FPoint_data_type, point);
+    point->x = point->y = 0.0f;
+    return obj;
+}
+
+/*
+ * Create a new point object.
+ *
+ * @overload initialize(x, y)
+ *   @param x the x coordinate of the point
+ *   @param y the y coordinate of the point
+ *
+ * @overload initialize
+ *   x and y of the created point object are initialized by 0.0
+ *
+ * @return [SDL2::FPoint]
+ */
+static VALUE FPoint_initialize(int argc, VALUE* argv, VALUE self)
+{
+    VALUE x, y;
+    SDL_FPoint* point = Get_SDL_FPoint(self);
+    rb_scan_args(argc, argv, "02", &x, &y);
+    point->x = (x == Qnil) ? 0.0f : NUM2DBL(x);
+    point->y = (y == Qnil) ? 0.0f : NUM2DBL(y);
+    return Qnil;
+}
+
+/*
+ * Return inspection string.
+ * @return [String]
+ */
+static VALUE FPoint_inspect(VALUE self)
+{
+    SDL_FPoint* point = Get_SDL_FPoint(self);
+    return rb_sprintf("<SDL2::FPoint x=%f y=%f>", point->x, point->y);
+}
+
+FLOAT_FIELD_ACCESSOR(FPoint, SDL_FPoint, x);
+FLOAT_FIELD_ACCESSOR(FPoint, SDL_FPoint, y);
+#endif
+
 
 /*
  * Document-class: SDL2::PixelFormat
@@ -2985,9 +5509,14 @@ void rubysdl2_init_video(void)
     rb_define_method(cRenderer, "create_texture", Renderer_create_texture, 4);
     rb_define_method(cRenderer, "create_texture_from", Renderer_create_texture_from, 1);
     rb_define_method(cRenderer, "copy", Renderer_copy, 3);
+    rb_define_method(cRenderer, "copy_batch", Renderer_copy_batch, -1);
     rb_define_method(cRenderer, "copy_ex", Renderer_copy_ex, 6);
+#if SDL_VERSION_ATLEAST(2,0,18)
+    rb_define_method(cRenderer, "geometry", Renderer_geometry, -1);
+#endif
     rb_define_method(cRenderer, "present", Renderer_present, 0);
     rb_define_method(cRenderer, "read_pixels", Renderer_read_pixels, 2);
+    rb_define_method(cRenderer, "read_pixels_into", Renderer_read_pixels_into, -1);
     rb_define_method(cRenderer, "draw_color",Renderer_draw_color, 0);
     rb_define_method(cRenderer, "draw_color=",Renderer_set_draw_color, 1);
     rb_define_method(cRenderer, "clear", Renderer_clear, 0);
@@ -2995,6 +5524,23 @@ void rubysdl2_init_video(void)
     rb_define_method(cRenderer, "draw_point",Renderer_draw_point, 2);
     rb_define_method(cRenderer, "draw_rect", Renderer_draw_rect, 1);
     rb_define_method(cRenderer, "fill_rect", Renderer_fill_rect, 1);
+    rb_define_method(cRenderer, "draw_points", Renderer_draw_points, 1);
+    rb_define_method(cRenderer, "draw_lines", Renderer_draw_lines, 1);
+    rb_define_method(cRenderer, "draw_rects", Renderer_draw_rects, 1);
+    rb_define_method(cRenderer, "fill_rects", Renderer_fill_rects, 1);
+#if SDL_VERSION_ATLEAST(2,0,10)
+    rb_define_method(cRenderer, "copy_f", Renderer_copy_f, 3);
+    rb_define_method(cRenderer, "copy_ex_f", Renderer_copy_ex_f, 6);
+    rb_define_method(cRenderer, "copy_batch_f", Renderer_copy_batch_f, 3);
+    rb_define_method(cRenderer, "draw_point_f", Renderer_draw_point_f, 2);
+    rb_define_method(cRenderer, "draw_line_f", Renderer_draw_line_f, 4);
+    rb_define_method(cRenderer, "draw_rect_f", Renderer_draw_rect_f, 1);
+    rb_define_method(cRenderer, "fill_rect_f", Renderer_fill_rect_f, 1);
+    rb_define_method(cRenderer, "draw_points_f", Renderer_draw_points_f, 1);
+    rb_define_method(cRenderer, "draw_lines_f", Renderer_draw_lines_f, 1);
+    rb_define_method(cRenderer, "draw_rects_f", Renderer_draw_rects_f, 1);
+    rb_define_method(cRenderer, "fill_rects_f", Renderer_fill_rects_f, 1);
+#endif
     rb_define_method(cRenderer, "draw_blend_mode", Renderer_draw_blend_mode, 0);
     rb_define_method(cRenderer, "draw_blend_mode=", Renderer_set_draw_blend_mode, 1);
     rb_define_method(cRenderer, "clip_rect", Renderer_clip_rect, 0);
@@ -3060,6 +5606,8 @@ void rubysdl2_init_video(void)
     rb_define_method(cTexture, "access_pattern", Texture_access_pattern, 0);
     rb_define_method(cTexture, "w", Texture_w, 0);
     rb_define_method(cTexture, "h", Texture_h, 0);
+    rb_define_method(cTexture, "update", Texture_update, -1);
+    rb_define_method(cTexture, "lock", Texture_lock, -1);
     rb_define_method(cTexture, "inspect", Texture_inspect, 0);
     rb_define_method(cTexture, "debug_info", Texture_debug_info, 0);
     /* define(`DEFINE_TEXTUREAH_ACCESS_CONST', `rb_define_const(cTexture, "ACCESS_$1", INT2NUM(SDL_TEXTUREACCESS_$1))') */
@@ -3071,6 +5619,23 @@ void rubysdl2_init_video(void)
     DEFINE_TEXTUREAH_ACCESS_CONST(TARGET);
 
 
+    cTextureAtlas = rb_define_class_under(mSDL2, "TextureAtlas", rb_cObject);
+
+    rb_define_alloc_func(cTextureAtlas, TextureAtlas_s_allocate);
+    rb_define_method(cTextureAtlas, "initialize", TextureAtlas_initialize, -1);
+    rb_define_method(cTextureAtlas, "add", TextureAtlas_add, 1);
+    rb_define_method(cTextureAtlas, "density", TextureAtlas_density, 0);
+    rb_define_method(cTextureAtlas, "stats", TextureAtlas_stats, 0);
+    rb_define_method(cTextureAtlas, "w", TextureAtlas_w, 0);
+    rb_define_method(cTextureAtlas, "h", TextureAtlas_h, 0);
+    define_attr_readers(cTextureAtlas, "renderer", "textures", NULL);
+
+    cTextureAtlasRegion = rb_define_class_under(cTextureAtlas, "Region", rb_cObject);
+
+    rb_define_method(cTextureAtlasRegion, "w", TextureAtlasRegion_w, 0);
+    rb_define_method(cTextureAtlasRegion, "h", TextureAtlasRegion_h, 0);
+    define_attr_readers(cTextureAtlasRegion, "texture", "rect", "page", NULL);
+
     cSurface = rb_define_class_under(mSDL2, "Surface", rb_cObject);
 
     rb_undef_alloc_func(cSurface);
@@ -3079,6 +5644,7 @@ void rubysdl2_init_video(void)
     rb_define_singleton_method(cSurface, "blit", Surface_s_blit, 4);
     rb_define_singleton_method(cSurface, "new", Surface_s_new, -1);
     rb_define_singleton_method(cSurface, "from_string", Surface_s_from_string, -1);
+    rb_define_singleton_method(cSurface, "wrap_string", Surface_s_wrap_string, -1);
     rb_define_method(cSurface, "destroy?", Surface_destroy_p, 0);
     rb_define_method(cSurface, "destroy", Surface_destroy, 0);
     DEFINE_C_ACCESSOR(Surface, cSurface, blend_mode);
@@ -3093,6 +5659,10 @@ void rubysdl2_init_video(void)
     rb_define_method(cSurface, "color_key=", Surface_set_color_key, 1);
     rb_define_method(cSurface, "unset_color_key", Surface_unset_color_key, 0);
     rb_define_method(cSurface, "pixels", Surface_pixels, 0);
+    rb_define_method(cSurface, "pixels_buffer", Surface_pixels_buffer, 0);
+#ifdef HAVE_RB_MEMORY_VIEW_REGISTER
+    rb_memory_view_register(cSurface, &Surface_memory_view_entry);
+#endif
     rb_define_method(cSurface, "pitch", Surface_pitch, 0);
     rb_define_method(cSurface, "bits_per_pixel", Surface_bits_per_pixel, 0);
     rb_define_method(cSurface, "bytes_per_pixel", Surface_bytes_per_pixel, 0);
@@ -3119,12 +5689,73 @@ void rubysdl2_init_video(void)
     DEFINE_C_ACCESSOR(Point, cPoint, x);
     DEFINE_C_ACCESSOR(Point, cPoint, y);
 
+#if SDL_VERSION_ATLEAST(2,0,10)
+    cFRect = rb_define_class_under(mSDL2, "FRect", rb_cObject);
+
+    rb_define_alloc_func(cFRect, FRect_s_allocate);
+    rb_define_method(cFRect, "initialize", FRect_initialize, -1);
+    rb_define_alias(rb_singleton_class(cFRect), "[]", "new");
+    rb_define_method(cFRect, "inspect", FRect_inspect, 0);
+    DEFINE_C_ACCESSOR(FRect, cFRect, x);
+    DEFINE_C_ACCESSOR(FRect, cFRect, y);
+    DEFINE_C_ACCESSOR(FRect, cFRect, w);
+    DEFINE_C_ACCESSOR(FRect, cFRect, h);
+
+    cFPoint = rb_define_class_under(mSDL2, "FPoint", rb_cObject);
+
+    rb_define_alloc_func(cFPoint, FPoint_s_allocate);
+    rb_define_method(cFPoint, "initialize", FPoint_initialize, -1);
+    rb_define_alias(rb_singleton_class(cFPoint), "[]", "new");
+    rb_define_method(cFPoint, "inspect", FPoint_inspect, 0);
+    DEFINE_C_ACCESSOR(FPoint, cFPoint, x);
+    DEFINE_C_ACCESSOR(FPoint, cFPoint, y);
+#endif
+
 
     cRendererInfo = rb_define_class_under(cRenderer, "Info", rb_cObject);
     define_attr_readers(cRendererInfo, "name", "flags", "texture_formats",
                         "max_texture_width", "max_texture_height", NULL);
 
 
+    cRendererCommandList = rb_define_class_under(cRenderer, "CommandList", rb_cObject);
+
+    rb_define_alloc_func(cRendererCommandList, CommandList_s_allocate);
+    rb_define_method(cRendererCommandList, "copy", CommandList_copy, 3);
+    rb_define_method(cRendererCommandList, "copy_ex", CommandList_copy_ex, 6);
+    rb_define_method(cRendererCommandList, "draw_point", CommandList_draw_point, 2);
+    rb_define_method(cRendererCommandList, "draw_line", CommandList_draw_line, 4);
+    rb_define_method(cRendererCommandList, "draw_rect", CommandList_draw_rect, 1);
+    rb_define_method(cRendererCommandList, "fill_rect", CommandList_fill_rect, 1);
+    rb_define_method(cRendererCommandList, "draw_color=", CommandList_set_draw_color, 1);
+    rb_define_method(cRendererCommandList, "draw_blend_mode=", CommandList_set_draw_blend_mode, 1);
+    rb_define_method(cRendererCommandList, "clip_rect=", CommandList_set_clip_rect, 1);
+    rb_define_method(cRendererCommandList, "move", CommandList_move, 3);
+    rb_define_method(cRendererCommandList, "set_dstrect", CommandList_set_dstrect, 2);
+    rb_define_method(cRendererCommandList, "set_srcrect", CommandList_set_srcrect, 2);
+    rb_define_method(cRendererCommandList, "set_angle", CommandList_set_angle, 2);
+    rb_define_method(cRendererCommandList, "set_color", CommandList_set_color, 2);
+    rb_define_method(cRendererCommandList, "replay", CommandList_replay, 1);
+    rb_define_method(cRendererCommandList, "size", CommandList_size, 0);
+    rb_define_method(cRendererCommandList, "clear", CommandList_clear, 0);
+
+    cRendererCapture = rb_define_class_under(cRenderer, "Capture", rb_cObject);
+
+    rb_define_alloc_func(cRendererCapture, Capture_s_allocate);
+    rb_define_method(cRendererCapture, "initialize", Capture_initialize, -1);
+    rb_define_method(cRendererCapture, "capture", Capture_capture, 0);
+    rb_define_method(cRendererCapture, "frame", Capture_frame, -1);
+    rb_define_method(cRendererCapture, "start_writer", Capture_start_writer, 1);
+    rb_define_method(cRendererCapture, "stop_writer", Capture_stop_writer, 0);
+    rb_define_method(cRendererCapture, "writer?", Capture_writer_p, 0);
+    rb_define_method(cRendererCapture, "captured", Capture_captured, 0);
+    rb_define_method(cRendererCapture, "pending", Capture_pending, 0);
+    rb_define_method(cRendererCapture, "w", Capture_w, 0);
+    rb_define_method(cRendererCapture, "h", Capture_h, 0);
+    rb_define_method(cRendererCapture, "pitch", Capture_pitch, 0);
+    rb_define_method(cRendererCapture, "frame_size", Capture_frame_size, 0);
+    rb_define_method(cRendererCapture, "num_buffers", Capture_num_buffers, 0);
+
+
     cPixelFormat = rb_define_class_under(mSDL2, "PixelFormat", rb_cObject);
 
     rb_define_method(cPixelFormat, "initialize", PixelForamt_initialize, 1);
@@ -3355,11 +5986,13 @@ static VALUE Surface_s_load(VALUE self, VALUE fname)
  */
 static VALUE Renderer_load_texture(VALUE self, VALUE fname)
 {
+    PROFILE_BEGIN(start);
     SDL_Texture* texture = IMG_LoadTexture(Get_SDL_Renderer(self), StringValueCStr(fname));
     if (!texture) {
         SDL_SetError("%s", IMG_GetError());
         SDL_ERROR();
     }
+    PROFILE_END(PROFILE_TEXTURE_CREATE, start);
     return Texture_new(texture, Get_Renderer(self));
 }
 